@@ -144,6 +144,8 @@ cmd_capture_pane_history(struct args *args, struct cmdq_item *item,
 	}
 
 	Sflag = args_get(args, 'S');
+	if (Sflag != NULL)
+		grid_reflow_history(gd, 1);
 	if (Sflag != NULL && strcmp(Sflag, "-") == 0)
 		top = 0;
 	else {
@@ -324,6 +324,8 @@ cmd_refresh_client_exec(struct cmd *self, struct cmdq_item *item)
 		tc->flags |= CLIENT_STATUSFORCE;
 		server_status_client(tc);
 	} else {
+		/* The terminal may have been changed behind our back. */
+		tty_shadow_invalidate(&tc->tty, 0, 0, UINT_MAX, UINT_MAX);
 		tc->flags |= CLIENT_STATUSFORCE;
 		server_redraw_client(tc);
 	}
@@ -907,26 +907,9 @@ format_cb_current_path(struct format_tree *ft)
 static void *
 format_cb_history_bytes(struct format_tree *ft)
 {
-	struct window_pane	*wp = ft->wp;
-	struct grid		*gd;
-	struct grid_line	*gl;
-	size_t			 size = 0;
-	u_int			 i;
-	char			*value;
-
-	if (wp == NULL)
-		return (NULL);
-	gd = wp->base.grid;
-
-	for (i = 0; i < gd->hsize + gd->sy; i++) {
-		gl = grid_get_line(gd, i);
-		size += gl->cellsize * sizeof *gl->celldata;
-		size += gl->extdsize * sizeof *gl->extddata;
-	}
-	size += (gd->hsize + gd->sy) * sizeof *gl;
-
-	xasprintf(&value, "%zu", size);
-	return (value);
+	if (ft->wp != NULL)
+		return (format_printf("%zu", window_pane_history_bytes(ft->wp)));
+	return (NULL);
 }
 
 /* Callback for history_all_bytes. */
@@ -935,7 +918,7 @@ format_cb_history_all_bytes(struct format_tree *ft)
 {
 	struct window_pane	*wp = ft->wp;
 	struct grid		*gd;
-	struct grid_line	*gl;
+	const struct grid_line	*gl;
 	u_int			 i, lines, cells = 0, extended_cells = 0;
 	char			*value;
 
@@ -945,7 +928,9 @@ format_cb_history_all_bytes(struct format_tree *ft)
 
 	lines = gd->hsize + gd->sy;
 	for (i = 0; i < lines; i++) {
-		gl = grid_get_line(gd, i);
+		gl = grid_peek_packed_line(gd, i);
+		if (gl->flags & GRID_LINE_PACKED)
+			continue;
 		cells += gl->cellsize;
 		extended_cells += gl->extdsize;
 	}
@@ -1602,6 +1587,15 @@ format_cb_client_width(struct format_tree *ft)
 	return (NULL);
 }
 
+/* Callback for client_redraw_written. */
+static void *
+format_cb_client_redraw_written(struct format_tree *ft)
+{
+	if (ft->c != NULL)
+		return (format_printf("%zu", ft->c->redraw_written));
+	return (NULL);
+}
+
 /* Callback for client_written. */
 static void *
 format_cb_client_written(struct format_tree *ft)
@@ -1977,6 +1971,20 @@ format_cb_pane_bottom(struct format_tree *ft)
 	return (NULL);
 }
 
+/* Callback for pane_checksum. */
+static void *
+format_cb_pane_checksum(struct format_tree *ft)
+{
+	struct screen	*s;
+
+	if (ft->wp != NULL) {
+		s = &ft->wp->base;
+		return (format_printf("%u", grid_checksum(s->grid,
+		    s->grid->hsize, screen_size_y(s))));
+	}
+	return (NULL);
+}
+
 /* Callback for pane_dead. */
 static void *
 format_cb_pane_dead(struct format_tree *ft)
@@ -2293,6 +2301,13 @@ format_cb_scroll_region_upper(struct format_tree *ft)
 	return (NULL);
 }
 
+/* Callback for server_history_bytes. */
+static void *
+format_cb_server_history_bytes(__unused struct format_tree *ft)
+{
+	return (format_printf("%zu", window_history_bytes()));
+}
+
 /* Callback for server_sessions. */
 static void *
 format_cb_server_sessions(__unused struct format_tree *ft)
@@ -2493,6 +2508,84 @@ format_cb_session_path(struct format_tree *ft)
 	return (NULL);
 }
 
+#ifdef ENABLE_REMOTE
+/* Callback for session_remote_echo_latency. */
+static void *
+format_cb_session_remote_echo_latency(struct format_tree *ft)
+{
+	if (ft->s != NULL && ft->s->remote != NULL)
+		return (format_printf("%u", remote_echo_latency(ft->s->remote)));
+	return (NULL);
+}
+
+/* Callback for session_remote_input_latency. */
+static void *
+format_cb_session_remote_input_latency(struct format_tree *ft)
+{
+	if (ft->s != NULL && ft->s->remote != NULL)
+		return (format_printf("%u", remote_input_latency(ft->s->remote)));
+	return (NULL);
+}
+
+/* Format a round trip time in microseconds as milliseconds. */
+static char *
+format_remote_latency(u_int us)
+{
+	return (format_printf("%u.%03u", us / 1000, us % 1000));
+}
+
+/* Callback for session_remote_latency. */
+static void *
+format_cb_session_remote_latency(struct format_tree *ft)
+{
+	if (ft->s != NULL && ft->s->remote != NULL)
+		return (format_remote_latency(remote_latency(ft->s->remote)));
+	return (NULL);
+}
+
+/* Callback for session_remote_latency_p50. */
+static void *
+format_cb_session_remote_latency_p50(struct format_tree *ft)
+{
+	if (ft->s != NULL && ft->s->remote != NULL) {
+		return (format_remote_latency(
+		    remote_latency_percentile(ft->s->remote, 50)));
+	}
+	return (NULL);
+}
+
+/* Callback for session_remote_latency_p90. */
+static void *
+format_cb_session_remote_latency_p90(struct format_tree *ft)
+{
+	if (ft->s != NULL && ft->s->remote != NULL) {
+		return (format_remote_latency(
+		    remote_latency_percentile(ft->s->remote, 90)));
+	}
+	return (NULL);
+}
+
+/* Callback for session_remote_latency_p99. */
+static void *
+format_cb_session_remote_latency_p99(struct format_tree *ft)
+{
+	if (ft->s != NULL && ft->s->remote != NULL) {
+		return (format_remote_latency(
+		    remote_latency_percentile(ft->s->remote, 99)));
+	}
+	return (NULL);
+}
+
+/* Callback for session_remote_queue. */
+static void *
+format_cb_session_remote_queue(struct format_tree *ft)
+{
+	if (ft->s != NULL && ft->s->remote != NULL)
+		return (format_printf("%u", remote_queued(ft->s->remote)));
+	return (NULL);
+}
+#endif
+
 /* Callback for session_windows. */
 static void *
 format_cb_session_windows(struct format_tree *ft)
@@ -3065,6 +3158,9 @@ static const struct format_table_entry format_table[] = {
 	{ "client_readonly", FORMAT_TABLE_STRING,
 	  format_cb_client_readonly
 	},
+	{ "client_redraw_written", FORMAT_TABLE_STRING,
+	  format_cb_client_redraw_written
+	},
 	{ "client_session", FORMAT_TABLE_STRING,
 	  format_cb_client_session
 	},
@@ -3227,6 +3323,9 @@ static const struct format_table_entry format_table[] = {
 	{ "pane_bottom", FORMAT_TABLE_STRING,
 	  format_cb_pane_bottom
 	},
+	{ "pane_checksum", FORMAT_TABLE_STRING,
+	  format_cb_pane_checksum
+	},
 	{ "pane_current_command", FORMAT_TABLE_STRING,
 	  format_cb_current_command
 	},
@@ -3335,6 +3434,9 @@ static const struct format_table_entry format_table[] = {
 	{ "scroll_region_upper", FORMAT_TABLE_STRING,
 	  format_cb_scroll_region_upper
 	},
+	{ "server_history_bytes", FORMAT_TABLE_STRING,
+	  format_cb_server_history_bytes
+	},
 	{ "server_sessions", FORMAT_TABLE_STRING,
 	  format_cb_server_sessions
 	},
@@ -3407,6 +3509,29 @@ static const struct format_table_entry format_table[] = {
 	{ "session_path", FORMAT_TABLE_STRING,
 	  format_cb_session_path
 	},
+#ifdef ENABLE_REMOTE
+	{ "session_remote_echo_latency", FORMAT_TABLE_STRING,
+	  format_cb_session_remote_echo_latency
+	},
+	{ "session_remote_input_latency", FORMAT_TABLE_STRING,
+	  format_cb_session_remote_input_latency
+	},
+	{ "session_remote_latency", FORMAT_TABLE_STRING,
+	  format_cb_session_remote_latency
+	},
+	{ "session_remote_latency_p50", FORMAT_TABLE_STRING,
+	  format_cb_session_remote_latency_p50
+	},
+	{ "session_remote_latency_p90", FORMAT_TABLE_STRING,
+	  format_cb_session_remote_latency_p90
+	},
+	{ "session_remote_latency_p99", FORMAT_TABLE_STRING,
+	  format_cb_session_remote_latency_p99
+	},
+	{ "session_remote_queue", FORMAT_TABLE_STRING,
+	  format_cb_session_remote_queue
+	},
+#endif
 	{ "session_silence_flag", FORMAT_TABLE_STRING,
 	  format_cb_session_silence_flag
 	},
@@ -0,0 +1,798 @@
+/*
+ * Copyright (c) 2007 Nicholas Marriott <nicholas.marriott@gmail.com>
+ * Copyright (c) 2020 Sergey Nizovtsev <snizovtsev@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Throughput benchmark for the input parser and screen writer, and
+ * optionally for redrawing the result into a tty that goes nowhere.
+ *
+ * The pane is set up the same way as in input-fuzzer.c. Each corpus is
+ * generated here from a fixed seed so runs can be compared with each other.
+ *
+ * tmux.c and xmalloc.c are included rather than linked: the first so its
+ * main() can be renamed and the second so allocations can be counted.
+ */
+
+#include <sys/types.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <locale.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_CYCLES
+#endif
+
+#include "tmux.h"
+
+#define main tmux_main
+int	tmux_main(int, char **);
+#include "tmux.c"
+#undef main
+
+static u_long	bench_allocs;
+
+static void *
+bench_malloc(size_t size)
+{
+	bench_allocs++;
+	return (malloc(size));
+}
+
+static void *
+bench_calloc(size_t nmemb, size_t size)
+{
+	bench_allocs++;
+	return (calloc(nmemb, size));
+}
+
+static void *
+bench_reallocarray(void *ptr, size_t nmemb, size_t size)
+{
+	bench_allocs++;
+	return (reallocarray(ptr, nmemb, size));
+}
+
+static void *
+bench_recallocarray(void *ptr, size_t oldnmemb, size_t nmemb, size_t size)
+{
+	bench_allocs++;
+	return (recallocarray(ptr, oldnmemb, nmemb, size));
+}
+
+static char *
+bench_strdup(const char *str)
+{
+	bench_allocs++;
+	return (strdup(str));
+}
+
+static char *
+bench_strndup(const char *str, size_t maxlen)
+{
+	bench_allocs++;
+	return (strndup(str, maxlen));
+}
+
+static int
+bench_vasprintf(char **ret, const char *fmt, va_list ap)
+{
+	bench_allocs++;
+	return (vasprintf(ret, fmt, ap));
+}
+
+#undef malloc
+#undef calloc
+#undef reallocarray
+#undef recallocarray
+#undef strdup
+#undef strndup
+#undef vasprintf
+#define malloc bench_malloc
+#define calloc bench_calloc
+#define reallocarray bench_reallocarray
+#define recallocarray bench_recallocarray
+#define strdup bench_strdup
+#define strndup bench_strndup
+#define vasprintf bench_vasprintf
+#include "xmalloc.c"
+#undef malloc
+#undef calloc
+#undef reallocarray
+#undef recallocarray
+#undef strdup
+#undef strndup
+#undef vasprintf
+
+struct bench_buf {
+	u_char	*data;
+	size_t	 used;
+	size_t	 size;
+};
+
+struct bench_corpus {
+	const char	*name;
+	void		 (*generate)(struct bench_buf *, size_t);
+};
+
+struct bench_result {
+	uint64_t	 ns;
+	uint64_t	 cycles;
+	u_long		 allocs;
+	size_t		 output;
+	size_t		 moves;
+	size_t		 cells;
+	size_t		 memory;
+};
+
+static u_int		 bench_sx = 80;
+static u_int		 bench_sy = 24;
+static u_int		 bench_history = 2000;
+static u_int		 bench_compress;
+static size_t		 bench_chunk = 16384;
+static uint64_t		 bench_seed;
+static struct event_base *libevent;
+
+static struct tty	 bench_tty;
+static struct client	 bench_client;
+
+static void		 bench_plain(struct bench_buf *, size_t);
+static void		 bench_sgr(struct bench_buf *, size_t);
+static void		 bench_truecolor(struct bench_buf *, size_t);
+static void		 bench_utf8(struct bench_buf *, size_t);
+static void		 bench_scroll(struct bench_buf *, size_t);
+static void		 bench_tui(struct bench_buf *, size_t);
+static void		 bench_ls(struct bench_buf *, size_t);
+static void		 bench_sixel(struct bench_buf *, size_t);
+
+static const struct bench_corpus bench_corpora[] = {
+	{ "plain", bench_plain },
+	{ "sgr", bench_sgr },
+	{ "truecolor", bench_truecolor },
+	{ "utf8", bench_utf8 },
+	{ "scroll", bench_scroll },
+	{ "tui", bench_tui },
+	{ "ls", bench_ls },
+	{ "sixel", bench_sixel },
+};
+
+static __dead void
+bench_usage(void)
+{
+	fprintf(stderr, "usage: input-bench [-d] [-c chunk] [-h history] "
+	    "[-n runs] [-s megabytes] [-T term] [-x width] [-y height] "
+	    "[-z compress] [corpus ...]\n");
+	exit(1);
+}
+
+static uint64_t
+bench_now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+static uint64_t
+bench_cycles(void)
+{
+#ifdef BENCH_HAVE_CYCLES
+	return (__rdtsc());
+#else
+	return (0);
+#endif
+}
+
+static u_int
+bench_random(u_int n)
+{
+	bench_seed ^= bench_seed << 13;
+	bench_seed ^= bench_seed >> 7;
+	bench_seed ^= bench_seed << 17;
+	return ((bench_seed >> 32) % n);
+}
+
+static void
+bench_add(struct bench_buf *b, const void *data, size_t len)
+{
+	if (b->used + len > b->size) {
+		b->size = (b->used + len) * 2;
+		b->data = xrealloc(b->data, b->size);
+	}
+	memcpy(b->data + b->used, data, len);
+	b->used += len;
+}
+
+static void printflike(2, 3)
+bench_printf(struct bench_buf *b, const char *fmt, ...)
+{
+	va_list	 ap;
+	char	 tmp[256];
+	int	 n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(tmp, sizeof tmp, fmt, ap);
+	va_end(ap);
+	if (n >= (int)sizeof tmp)
+		n = sizeof tmp - 1;
+	if (n > 0)
+		bench_add(b, tmp, n);
+}
+
+/* Add a word of 1 to 10 lowercase letters. */
+static void
+bench_word(struct bench_buf *b)
+{
+	u_int	i, n = 1 + bench_random(10);
+	char	word[10];
+
+	for (i = 0; i < n; i++)
+		word[i] = 'a' + bench_random(26);
+	bench_add(b, word, n);
+}
+
+/* Plain ASCII text in lines of differing lengths. */
+static void
+bench_plain(struct bench_buf *b, size_t size)
+{
+	u_int	x;
+
+	while (b->used < size) {
+		for (x = bench_random(bench_sx * 3 / 2); x > 0; x--) {
+			bench_word(b);
+			bench_add(b, " ", 1);
+		}
+		bench_add(b, "\r\n", 2);
+	}
+}
+
+/* Text with a 16 or 256 colour and attribute change for most words. */
+static void
+bench_sgr(struct bench_buf *b, size_t size)
+{
+	static const char	*attrs[] = { "1", "2", "3", "4", "7", "22;24" };
+	u_int			 x;
+
+	while (b->used < size) {
+		for (x = bench_random(bench_sx / 4); x > 0; x--) {
+			switch (bench_random(4)) {
+			case 0:
+				bench_printf(b, "\033[%u;%um",
+				    30 + bench_random(8), 40 + bench_random(8));
+				break;
+			case 1:
+				bench_printf(b, "\033[38;5;%um",
+				    bench_random(256));
+				break;
+			case 2:
+				bench_printf(b, "\033[%sm",
+				    attrs[bench_random(nitems(attrs))]);
+				break;
+			}
+			bench_word(b);
+			bench_add(b, " ", 1);
+		}
+		bench_add(b, "\033[m\r\n", 5);
+	}
+}
+
+/* Text with RGB foreground and background colours. */
+static void
+bench_truecolor(struct bench_buf *b, size_t size)
+{
+	u_int	x;
+
+	while (b->used < size) {
+		for (x = bench_random(bench_sx / 4); x > 0; x--) {
+			bench_printf(b, "\033[38;2;%u;%u;%u;48;2;%u;%u;%um",
+			    bench_random(256), bench_random(256),
+			    bench_random(256), bench_random(256),
+			    bench_random(256), bench_random(256));
+			bench_word(b);
+			bench_add(b, " ", 1);
+		}
+		bench_add(b, "\033[m\r\n", 5);
+	}
+}
+
+/* Mixed Cyrillic, CJK and ASCII text. */
+static void
+bench_utf8(struct bench_buf *b, size_t size)
+{
+	struct utf8_data	 ud;
+	wchar_t			 wc;
+	u_int			 x, i, n;
+
+	while (b->used < size) {
+		for (x = bench_random(bench_sx / 4); x > 0; x--) {
+			n = 1 + bench_random(6);
+			for (i = 0; i < n; i++) {
+				switch (bench_random(3)) {
+				case 0:
+					wc = 0x430 + bench_random(32);
+					break;
+				case 1:
+					wc = 0x4e00 + bench_random(0x5000);
+					break;
+				default:
+					wc = 'a' + bench_random(26);
+					break;
+				}
+				if (utf8_fromwc(wc, &ud) == UTF8_DONE)
+					bench_add(b, ud.data, ud.size);
+			}
+			bench_add(b, " ", 1);
+		}
+		bench_add(b, "\r\n", 2);
+	}
+}
+
+/* Scroll regions moving about with inserted and deleted lines. */
+static void
+bench_scroll(struct bench_buf *b, size_t size)
+{
+	u_int	upper, lower, i;
+
+	while (b->used < size) {
+		upper = 1 + bench_random(bench_sy / 2);
+		lower = upper + 1 + bench_random(bench_sy - upper);
+		bench_printf(b, "\033[%u;%ur\033[%u;1H", upper, lower, lower);
+		for (i = bench_random(bench_sy); i > 0; i--) {
+			bench_word(b);
+			switch (bench_random(4)) {
+			case 0:
+				bench_printf(b, "\033[%uL", 1 + bench_random(3));
+				break;
+			case 1:
+				bench_printf(b, "\033[%uM", 1 + bench_random(3));
+				break;
+			case 2:
+				bench_add(b, "\033M", 2);
+				break;
+			default:
+				bench_add(b, "\r\n", 2);
+				break;
+			}
+		}
+		bench_add(b, "\033[r", 3);
+	}
+}
+
+/* Full screen redraws in the alternate screen like a text editor. */
+static void
+bench_tui(struct bench_buf *b, size_t size)
+{
+	u_int	x, y, frames = 0;
+
+	bench_add(b, "\033[?1049h", 8);
+	while (b->used < size) {
+		if (++frames % 64 == 0)
+			bench_add(b, "\033[?1049l\033[?1049h", 16);
+		if (frames % 8 == 0)
+			bench_add(b, "\033[H\033[2J", 7);
+
+		bench_add(b, "\033[H\033(0l", 8);
+		for (x = 2; x < bench_sx; x++)
+			bench_add(b, "q", 1);
+		bench_add(b, "k\033(B", 4);
+		for (y = 2; y < bench_sy - 1; y++) {
+			if (bench_random(3) != 0)
+				continue;
+			bench_printf(b, "\033[%u;1H\033(0x\033(B\033[%um", y,
+			    31 + bench_random(7));
+			for (x = bench_random(bench_sx / 8); x > 0; x--) {
+				bench_word(b);
+				bench_add(b, " ", 1);
+			}
+			bench_printf(b, "\033[m\033[K\033[%u;%uH\033(0x\033(B",
+			    y, bench_sx);
+		}
+		bench_printf(b, "\033[%u;1H\033[7m", bench_sy);
+		bench_word(b);
+		bench_printf(b, " %u\033[K\033[m\033[%u;%uH", frames,
+		    2 + bench_random(bench_sy - 3), 2 + bench_random(8));
+	}
+	bench_add(b, "\033[?1049l", 8);
+}
+
+/* Coloured file names in columns like ls --color. */
+static void
+bench_ls(struct bench_buf *b, size_t size)
+{
+	static const char	*colours[] = {
+		NULL, NULL, NULL, "01;34", "01;32", "01;36", "01;31",
+		"40;33;01", "30;42", "37;41"
+	};
+	const char		*colour;
+	u_int			 x, width = 16;
+	size_t			 used;
+
+	while (b->used < size) {
+		for (x = 0; x + width <= bench_sx; x += width) {
+			colour = colours[bench_random(nitems(colours))];
+			if (colour != NULL)
+				bench_printf(b, "\033[0m\033[%sm", colour);
+			used = b->used;
+			bench_word(b);
+			used = b->used - used;
+			if (colour != NULL)
+				bench_add(b, "\033[0m", 4);
+			for (; used < width; used++)
+				bench_add(b, " ", 1);
+		}
+		bench_add(b, "\r\n", 2);
+	}
+}
+
+/* Small sixel images between lines of text. */
+static void
+bench_sixel(struct bench_buf *b, size_t size)
+{
+	u_int	x, y, w, h;
+
+	while (b->used < size) {
+		w = 8 + bench_random(64);
+		h = 1 + bench_random(4);
+		bench_printf(b, "\033Pq\"1;1;%u;%u", w, h * 6);
+		for (x = 0; x < 4; x++) {
+			bench_printf(b, "#%u;2;%u;%u;%u", x, bench_random(101),
+			    bench_random(101), bench_random(101));
+		}
+		for (y = 0; y < h; y++) {
+			bench_printf(b, "#%u", bench_random(4));
+			for (x = 0; x < w; x++)
+				bench_printf(b, "%c", 0x3f + bench_random(64));
+			bench_add(b, "-", 1);
+		}
+		bench_add(b, "\033\\\r\n", 4);
+		bench_word(b);
+		bench_add(b, "\r\n", 2);
+	}
+}
+
+static void
+bench_init(void)
+{
+	const struct options_table_entry	*oe;
+
+	global_environ = environ_create();
+	global_options = options_create(NULL);
+	global_s_options = options_create(NULL);
+	global_w_options = options_create(NULL);
+	for (oe = options_table; oe->name != NULL; oe++) {
+		if (oe->scope & OPTIONS_TABLE_SERVER)
+			options_default(global_options, oe);
+		if (oe->scope & OPTIONS_TABLE_SESSION)
+			options_default(global_s_options, oe);
+		if (oe->scope & OPTIONS_TABLE_WINDOW)
+			options_default(global_w_options, oe);
+	}
+	libevent = osdep_event_init();
+
+	options_set_number(global_w_options, "monitor-bell", 0);
+	options_set_number(global_w_options, "allow-rename", 1);
+	options_set_number(global_options, "set-clipboard", 2);
+	socket_path = xstrdup("dummy");
+}
+
+/* Set up a tty for the given terminal which writes into a buffer. */
+static void
+bench_tty_init(const char *name)
+{
+	struct tty	*tty = &bench_tty;
+	char		**caps, *cause;
+	u_int		  ncaps;
+	int		  feat = 0;
+
+	if (tty_term_read_list(name, STDIN_FILENO, &caps, &ncaps, &cause) != 0)
+		errx(1, "%s", cause);
+
+	bench_client.name = xstrdup("bench");
+	memset(tty, 0, sizeof *tty);
+	tty->client = &bench_client;
+	tty->out = evbuffer_new();
+	tty->sx = bench_sx;
+	tty->sy = bench_sy;
+	tty->fg = tty->bg = -1;
+	tty->cstyle = SCREEN_CURSOR_DEFAULT;
+	tty->ccolour = -1;
+
+	tty_add_features(&feat, "256,RGB", ",");
+	tty->term = tty_term_create(tty, (char *)name, caps, ncaps, &feat,
+	    &cause);
+	if (tty->term == NULL)
+		errx(1, "%s", cause);
+	tty_term_free_list(caps, ncaps);
+	tty_apply_features(tty->term, feat);
+
+	tty->cx = tty->cy = UINT_MAX;
+	tty->rupper = tty->rlower = UINT_MAX;
+	tty->rleft = tty->rright = UINT_MAX;
+	memcpy(&tty->cell, &grid_default_cell, sizeof tty->cell);
+	memcpy(&tty->last_cell, &grid_default_cell, sizeof tty->last_cell);
+}
+
+/*
+ * Count the bytes of output spent moving the cursor: carriage return, line
+ * feed, backspace and the CSI sequences that move it, absolutely or relative.
+ * Cells rewritten in place of a move are not counted.
+ */
+static size_t
+bench_moves(const u_char *p, size_t len)
+{
+	size_t	i = 0, start, moves = 0;
+
+	while (i < len) {
+		if (p[i] == '\r' || p[i] == '\n' || p[i] == '\b') {
+			moves++;
+			i++;
+			continue;
+		}
+		if (p[i] != '\033' || i + 1 == len || p[i + 1] != '[') {
+			i++;
+			continue;
+		}
+		start = i;
+		for (i += 2; i < len; i++) {
+			if (p[i] >= 0x40 && p[i] <= 0x7e)
+				break;
+		}
+		if (i == len)
+			break;
+		if (strchr("ABCDGHdf`", p[i]) != NULL)
+			moves += i + 1 - start;
+		i++;
+	}
+	return (moves);
+}
+
+/*
+ * Draw every line of the pane and put the cursor where the pane has it, as a
+ * redraw does.
+ */
+static void
+bench_draw(struct window_pane *wp)
+{
+	struct screen	*s = wp->screen;
+	struct tty	*tty = &bench_tty;
+	u_int		 y;
+
+	for (y = 0; y < screen_size_y(s); y++) {
+		tty_draw_line(tty, s, 0, y, screen_size_x(s), 0, y,
+		    &grid_default_cell, NULL);
+	}
+	tty_cursor(tty, s->cx, s->cy);
+}
+
+/* Count the output of a draw and throw it away. */
+static void
+bench_discard(struct bench_result *redraw)
+{
+	struct tty	*tty = &bench_tty;
+	size_t		 len = EVBUFFER_LENGTH(tty->out);
+
+	redraw->output += len;
+	redraw->moves += bench_moves(EVBUFFER_DATA(tty->out), len);
+	evbuffer_drain(tty->out, len);
+}
+
+static void
+bench_run(struct bench_buf *b, int draw, struct bench_result *input,
+    struct bench_result *redraw)
+{
+	struct bufferevent	*vpty[2];
+	struct window		*w;
+	struct window_pane	*wp;
+	size_t			 off, n;
+	uint64_t		 t, c;
+	u_long			 allocs;
+
+	w = window_create(bench_sx, bench_sy, 0, 0);
+	wp = window_add_pane(w, NULL, bench_history, 0);
+	grid_compress_history(wp->base.grid, bench_compress);
+	bufferevent_pair_new(libevent, BEV_OPT_CLOSE_ON_FREE, vpty);
+	wp->ictx = input_init(wp, vpty[0], NULL);
+	window_add_ref(w, __func__);
+
+	wp->fd = open("/dev/null", O_WRONLY);
+	if (wp->fd == -1)
+		errx(1, "open(\"/dev/null\") failed");
+	wp->event = bufferevent_new(wp->fd, NULL, NULL, NULL, NULL);
+
+	memset(input, 0, sizeof *input);
+	memset(redraw, 0, sizeof *redraw);
+	for (off = 0; off < b->used; off += n) {
+		n = b->used - off;
+		if (n > bench_chunk)
+			n = bench_chunk;
+
+		allocs = bench_allocs;
+		t = bench_now();
+		c = bench_cycles();
+		input_parse_buffer(wp, b->data + off, n);
+		input->cycles += bench_cycles() - c;
+		input->ns += bench_now() - t;
+		input->allocs += bench_allocs - allocs;
+
+		if (draw) {
+			allocs = bench_allocs;
+			t = bench_now();
+			c = bench_cycles();
+			bench_draw(wp);
+			redraw->cycles += bench_cycles() - c;
+			redraw->ns += bench_now() - t;
+			redraw->allocs += bench_allocs - allocs;
+			redraw->cells += bench_sx * bench_sy;
+			bench_discard(redraw);
+		}
+
+		while (cmdq_next(NULL) != 0)
+			;
+		if (event_base_loop(libevent, EVLOOP_NONBLOCK) == -1)
+			errx(1, "event_base_loop failed");
+	}
+
+	input->memory = grid_bytes(wp->base.grid);
+
+	window_remove_ref(w, __func__);
+	bufferevent_free(vpty[0]);
+	bufferevent_free(vpty[1]);
+}
+
+static void
+bench_print(const char *name, const char *stage, size_t size,
+    struct bench_result *r)
+{
+	double	mb = (double)size / (1024 * 1024);
+	char	cycles[32];
+
+#ifdef BENCH_HAVE_CYCLES
+	snprintf(cycles, sizeof cycles, "%.2f", (double)r->cycles / size);
+#else
+	strlcpy(cycles, "-", sizeof cycles);
+#endif
+	printf("%-10s %-6s %10.2f %10s %10.1f", name, stage,
+	    mb / ((double)r->ns / 1e9), cycles, r->allocs / mb);
+	if (r->memory != 0)
+		printf(" %10zu", r->memory / 1024);
+	else
+		printf(" %10s", "");
+	if (r->output != 0) {
+		printf(" %10.2f %10.2f %10.4f", (double)r->output / size,
+		    (double)r->output / r->cells, (double)r->moves / size);
+	}
+	printf("\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	const struct bench_corpus	*bc;
+	struct bench_buf		 b;
+	struct bench_result		 input, redraw, best_input, best_redraw;
+	const char			*errstr, *term = "xterm-256color";
+	u_int				 i, runs = 3, run;
+	size_t				 size = 16;
+	int				 opt, draw = 0, found;
+
+	setlocale(LC_CTYPE, "");
+	if (setlocale(LC_CTYPE, "C.UTF-8") == NULL)
+		setlocale(LC_CTYPE, "en_US.UTF-8");
+
+	while ((opt = getopt(argc, argv, "c:dh:n:s:T:x:y:z:")) != -1) {
+		switch (opt) {
+		case 'c':
+			bench_chunk = strtonum(optarg, 1, INT_MAX, &errstr);
+			if (errstr != NULL)
+				errx(1, "chunk size %s", errstr);
+			break;
+		case 'd':
+			draw = 1;
+			break;
+		case 'h':
+			bench_history = strtonum(optarg, 0, INT_MAX, &errstr);
+			if (errstr != NULL)
+				errx(1, "history %s", errstr);
+			break;
+		case 'n':
+			runs = strtonum(optarg, 1, 1000, &errstr);
+			if (errstr != NULL)
+				errx(1, "runs %s", errstr);
+			break;
+		case 's':
+			size = strtonum(optarg, 1, 4096, &errstr);
+			if (errstr != NULL)
+				errx(1, "size %s", errstr);
+			break;
+		case 'T':
+			term = optarg;
+			break;
+		case 'x':
+			bench_sx = strtonum(optarg, 2, 10000, &errstr);
+			if (errstr != NULL)
+				errx(1, "width %s", errstr);
+			break;
+		case 'y':
+			bench_sy = strtonum(optarg, 2, 10000, &errstr);
+			if (errstr != NULL)
+				errx(1, "height %s", errstr);
+			break;
+		case 'z':
+			bench_compress = strtonum(optarg, 0, INT_MAX, &errstr);
+			if (errstr != NULL)
+				errx(1, "compress %s", errstr);
+			break;
+		default:
+			bench_usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	size *= 1024 * 1024;
+
+	bench_init();
+	if (draw)
+		bench_tty_init(term);
+
+	printf("%-10s %-6s %10s %10s %10s %10s", "corpus", "stage", "MB/s",
+	    "cycles/B", "allocs/MB", "grid KB");
+	if (draw)
+		printf(" %10s %10s %10s", "out/B", "out/cell", "move/B");
+	printf("\n");
+
+	for (i = 0; i < nitems(bench_corpora); i++) {
+		bc = &bench_corpora[i];
+		if (argc != 0) {
+			for (found = 0; found < argc; found++) {
+				if (strcmp(argv[found], bc->name) == 0)
+					break;
+			}
+			if (found == argc)
+				continue;
+		}
+
+		memset(&b, 0, sizeof b);
+		bench_seed = 0x9e3779b97f4a7c15ULL + i;
+		bc->generate(&b, size);
+
+		memset(&best_input, 0, sizeof best_input);
+		memset(&best_redraw, 0, sizeof best_redraw);
+		for (run = 0; run < runs; run++) {
+			bench_run(&b, draw, &input, &redraw);
+			if (run == 0 || input.ns < best_input.ns)
+				memcpy(&best_input, &input, sizeof best_input);
+			if (run == 0 || redraw.ns < best_redraw.ns)
+				memcpy(&best_redraw, &redraw,
+				    sizeof best_redraw);
+		}
+
+		bench_print(bc->name, "input", b.used, &best_input);
+		if (draw)
+			bench_print(bc->name, "draw", b.used, &best_redraw);
+		free(b.data);
+	}
+	return (0);
+}
@@ -0,0 +1,424 @@
+/*
+ * Copyright (c) 2007 Nicholas Marriott <nicholas.marriott@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Benchmark for the remote client reading a control mode stream, without a
+ * server or a network.
+ *
+ * "output" feeds %output lines through remote_read_callback in reads of a
+ * fixed size into one mirrored pane whose pipe nothing reads, and checks the
+ * decoded bytes are the same as those that were encoded. "notify" passes a
+ * mix of the other notifications to remote_dispatch_event. Only those which
+ * need neither a mirrored session nor a reply from the server are used, so
+ * nothing is queued and the handlers stay cheap.
+ *
+ * The streams are generated here from a fixed seed, escaped the same way as
+ * control.c does, so runs can be compared with each other.
+ *
+ * tmux.c is included so its main() can be renamed, and remote.c so its
+ * functions and structures can be reached.
+ */
+
+#include <sys/types.h>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <locale.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tmux.h"
+
+#define main tmux_main
+int	tmux_main(int, char **);
+#include "tmux.c"
+#undef main
+
+#include "remote.c"
+#undef static
+
+struct bench_buf {
+	u_char	*data;
+	size_t	 used;
+	size_t	 size;
+};
+
+static size_t		 bench_chunk = 16384;
+static uint64_t		 bench_seed = 0x9e3779b97f4a7c15ULL;
+static struct event_base *libevent;
+
+/* Notifications used by "notify", %1 is the only mirrored pane. */
+static const char	*bench_events[] = {
+	"%output %1 hello\\015\\012",
+	"%extended-output %1 12 : \\033[1mbold\\033[m",
+	"%window-renamed @7 editor",
+	"%unlinked-window-renamed @9 logs",
+	"%unlinked-window-add @9",
+	"%unlinked-window-close @9",
+	"%session-renamed $2 work",
+	"%session-window-changed $2 @7",
+	"%client-session-changed /dev/pts/4 $2 work",
+	"%sessions-changed",
+	"%subscription-changed name $2 @7 0 %1 : value",
+	"%pane-mode-changed %1",
+	"%pause %1",
+	"%continue %1",
+	"%message unknown",
+};
+
+static __dead void
+bench_usage(void)
+{
+	fprintf(stderr, "usage: remote-bench [-c chunk] [-n runs] "
+	    "[-r repeats] [-s megabytes] [output|notify ...]\n");
+	exit(1);
+}
+
+static uint64_t
+bench_now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+static u_int
+bench_random(u_int n)
+{
+	bench_seed ^= bench_seed << 13;
+	bench_seed ^= bench_seed >> 7;
+	bench_seed ^= bench_seed << 17;
+	return ((bench_seed >> 32) % n);
+}
+
+static void
+bench_add(struct bench_buf *b, const void *data, size_t len)
+{
+	if (b->used + len > b->size) {
+		b->size = (b->used + len) * 2;
+		b->data = xrealloc(b->data, b->size);
+	}
+	memcpy(b->data + b->used, data, len);
+	b->used += len;
+}
+
+/* Generate pane output: words, some coloured, some UTF-8, and newlines. */
+static void
+bench_generate(struct bench_buf *b, size_t size)
+{
+	static const char	*utf8[] = { "\320\264", "\344\270\226", "\303\251" };
+	const char		*s;
+	char			 tmp[32];
+	u_int			 i, n;
+
+	while (b->used < size) {
+		switch (bench_random(8)) {
+		case 0:
+			n = snprintf(tmp, sizeof tmp, "\033[%um",
+			    30 + bench_random(8));
+			bench_add(b, tmp, n);
+			break;
+		case 1:
+			bench_add(b, "\033[m", 3);
+			break;
+		case 2:
+			s = utf8[bench_random(nitems(utf8))];
+			bench_add(b, s, strlen(s));
+			break;
+		case 3:
+			bench_add(b, "\r\n", 2);
+			break;
+		}
+		n = 1 + bench_random(10);
+		for (i = 0; i < n; i++)
+			tmp[i] = 'a' + bench_random(26);
+		tmp[n++] = ' ';
+		bench_add(b, tmp, n);
+	}
+}
+
+/* Wrap output in %output lines of up to 4 KiB, escaped like control.c. */
+static void
+bench_encode(struct bench_buf *b, const struct bench_buf *raw)
+{
+	char	 tmp[8];
+	size_t	 off = 0, end;
+	u_char	 ch;
+
+	while (off < raw->used) {
+		end = off + 1 + bench_random(4096);
+		if (end > raw->used)
+			end = raw->used;
+		bench_add(b, "%output %1 ", 11);
+		for (; off < end; off++) {
+			ch = raw->data[off];
+			if (ch < ' ' || ch == '\\') {
+				snprintf(tmp, sizeof tmp, "\\%03o", ch);
+				bench_add(b, tmp, 4);
+			} else
+				bench_add(b, &ch, 1);
+		}
+		bench_add(b, "\n", 1);
+	}
+}
+
+static void
+bench_init(void)
+{
+	const struct options_table_entry	*oe;
+
+	global_environ = environ_create();
+	global_options = options_create(NULL);
+	global_s_options = options_create(NULL);
+	global_w_options = options_create(NULL);
+	for (oe = options_table; oe->name != NULL; oe++) {
+		if (oe->scope & OPTIONS_TABLE_SERVER)
+			options_default(global_options, oe);
+		if (oe->scope & OPTIONS_TABLE_SESSION)
+			options_default(global_s_options, oe);
+		if (oe->scope & OPTIONS_TABLE_WINDOW)
+			options_default(global_w_options, oe);
+	}
+	libevent = osdep_event_init();
+	socket_path = xstrdup("dummy");
+}
+
+/*
+ * Set up a remote client on one end of a pair, as input.c does, with one
+ * mirrored pane, %1.
+ */
+static struct remote *
+bench_remote(struct window **wout, struct bufferevent **conn,
+    struct client_pane **cpout)
+{
+	struct remote_pane_info	 pi;
+	struct window		*w;
+	struct window_pane	*control, *wp;
+	struct remote		*r;
+	struct client_pane	*cp;
+
+	w = window_create(80, 24, 0, 0);
+	control = window_add_pane(w, NULL, 0, 0);
+	w->active = control;
+	control->ictx = input_init(control, NULL, NULL);
+	window_pane_set_mode(control, NULL, &window_remote_mode, NULL, NULL);
+	wp = window_add_pane(w, NULL, 2000, 0);
+	window_add_ref(w, __func__);
+
+	bufferevent_pair_new(libevent, 0, conn);
+	r = remote_create(conn[0], control);
+
+	memset(&pi, 0, sizeof pi);
+	pi.pane_id = 1;
+	cp = remote_new_pane(r, &r->panes, wp, &pi);
+	cp->flags = 0;
+
+	/* Leave the decoded output in the pane's buffer instead of parsing. */
+	bufferevent_setcb(wp->event, NULL, NULL, NULL, NULL);
+
+	*wout = w;
+	*cpout = cp;
+	return (r);
+}
+
+/*
+ * Free the window. The mirrored pane pretends to have fd 1, which must not
+ * be closed. The remote client is left, it is not used again.
+ */
+static void
+bench_free(struct window *w, struct client_pane *cp)
+{
+	cp->cw.pane->fd = -1;
+	window_remove_ref(w, __func__);
+}
+
+/* Feed the stream in reads of bench_chunk bytes. Returns nanoseconds. */
+static uint64_t
+bench_output(struct bench_buf *stream, struct bench_buf *raw)
+{
+	struct bufferevent	*conn[2];
+	struct window		*w;
+	struct remote		*r;
+	struct client_pane	*cp;
+	struct evbuffer		*input, *decoded;
+	size_t			 off, n, done = 0, len;
+	uint64_t		 t, ns = 0;
+
+	r = bench_remote(&w, conn, &cp);
+	input = bufferevent_get_input(conn[0]);
+	evbuffer_unfreeze(input, 0);
+	decoded = bufferevent_get_input(cp->cw.pane->event);
+
+	for (off = 0; off < stream->used; off += n) {
+		n = stream->used - off;
+		if (n > bench_chunk)
+			n = bench_chunk;
+		evbuffer_add(input, stream->data + off, n);
+
+		t = bench_now();
+		remote_read_callback(conn[0], r);
+		ns += bench_now() - t;
+
+		bufferevent_flush(cp->event, EV_WRITE, BEV_FLUSH);
+		len = EVBUFFER_LENGTH(decoded);
+		if (done + len > raw->used ||
+		    memcmp(EVBUFFER_DATA(decoded), raw->data + done, len) != 0)
+			errx(1, "decoded output differs at %zu", done);
+		done += len;
+		evbuffer_drain(decoded, len);
+	}
+	if (done != raw->used)
+		errx(1, "decoded %zu bytes of %zu", done, raw->used);
+
+	bench_free(w, cp);
+	return (ns);
+}
+
+/* Dispatch the notifications repeats times. Returns nanoseconds. */
+static uint64_t
+bench_notify(u_int repeats)
+{
+	struct bufferevent	*conn[2];
+	struct window		*w;
+	struct remote		*r;
+	struct client_pane	*cp;
+	struct evbuffer		*decoded;
+	char			*lines[nitems(bench_events)];
+	size_t			 lens[nitems(bench_events)];
+	u_int			 i, n;
+	uint64_t		 t, ns = 0;
+
+	r = bench_remote(&w, conn, &cp);
+	decoded = bufferevent_get_input(cp->cw.pane->event);
+
+	for (i = 0; i < nitems(bench_events); i++) {
+		lens[i] = strlen(bench_events[i]);
+		lines[i] = xmalloc(lens[i] + 1);
+	}
+	for (n = 0; n < repeats; n++) {
+		/* Dispatching writes into the line, so copy it each time. */
+		for (i = 0; i < nitems(bench_events); i++)
+			memcpy(lines[i], bench_events[i], lens[i] + 1);
+
+		t = bench_now();
+		for (i = 0; i < nitems(bench_events); i++)
+			remote_dispatch_event(r, lines[i], lens[i]);
+		ns += bench_now() - t;
+
+		bufferevent_flush(cp->event, EV_WRITE, BEV_FLUSH);
+		evbuffer_drain(decoded, EV_SIZE_MAX);
+	}
+	for (i = 0; i < nitems(bench_events); i++)
+		free(lines[i]);
+
+	bench_free(w, cp);
+	return (ns);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct bench_buf	 raw, stream;
+	const char		*errstr;
+	u_int			 runs = 3, run, repeats = 100000, i;
+	size_t			 size = 16;
+	uint64_t		 ns, best;
+	int			 opt, output = 0, notify = 0;
+
+	setlocale(LC_CTYPE, "");
+	if (setlocale(LC_CTYPE, "C.UTF-8") == NULL)
+		setlocale(LC_CTYPE, "en_US.UTF-8");
+
+	while ((opt = getopt(argc, argv, "c:n:r:s:")) != -1) {
+		switch (opt) {
+		case 'c':
+			bench_chunk = strtonum(optarg, 1, INT_MAX, &errstr);
+			if (errstr != NULL)
+				errx(1, "chunk size %s", errstr);
+			break;
+		case 'n':
+			runs = strtonum(optarg, 1, 1000, &errstr);
+			if (errstr != NULL)
+				errx(1, "runs %s", errstr);
+			break;
+		case 'r':
+			repeats = strtonum(optarg, 1, INT_MAX, &errstr);
+			if (errstr != NULL)
+				errx(1, "repeats %s", errstr);
+			break;
+		case 's':
+			size = strtonum(optarg, 1, 4096, &errstr);
+			if (errstr != NULL)
+				errx(1, "size %s", errstr);
+			break;
+		default:
+			bench_usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	size *= 1024 * 1024;
+
+	if (argc == 0)
+		output = notify = 1;
+	for (i = 0; i < (u_int)argc; i++) {
+		if (strcmp(argv[i], "output") == 0)
+			output = 1;
+		else if (strcmp(argv[i], "notify") == 0)
+			notify = 1;
+		else
+			bench_usage();
+	}
+
+	bench_init();
+
+	if (output) {
+		memset(&raw, 0, sizeof raw);
+		memset(&stream, 0, sizeof stream);
+		bench_generate(&raw, size);
+		bench_encode(&stream, &raw);
+
+		best = 0;
+		for (run = 0; run < runs; run++) {
+			ns = bench_output(&stream, &raw);
+			if (run == 0 || ns < best)
+				best = ns;
+		}
+		printf("output     %10.2f MB/s of stream, %10.2f MB/s decoded\n",
+		    (double)stream.used / (1024 * 1024) / (best / 1e9),
+		    (double)raw.used / (1024 * 1024) / (best / 1e9));
+		free(raw.data);
+		free(stream.data);
+	}
+
+	if (notify) {
+		best = 0;
+		for (run = 0; run < runs; run++) {
+			ns = bench_notify(repeats);
+			if (run == 0 || ns < best)
+				best = ns;
+		}
+		printf("notify     %10.1f ns/event\n",
+		    (double)best / ((double)repeats * nitems(bench_events)));
+	}
+	return (0);
+}
@@ -61,6 +61,15 @@ grid_view_set_cells(struct grid *gd, u_int px, u_int py,
 	    slen);
 }
 
+/* Set UTF-8 cells. */
+void
+grid_view_set_utf8_cells(struct grid *gd, u_int px, u_int py,
+    const struct grid_cell *gc, const utf8_char *uc, size_t n)
+{
+	grid_set_utf8_cells(gd, grid_view_x(gd, px), grid_view_y(gd, py), gc,
+	    uc, n);
+}
+
 /* Clear into history. */
 void
 grid_view_clear_history(struct grid *gd, u_int bg)
@@ -18,8 +18,11 @@
 
 #include <sys/types.h>
 
+#include <errno.h>
+#include <libgen.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "tmux.h"
 
@@ -56,6 +59,214 @@ static const struct grid_cell_entry grid_cleared_entry = {
 	{ .data = { 0, 8, 8, ' ' } }, GRID_FLAG_CLEARED
 };
 
+/* Types of run in a packed line and the most bytes one cell can take. */
+#define GRID_PACK_CELLS 0
+#define GRID_PACK_EXTENDED 1
+#define GRID_PACK_MAX_CELL 14
+
+/* Unpacked history lines to allow before packing them all again. */
+#define GRID_UNPACKED_LINES 64
+
+/*
+ * Packed lines decoded for reading. These are copies so reading the history
+ * does not leave it unpacked or bring it back from the spill file; each is
+ * found by the packed data of its line, or by the spill file and offset if it
+ * is spilled, and dropped when that is freed.
+ */
+#define GRID_DECODED_LINES 64
+struct grid_decoded {
+	const void		*key;
+	off_t			 off;
+	struct grid_line	 gl;
+};
+static struct grid_decoded grid_decoded[GRID_DECODED_LINES];
+static u_int grid_decoded_used;
+static u_int grid_decoded_next;
+static u_int grid_decoded_last;
+
+/*
+ * Size of the blocks spilled history is written and read in, and the smallest
+ * spill file worth rewriting when most of it is no longer used.
+ */
+#define GRID_SPILL_BLOCK 65536
+#define GRID_SPILL_COMPACT (16 * GRID_SPILL_BLOCK)
+
+/* Lines of history reflowed at once when the rest is left until later. */
+#define GRID_REFLOW_LINES 1000
+
+/*
+ * History spilled to a file. Packed lines are appended to a block in memory
+ * which is written out when full, so a line is either wholly in the file or
+ * wholly in the tail block. Reads go through a cache of the last block read,
+ * which makes reading the history in order cheap. A copy of a grid shares its
+ * spill file rather than reading every line back in.
+ */
+struct grid_spill {
+	int			 fd;
+	u_int			 references;
+
+	off_t			 size;	/* bytes written to the file */
+	off_t			 live;	/* bytes still used by lines */
+
+	u_char			*tail;
+	size_t			 tailused;
+
+	u_char			*block;
+	off_t			 blockoff;
+	size_t			 blocklen;
+};
+
+/*
+ * Styles of extended cells. Each different set of attributes, colours and
+ * hyperlink is stored once and extended cells hold a reference to it by
+ * index. Index zero is the default style and is never freed; other styles
+ * are kept for reuse when the last reference goes away.
+ */
+struct grid_style {
+	u_short			attr;
+	int			fg;
+	int			bg;
+	int			us;
+	u_int			link;
+
+	u_int			idx;
+	u_int			references;
+	RB_ENTRY(grid_style)	entry;
+};
+
+static int
+grid_style_cmp(struct grid_style *gs1, struct grid_style *gs2)
+{
+	if (gs1->fg != gs2->fg)
+		return (gs1->fg < gs2->fg ? -1 : 1);
+	if (gs1->bg != gs2->bg)
+		return (gs1->bg < gs2->bg ? -1 : 1);
+	if (gs1->attr != gs2->attr)
+		return (gs1->attr < gs2->attr ? -1 : 1);
+	if (gs1->us != gs2->us)
+		return (gs1->us < gs2->us ? -1 : 1);
+	if (gs1->link != gs2->link)
+		return (gs1->link < gs2->link ? -1 : 1);
+	return (0);
+}
+RB_HEAD(grid_style_tree, grid_style);
+RB_GENERATE_STATIC(grid_style_tree, grid_style, entry, grid_style_cmp);
+static struct grid_style_tree grid_style_tree =
+    RB_INITIALIZER(grid_style_tree);
+
+static struct grid_style **grid_style_list;
+static u_int		   grid_style_size;
+static u_int		  *grid_style_unused;
+static u_int		   grid_style_nunused;
+static u_int		   grid_style_unused_size;
+static u_int		   grid_style_last;
+
+/* Check if a style matches a cell. */
+static int
+grid_style_equal(u_int idx, const struct grid_cell *gc)
+{
+	struct grid_style	*gs = grid_style_list[idx];
+
+	return (gs->fg == gc->fg &&
+	    gs->bg == gc->bg &&
+	    gs->attr == gc->attr &&
+	    gs->us == gc->us &&
+	    gs->link == gc->link);
+}
+
+/* Add the default style. */
+static void
+grid_style_init(void)
+{
+	struct grid_style	*gs;
+
+	gs = xcalloc(1, sizeof *gs);
+	gs->fg = gs->bg = gs->us = 8;
+	RB_INSERT(grid_style_tree, &grid_style_tree, gs);
+
+	grid_style_list = xcalloc(1, sizeof *grid_style_list);
+	grid_style_list[0] = gs;
+	grid_style_size = 1;
+}
+
+/* Keep a style that is not in the tree for reuse. */
+static void
+grid_style_set_unused(u_int idx)
+{
+	if (grid_style_nunused == grid_style_unused_size) {
+		grid_style_unused_size = grid_style_unused_size * 2 + 16;
+		grid_style_unused = xreallocarray(grid_style_unused,
+		    grid_style_unused_size, sizeof *grid_style_unused);
+	}
+	grid_style_unused[grid_style_nunused++] = idx;
+}
+
+/* Find or add the style for a cell and take a reference to it. */
+static u_int
+grid_style_add(const struct grid_cell *gc)
+{
+	struct grid_style	*gs, *found;
+	u_int			 idx;
+
+	/* Runs of cells usually share a style, so try the last one first. */
+	if (grid_style_equal(grid_style_last, gc))
+		gs = grid_style_list[grid_style_last];
+	else {
+		if (grid_style_nunused == 0) {
+			idx = grid_style_size++;
+			grid_style_list = xreallocarray(grid_style_list,
+			    grid_style_size, sizeof *grid_style_list);
+			gs = grid_style_list[idx] = xmalloc(sizeof *gs);
+			gs->idx = idx;
+			grid_style_set_unused(idx);
+		}
+
+		/* Fill in an unused style and only keep it if it is new. */
+		gs = grid_style_list[grid_style_unused[grid_style_nunused - 1]];
+		gs->attr = gc->attr;
+		gs->fg = gc->fg;
+		gs->bg = gc->bg;
+		gs->us = gc->us;
+		gs->link = gc->link;
+		gs->references = 0;
+		found = RB_INSERT(grid_style_tree, &grid_style_tree, gs);
+		if (found != NULL)
+			gs = found;
+		else
+			grid_style_nunused--;
+		grid_style_last = gs->idx;
+	}
+	if (gs->idx != 0)
+		gs->references++;
+	return (gs->idx);
+}
+
+/* Take another reference to a style. */
+static void
+grid_style_reference(u_int idx)
+{
+	if (idx != 0)
+		grid_style_list[idx]->references++;
+}
+
+/* Drop a reference to a style and keep it for reuse if it was the last. */
+static void
+grid_style_release(u_int idx)
+{
+	struct grid_style	*gs;
+
+	if (idx == 0)
+		return;
+	gs = grid_style_list[idx];
+	if (--gs->references != 0)
+		return;
+
+	RB_REMOVE(grid_style_tree, &grid_style_tree, gs);
+	grid_style_set_unused(idx);
+	if (grid_style_last == idx)
+		grid_style_last = 0;
+}
+
 /* Store cell in entry. */
 static void
 grid_store_cell(struct grid_cell_entry *gce, const struct grid_cell *gc,
@@ -99,13 +310,15 @@ grid_need_extended_cell(const struct grid_cell_entry *gce,
 
 /* Get an extended cell. */
 static void
-grid_get_extended_cell(struct grid_line *gl, struct grid_cell_entry *gce,
-    int flags)
+grid_get_extended_cell(struct grid *gd, struct grid_line *gl,
+    struct grid_cell_entry *gce, int flags)
 {
 	u_int at = gl->extdsize + 1;
 
 	gl->extddata = xreallocarray(gl->extddata, at, sizeof *gl->extddata);
 	gl->extdsize = at;
+	gd->bytes += sizeof *gl->extddata;
+	memset(&gl->extddata[at - 1], 0, sizeof *gl->extddata);
 
 	gce->offset = at - 1;
 	gce->flags = (flags | GRID_FLAG_EXTENDED);
@@ -113,15 +326,16 @@ grid_get_extended_cell(struct grid_line *gl, struct grid_cell_entry *gce,
 
 /* Set cell as extended. */
 static struct grid_extd_entry *
-grid_extended_cell(struct grid_line *gl, struct grid_cell_entry *gce,
-    const struct grid_cell *gc)
+grid_extended_cell(struct grid *gd, struct grid_line *gl,
+    struct grid_cell_entry *gce, const struct grid_cell *gc)
 {
 	struct grid_extd_entry	*gee;
 	int			 flags = (gc->flags & ~GRID_FLAG_CLEARED);
 	utf8_char		 uc;
+	u_int			 style;
 
 	if (~gce->flags & GRID_FLAG_EXTENDED)
-		grid_get_extended_cell(gl, gce, flags);
+		grid_get_extended_cell(gd, gl, gce, flags);
 	else if (gce->offset >= gl->extdsize)
 		fatalx("offset too big");
 	gl->flags |= GRID_LINE_EXTENDED;
@@ -133,15 +347,27 @@ grid_extended_cell(struct grid_line *gl, struct grid_cell_entry *gce,
 
 	gee = &gl->extddata[gce->offset];
 	gee->data = uc;
-	gee->attr = gc->attr;
 	gee->flags = flags;
-	gee->fg = gc->fg;
-	gee->bg = gc->bg;
-	gee->us = gc->us;
-	gee->link = gc->link;
+	if (!grid_style_equal(gee->style, gc)) {
+		style = grid_style_add(gc);
+		grid_style_release(gee->style);
+		gee->style = style;
+	}
 	return (gee);
 }
 
+/* Bytes of cell data held by a line. */
+static size_t
+grid_line_bytes(const struct grid_line *gl)
+{
+	if (gl->flags & GRID_LINE_SPILLED)
+		return (0);
+	if (gl->flags & GRID_LINE_PACKED)
+		return (gl->packsize);
+	return (gl->cellsize * sizeof *gl->celldata +
+	    gl->extdsize * sizeof *gl->extddata);
+}
+
 /* Free up unused extended cells. */
 static void
 grid_compact_line(struct grid_line *gl)
@@ -162,6 +388,8 @@ grid_compact_line(struct grid_line *gl)
 	}
 
 	if (new_extdsize == 0) {
+		for (idx = 0; idx < gl->extdsize; idx++)
+			grid_style_release(gl->extddata[idx].style);
 		free(gl->extddata);
 		gl->extddata = NULL;
 		gl->extdsize = 0;
@@ -175,43 +403,612 @@ grid_compact_line(struct grid_line *gl)
 		if (gce->flags & GRID_FLAG_EXTENDED) {
 			gee = &gl->extddata[gce->offset];
 			memcpy(&new_extddata[idx], gee, sizeof *gee);
+			gee->style = 0;
 			gce->offset = idx++;
 		}
 	}
 
+	/* Anything not moved across is no longer used. */
+	for (idx = 0; idx < gl->extdsize; idx++)
+		grid_style_release(gl->extddata[idx].style);
 	free(gl->extddata);
 	gl->extddata = new_extddata;
 	gl->extdsize = new_extdsize;
 }
 
-/* Get line data. */
+/* Add a number to packed data, seven bits at a time. */
+static u_char *
+grid_pack_number(u_char *p, u_int n)
+{
+	while (n >= 0x80) {
+		*p++ = (n & 0x7f)|0x80;
+		n >>= 7;
+	}
+	*p++ = n;
+	return (p);
+}
+
+/* Read a number from packed data. */
+static const u_char *
+grid_unpack_number(const u_char *p, u_int *n)
+{
+	u_int	shift = 0;
+
+	*n = 0;
+	do {
+		*n |= (u_int)(*p & 0x7f) << shift;
+		shift += 7;
+	} while (*p++ & 0x80);
+	return (p);
+}
+
+/*
+ * Pack a line into a byte string. This starts with the number of cells and
+ * is followed by runs of cells which look the same. A run of plain cells has
+ * the cell flags, attributes and colours once then one byte of data for each
+ * cell; a run of extended cells has the flags and style index once then the
+ * character of each cell. Extended cells keep their style references.
+ */
+static void
+grid_pack_line(struct grid_line *gl)
+{
+	static u_char		*buf;
+	static size_t		 bufsize;
+	struct grid_cell_entry	*gce, *first;
+	struct grid_extd_entry	*gee, *first_gee;
+	u_char			*p;
+	size_t			 size;
+	u_int			 px, i, n;
+
+	if (gl->flags & (GRID_LINE_PACKED|GRID_LINE_DEAD) || gl->cellsize == 0)
+		return;
+	grid_compact_line(gl);
+
+	size = 5 + gl->cellsize * (size_t)GRID_PACK_MAX_CELL;
+	if (size > bufsize) {
+		buf = xrealloc(buf, size);
+		bufsize = size;
+	}
+	p = grid_pack_number(buf, gl->cellsize);
+
+	for (px = 0; px < gl->cellsize; px += n) {
+		first = &gl->celldata[px];
+		if (~first->flags & GRID_FLAG_EXTENDED) {
+			for (n = 1; px + n < gl->cellsize; n++) {
+				gce = &first[n];
+				if (gce->flags != first->flags ||
+				    gce->data.attr != first->data.attr ||
+				    gce->data.fg != first->data.fg ||
+				    gce->data.bg != first->data.bg)
+					break;
+			}
+			*p++ = GRID_PACK_CELLS;
+			p = grid_pack_number(p, n);
+			*p++ = first->flags;
+			*p++ = first->data.attr;
+			*p++ = first->data.fg;
+			*p++ = first->data.bg;
+			for (i = 0; i < n; i++)
+				*p++ = first[i].data.data;
+		} else {
+			first_gee = &gl->extddata[first->offset];
+			for (n = 1; px + n < gl->cellsize; n++) {
+				gce = &first[n];
+				if (gce->flags != first->flags)
+					break;
+				gee = &gl->extddata[gce->offset];
+				if (gee->flags != first_gee->flags ||
+				    gee->style != first_gee->style)
+					break;
+			}
+			*p++ = GRID_PACK_EXTENDED;
+			p = grid_pack_number(p, n);
+			*p++ = first->flags;
+			*p++ = first_gee->flags;
+			p = grid_pack_number(p, first_gee->style);
+			for (i = 0; i < n; i++) {
+				gee = &gl->extddata[first[i].offset];
+				p = grid_pack_number(p, gee->data);
+			}
+		}
+	}
+
+	free(gl->celldata);
+	free(gl->extddata);
+	gl->extddata = NULL;
+	gl->extdsize = 0;
+
+	gl->packsize = p - buf;
+	gl->packdata = xmalloc(gl->packsize);
+	memcpy(gl->packdata, buf, gl->packsize);
+	gl->flags |= GRID_LINE_PACKED;
+}
+
+/*
+ * Unpack a line packed by grid_pack_line from its packed data, which is left
+ * for the caller to free.
+ */
+static void
+grid_unpack_line(struct grid_line *gl, const u_char *p)
+{
+	struct grid_cell_entry	*celldata, *gce;
+	struct grid_extd_entry	*extddata = NULL, *gee;
+	u_int			 cellsize, extdsize = 0, extdalloc = 0;
+	u_int			 px, i, n, style, data;
+	u_char			 type, flags, eflags, attr, fg, bg;
+
+	p = grid_unpack_number(p, &cellsize);
+	celldata = xreallocarray(NULL, cellsize, sizeof *celldata);
+
+	for (px = 0; px < cellsize; px += n) {
+		type = *p++;
+		p = grid_unpack_number(p, &n);
+		gce = &celldata[px];
+		if (type == GRID_PACK_CELLS) {
+			flags = *p++;
+			attr = *p++;
+			fg = *p++;
+			bg = *p++;
+			for (i = 0; i < n; i++) {
+				gce[i].flags = flags;
+				gce[i].data.attr = attr;
+				gce[i].data.fg = fg;
+				gce[i].data.bg = bg;
+				gce[i].data.data = *p++;
+			}
+		} else {
+			flags = *p++;
+			eflags = *p++;
+			p = grid_unpack_number(p, &style);
+			if (extdsize + n > extdalloc) {
+				extdalloc = extdsize + n;
+				if (extdalloc < cellsize - px)
+					extdalloc = cellsize - px;
+				extddata = xreallocarray(extddata, extdalloc,
+				    sizeof *extddata);
+			}
+			for (i = 0; i < n; i++) {
+				p = grid_unpack_number(p, &data);
+				gee = &extddata[extdsize];
+				gee->data = data;
+				gee->flags = eflags;
+				gee->style = style;
+				gce[i].flags = flags;
+				gce[i].offset = extdsize++;
+			}
+		}
+	}
+	if (extdsize != extdalloc) {
+		extddata = xreallocarray(extddata, extdsize,
+		    sizeof *extddata);
+	}
+
+	gl->flags &= ~GRID_LINE_PACKED;
+	gl->celldata = celldata;
+	gl->cellsize = cellsize;
+	gl->extddata = extddata;
+	gl->extdsize = extdsize;
+}
+
+/* Add or release a reference to each style used by a packed line. */
+static void
+grid_pack_styles(const u_char *p, int add)
+{
+	u_int	cellsize, px, i, n, style, data;
+
+	p = grid_unpack_number(p, &cellsize);
+	for (px = 0; px < cellsize; px += n) {
+		if (*p++ == GRID_PACK_CELLS) {
+			p = grid_unpack_number(p, &n);
+			p += 4 + n;
+			continue;
+		}
+		p = grid_unpack_number(p, &n);
+		p = grid_unpack_number(p + 2, &style);
+		for (i = 0; i < n; i++) {
+			p = grid_unpack_number(p, &data);
+			if (add)
+				grid_style_reference(style);
+			else
+				grid_style_release(style);
+		}
+	}
+}
+
+/* Drop any decoded copies of lines whose packed data or spill file is going. */
+static void
+grid_decoded_forget(const void *key)
+{
+	struct grid_decoded	*gdc;
+	u_int			 i;
+
+	if (grid_decoded_used == 0)
+		return;
+	for (i = 0; i < GRID_DECODED_LINES; i++) {
+		gdc = &grid_decoded[i];
+		if (gdc->key != key)
+			continue;
+		free(gdc->gl.celldata);
+		free(gdc->gl.extddata);
+		gdc->key = NULL;
+		grid_decoded_used--;
+	}
+}
+
+/*
+ * Create a spill file. It is made in the same directory as the server socket,
+ * which only this user can use, and is removed straight away so only the open
+ * file remains.
+ */
+static struct grid_spill *
+grid_spill_create(void)
+{
+	struct grid_spill	*sp;
+	char			*copy, *path;
+	int			 fd;
+
+	copy = xstrdup(socket_path);
+	xasprintf(&path, "%s/spill-XXXXXXXX", dirname(copy));
+	fd = mkstemp(path);
+	if (fd != -1)
+		unlink(path);
+	else
+		log_debug("%s: %s: %s", __func__, path, strerror(errno));
+	free(path);
+	free(copy);
+	if (fd == -1)
+		return (NULL);
+
+	sp = xcalloc(1, sizeof *sp);
+	sp->fd = fd;
+	sp->references = 1;
+	sp->tail = xmalloc(GRID_SPILL_BLOCK);
+	sp->block = xmalloc(GRID_SPILL_BLOCK);
+	return (sp);
+}
+
+/* Drop a reference to a spill file and close it if it was the last. */
+static void
+grid_spill_free(struct grid_spill *sp)
+{
+	if (--sp->references != 0)
+		return;
+	grid_decoded_forget(sp);
+	close(sp->fd);
+	free(sp->tail);
+	free(sp->block);
+	free(sp);
+}
+
+/* Write all of a buffer to a spill file. */
+static int
+grid_spill_pwrite(struct grid_spill *sp, const u_char *buf, size_t size,
+    off_t off)
+{
+	ssize_t	n;
+
+	while (size != 0) {
+		n = pwrite(sp->fd, buf, size, off);
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			log_debug("%s: %s", __func__, strerror(errno));
+			return (-1);
+		}
+		buf += n;
+		size -= n;
+		off += n;
+	}
+	return (0);
+}
+
+/* Append a packed line to a spill file and return where it was put. */
+static off_t
+grid_spill_write(struct grid_spill *sp, const u_char *data, size_t size)
+{
+	off_t	off;
+
+	if (sp->tailused + size > GRID_SPILL_BLOCK && sp->tailused != 0) {
+		if (grid_spill_pwrite(sp, sp->tail, sp->tailused,
+		    sp->size) != 0)
+			return (-1);
+		sp->size += sp->tailused;
+		sp->tailused = 0;
+	}
+	if (size > GRID_SPILL_BLOCK) {
+		if (grid_spill_pwrite(sp, data, size, sp->size) != 0)
+			return (-1);
+		off = sp->size;
+		sp->size += size;
+	} else {
+		memcpy(sp->tail + sp->tailused, data, size);
+		off = sp->size + sp->tailused;
+		sp->tailused += size;
+	}
+	sp->live += size;
+	return (off);
+}
+
+/* Read a packed line back from a spill file. */
+static void
+grid_spill_read(struct grid_spill *sp, off_t off, u_char *buf, size_t size)
+{
+	off_t	blockoff;
+	ssize_t	n;
+
+	if (off >= sp->size) {
+		memcpy(buf, sp->tail + (off - sp->size), size);
+		return;
+	}
+
+	if (off < sp->blockoff ||
+	    off + (off_t)size > sp->blockoff + (off_t)sp->blocklen) {
+		blockoff = off - (off % GRID_SPILL_BLOCK);
+		sp->blocklen = 0;
+		do
+			n = pread(sp->fd, sp->block, GRID_SPILL_BLOCK, blockoff);
+		while (n == -1 && errno == EINTR);
+		if (n > 0) {
+			sp->blockoff = blockoff;
+			sp->blocklen = n;
+		}
+	}
+	if (off >= sp->blockoff &&
+	    off + (off_t)size <= sp->blockoff + (off_t)sp->blocklen) {
+		memcpy(buf, sp->block + (off - sp->blockoff), size);
+		return;
+	}
+
+	/* Lines across the end of a block or bigger than one are read alone. */
+	while (size != 0) {
+		n = pread(sp->fd, buf, size, off);
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			fatalx("spill file read failed");
+		buf += n;
+		size -= n;
+		off += n;
+	}
+}
+
+/* Bring a spilled line back into memory, still packed. */
+static void
+grid_unspill_line(struct grid *gd, struct grid_line *gl)
+{
+	u_char	*data;
+
+	data = xmalloc(gl->packsize);
+	grid_spill_read(gd->spill, gl->spilloff, data, gl->packsize);
+	gd->spill->live -= gl->packsize;
+
+	gl->packdata = data;
+	gl->flags &= ~GRID_LINE_SPILLED;
+	gd->bytes += gl->packsize;
+}
+
+/* Find a line in the ring. */
+static struct grid_line *
+grid_slot(struct grid *gd, u_int py)
+{
+	py += gd->linestart;
+	if (py >= gd->linesize)
+		py -= gd->linesize;
+	return (&gd->linedata[py]);
+}
+
+/* Find a line in the ring and unpack it if needed. */
+static struct grid_line *
+grid_line(struct grid *gd, u_int py)
+{
+	struct grid_line	*gl = grid_slot(gd, py);
+	u_char			*data;
+	size_t			 bytes;
+
+	if (gl->flags & GRID_LINE_PACKED) {
+		if (gl->flags & GRID_LINE_SPILLED)
+			grid_unspill_line(gd, gl);
+		bytes = gl->packsize;
+		data = gl->packdata;
+		grid_decoded_forget(data);
+		grid_unpack_line(gl, data);
+		free(data);
+		gd->bytes += grid_line_bytes(gl) - bytes;
+		gd->hunpacked++;
+	}
+	return (gl);
+}
+
+/*
+ * Find a line in the ring for reading. A packed line is decoded into a copy
+ * which is kept in case it is read again, rather than unpacked in place and
+ * left in memory until the history is next packed. The copy must not be
+ * changed and is only valid until more lines are read.
+ */
+static struct grid_line *
+grid_read_line(struct grid *gd, u_int py)
+{
+	struct grid_line	*gl = grid_slot(gd, py);
+	struct grid_decoded	*gdc;
+	const void		*key;
+	u_char			*data;
+	off_t			 off;
+	u_int			 i;
+
+	if (~gl->flags & GRID_LINE_PACKED)
+		return (gl);
+	if (gl->flags & GRID_LINE_SPILLED) {
+		key = gd->spill;
+		off = gl->spilloff;
+	} else {
+		key = gl->packdata;
+		off = -1;
+	}
+
+	gdc = &grid_decoded[grid_decoded_last];
+	if (gdc->key != key || gdc->off != off) {
+		for (i = 0; i < GRID_DECODED_LINES; i++) {
+			gdc = &grid_decoded[i];
+			if (gdc->key == key && gdc->off == off)
+				break;
+		}
+		if (i == GRID_DECODED_LINES) {
+			i = grid_decoded_next;
+			grid_decoded_next = (i + 1) % GRID_DECODED_LINES;
+			gdc = &grid_decoded[i];
+			if (gdc->key != NULL) {
+				free(gdc->gl.celldata);
+				free(gdc->gl.extddata);
+			} else
+				grid_decoded_used++;
+			gdc->key = key;
+			gdc->off = off;
+			if (off != -1) {
+				data = xmalloc(gl->packsize);
+				grid_spill_read(gd->spill, off, data,
+				    gl->packsize);
+				grid_unpack_line(&gdc->gl, data);
+				free(data);
+			} else
+				grid_unpack_line(&gdc->gl, gl->packdata);
+		}
+		grid_decoded_last = i;
+	}
+
+	/* The line may have been changed since without being unpacked. */
+	gdc->gl.cellused = gl->cellused;
+	gdc->gl.flags = gl->flags & ~(GRID_LINE_PACKED|GRID_LINE_SPILLED);
+	gdc->gl.time = gl->time;
+	return (&gdc->gl);
+}
+
+/*
+ * Change the size of the ring. Lines past the new size are lost, new lines
+ * are not initialized.
+ */
+static void
+grid_resize_lines(struct grid *gd, u_int size)
+{
+	struct grid_line	*linedata;
+	u_int			 used = gd->hsize + gd->sy, first;
+
+	if (used > size)
+		used = size;
+	if (gd->linestart == 0 || used == 0) {
+		gd->linedata = xreallocarray(gd->linedata, size,
+		    sizeof *gd->linedata);
+	} else {
+		linedata = xreallocarray(NULL, size, sizeof *linedata);
+		first = gd->linesize - gd->linestart;
+		if (first > used)
+			first = used;
+		memcpy(linedata, &gd->linedata[gd->linestart],
+		    first * sizeof *linedata);
+		memcpy(linedata + first, gd->linedata,
+		    (used - first) * sizeof *linedata);
+		free(gd->linedata);
+		gd->linedata = linedata;
+	}
+	gd->linestart = 0;
+	gd->linesize = size;
+}
+
+/*
+ * Make sure there is room for a number of lines. The ring doubles in size
+ * until it is big enough for the full history, then stays there.
+ */
+static void
+grid_reserve_lines(struct grid *gd, u_int lines)
+{
+	u_int	size, limit = gd->hlimit + gd->sy;
+
+	if (lines <= gd->linesize)
+		return;
+	size = gd->linesize * 2;
+	if (size < lines)
+		size = lines;
+	if (size > limit && limit >= lines)
+		size = limit;
+	grid_resize_lines(gd, size);
+}
+
+/*
+ * Move lines within the ring, like memmove. This is done in pieces so that
+ * neither the source nor the destination goes past the end of the array.
+ */
+static void
+grid_move_line_data(struct grid *gd, u_int dy, u_int py, u_int ny)
+{
+	struct grid_line	*dl, *pl;
+	u_int			 n, dn, pn;
+
+	if (dy < py) {
+		while (ny != 0) {
+			dl = grid_slot(gd, dy);
+			pl = grid_slot(gd, py);
+			n = ny;
+			dn = gd->linesize - (dl - gd->linedata);
+			if (n > dn)
+				n = dn;
+			pn = gd->linesize - (pl - gd->linedata);
+			if (n > pn)
+				n = pn;
+			memmove(dl, pl, n * sizeof *dl);
+			dy += n;
+			py += n;
+			ny -= n;
+		}
+	} else if (dy > py) {
+		while (ny != 0) {
+			dl = grid_slot(gd, dy + ny - 1);
+			pl = grid_slot(gd, py + ny - 1);
+			n = ny;
+			dn = dl - gd->linedata + 1;
+			if (n > dn)
+				n = dn;
+			pn = pl - gd->linedata + 1;
+			if (n > pn)
+				n = pn;
+			memmove(dl - n + 1, pl - n + 1, n * sizeof *dl);
+			ny -= n;
+		}
+	}
+}
+
+/*
+ * Get line data. A line in the history may be a decoded copy, so only lines on
+ * screen may be changed.
+ */
 struct grid_line *
 grid_get_line(struct grid *gd, u_int line)
 {
-	return (&gd->linedata[line]);
+	if (line < gd->hsize)
+		return (grid_read_line(gd, line));
+	return (grid_line(gd, line));
 }
 
 /* Adjust number of lines. */
 void
 grid_adjust_lines(struct grid *gd, u_int lines)
 {
-	gd->linedata = xreallocarray(gd->linedata, lines, sizeof *gd->linedata);
+	grid_reserve_lines(gd, lines);
 }
 
 /* Copy default into a cell. */
 static void
 grid_clear_cell(struct grid *gd, u_int px, u_int py, u_int bg)
 {
-	struct grid_line	*gl = &gd->linedata[py];
+	struct grid_line	*gl = grid_line(gd, py);
 	struct grid_cell_entry	*gce = &gl->celldata[px];
-	struct grid_extd_entry	*gee;
+	struct grid_cell	 gc;
 
 	memcpy(gce, &grid_cleared_entry, sizeof *gce);
 	if (bg != 8) {
 		if (bg & COLOUR_FLAG_RGB) {
-			grid_get_extended_cell(gl, gce, gce->flags);
-			gee = grid_extended_cell(gl, gce, &grid_cleared_cell);
-			gee->bg = bg;
+			memcpy(&gc, &grid_cleared_cell, sizeof gc);
+			gc.bg = bg;
+			grid_get_extended_cell(gd, gl, gce, gce->flags);
+			grid_extended_cell(gd, gl, gce, &gc);
 		} else {
 			if (bg & COLOUR_FLAG_256)
 				gce->flags |= GRID_FLAG_BG256;
@@ -275,10 +1072,35 @@ grid_set_tab(struct grid_cell *gc, u_int width)
 static void
 grid_free_line(struct grid *gd, u_int py)
 {
-	free(gd->linedata[py].celldata);
-	gd->linedata[py].celldata = NULL;
-	free(gd->linedata[py].extddata);
-	gd->linedata[py].extddata = NULL;
+	struct grid_line	*gl = grid_slot(gd, py);
+	u_int			 i;
+
+	/* Only lines with extended cells need to be read to drop styles. */
+	if (gl->flags & GRID_LINE_SPILLED) {
+		if (gl->flags & GRID_LINE_EXTENDED)
+			grid_unspill_line(gd, gl);
+		else {
+			gd->spill->live -= gl->packsize;
+			gl->flags &= ~(GRID_LINE_SPILLED|GRID_LINE_PACKED);
+			gl->packdata = NULL;
+			gl->packsize = 0;
+		}
+	}
+
+	gd->bytes -= grid_line_bytes(gl);
+	if (gl->flags & GRID_LINE_PACKED) {
+		grid_decoded_forget(gl->packdata);
+		grid_pack_styles(gl->packdata, 0);
+		gl->flags &= ~GRID_LINE_PACKED;
+	}
+	free(gl->celldata);
+	gl->celldata = NULL;
+	gl->cellsize = 0;
+	for (i = 0; i < gl->extdsize; i++)
+		grid_style_release(gl->extddata[i].style);
+	free(gl->extddata);
+	gl->extddata = NULL;
+	gl->extdsize = 0;
 }
 
 /* Free several lines. */
@@ -297,6 +1119,9 @@ grid_create(u_int sx, u_int sy, u_int hlimit)
 {
 	struct grid	*gd;
 
+	if (grid_style_list == NULL)
+		grid_style_init();
+
 	gd = xmalloc(sizeof *gd);
 	gd->sx = sx;
 	gd->sy = sy;
@@ -310,10 +1135,22 @@ grid_create(u_int sx, u_int sy, u_int hlimit)
 	gd->hsize = 0;
 	gd->hlimit = hlimit;
 
+	gd->hcompress = 0;
+	gd->hunpacked = 0;
+	gd->htrimmed = 0;
+	gd->bytes = 0;
+
+	gd->hspill = 0;
+	gd->spill = NULL;
+
+	gd->hreflow = 0;
+
 	if (gd->sy != 0)
 		gd->linedata = xcalloc(gd->sy, sizeof *gd->linedata);
 	else
 		gd->linedata = NULL;
+	gd->linestart = 0;
+	gd->linesize = gd->sy;
 
 	return (gd);
 }
@@ -323,6 +1160,8 @@ void
 grid_destroy(struct grid *gd)
 {
 	grid_free_lines(gd, 0, gd->hsize + gd->sy);
+	if (gd->spill != NULL)
+		grid_spill_free(gd->spill);
 
 	free(gd->linedata);
 
@@ -341,8 +1180,8 @@ grid_compare(struct grid *ga, struct grid *gb)
 		return (1);
 
 	for (yy = 0; yy < ga->sy; yy++) {
-		gla = &ga->linedata[yy];
-		glb = &gb->linedata[yy];
+		gla = grid_read_line(ga, yy);
+		glb = grid_read_line(gb, yy);
 		if (gla->cellsize != glb->cellsize)
 			return (1);
 		for (xx = 0; xx < gla->cellsize; xx++) {
@@ -356,18 +1195,223 @@ grid_compare(struct grid *ga, struct grid *gb)
 	return (0);
 }
 
+/*
+ * Checksum the text of some lines, ignoring attributes and trailing spaces,
+ * so two grids with the same text give the same result however they were
+ * drawn.
+ */
+u_int
+grid_checksum(struct grid *gd, u_int py, u_int ny)
+{
+	struct grid_line	*gl;
+	struct grid_cell	 gc;
+	u_int			 csum = 0, xx, yy, end, i;
+
+	for (yy = py; yy < py + ny && yy < gd->hsize + gd->sy; yy++) {
+		gl = grid_get_line(gd, yy);
+		for (end = gl->cellused; end > 0; end--) {
+			grid_get_cell(gd, end - 1, yy, &gc);
+			if (gc.data.size != 1 || *gc.data.data != ' ')
+				break;
+		}
+		for (xx = 0; xx < end; xx++) {
+			grid_get_cell(gd, xx, yy, &gc);
+			if (gc.flags & GRID_FLAG_PADDING)
+				continue;
+			for (i = 0; i < gc.data.size; i++) {
+				csum = (csum >> 1) + ((csum & 1) << 31);
+				csum += gc.data.data[i];
+			}
+		}
+		csum = (csum >> 1) + ((csum & 1) << 31);
+		csum += '\n';
+	}
+	return (csum);
+}
+
+/*
+ * Reclaim space in the spill file once most of it is no longer used: empty it
+ * if nothing is left or write the remaining lines to a new one. A line which
+ * cannot be written is kept in memory instead.
+ */
+static void
+grid_spill_collect(struct grid *gd)
+{
+	struct grid_spill	*sp = gd->spill, *new;
+	struct grid_line	*gl;
+	u_char			*data;
+	off_t			 total, off;
+	u_int			 yy;
+
+	if (sp == NULL || sp->references != 1)
+		return;
+	total = sp->size + sp->tailused;
+	if (sp->live == 0) {
+		if (total != 0 && ftruncate(sp->fd, 0) == 0) {
+			grid_decoded_forget(sp);
+			sp->size = 0;
+			sp->tailused = 0;
+			sp->blocklen = 0;
+		}
+		return;
+	}
+	if (total < GRID_SPILL_COMPACT || sp->live > total / 2)
+		return;
+	if ((new = grid_spill_create()) == NULL)
+		return;
+	log_debug("%s: %lld of %lld bytes used", __func__,
+	    (long long)sp->live, (long long)total);
+
+	for (yy = 0; yy < gd->hsize + gd->sy; yy++) {
+		gl = grid_slot(gd, yy);
+		if (~gl->flags & GRID_LINE_SPILLED)
+			continue;
+		data = xmalloc(gl->packsize);
+		grid_spill_read(sp, gl->spilloff, data, gl->packsize);
+		off = grid_spill_write(new, data, gl->packsize);
+		if (off != -1) {
+			gl->spilloff = off;
+			free(data);
+		} else {
+			gl->packdata = data;
+			gl->flags &= ~GRID_LINE_SPILLED;
+			gd->bytes += gl->packsize;
+		}
+	}
+	grid_spill_free(sp);
+	gd->spill = new;
+}
+
 /* Trim lines from the history. */
 static void
 grid_trim_history(struct grid *gd, u_int ny)
 {
 	grid_free_lines(gd, 0, ny);
-	memmove(&gd->linedata[0], &gd->linedata[ny],
-	    (gd->hsize + gd->sy - ny) * (sizeof *gd->linedata));
+	gd->linestart += ny;
+	if (gd->linestart >= gd->linesize)
+		gd->linestart -= gd->linesize;
+
+	gd->hsize -= ny;
+	gd->htrimmed += ny;
+	if (gd->hscrolled > gd->hsize)
+		gd->hscrolled = gd->hsize;
+	if (gd->hreflow > ny)
+		gd->hreflow -= ny;
+	else
+		gd->hreflow = 0;
+	grid_spill_collect(gd);
+}
+
+/* Pack one line and account for the change in size. */
+static void
+grid_pack_slot(struct grid *gd, u_int py)
+{
+	struct grid_line	*gl = grid_slot(gd, py);
+
+	gd->bytes -= grid_line_bytes(gl);
+	grid_pack_line(gl);
+	gd->bytes += grid_line_bytes(gl);
+}
+
+/* Pack one line and write it to the spill file. */
+static void
+grid_spill_slot(struct grid *gd, u_int py)
+{
+	struct grid_line	*gl = grid_slot(gd, py);
+	off_t			 off;
+
+	grid_pack_slot(gd, py);
+	if ((gl->flags & (GRID_LINE_PACKED|GRID_LINE_SPILLED)) !=
+	    GRID_LINE_PACKED)
+		return;
+
+	if (gd->spill == NULL && (gd->spill = grid_spill_create()) == NULL) {
+		gd->hspill = 0;
+		return;
+	}
+	off = grid_spill_write(gd->spill, gl->packdata, gl->packsize);
+	if (off == -1)
+		return;
+
+	gd->bytes -= gl->packsize;
+	grid_decoded_forget(gl->packdata);
+	free(gl->packdata);
+	gl->spilloff = off;
+	gl->flags |= GRID_LINE_SPILLED;
+}
+
+/* Pack or spill any of a range of lines which are far enough back. */
+static void
+grid_pack_lines(struct grid *gd, u_int py, u_int ny)
+{
+	u_int	pcold = 0, scold = 0, yy;
+
+	if (gd->hcompress != 0 && gd->hsize > gd->hcompress)
+		pcold = gd->hsize - gd->hcompress;
+	if (gd->hspill != 0 && gd->hsize > gd->hspill)
+		scold = gd->hsize - gd->hspill;
+
+	for (yy = py; yy < py + ny; yy++) {
+		if (yy < scold)
+			grid_spill_slot(gd, yy);
+		else if (yy < pcold)
+			grid_pack_slot(gd, yy);
+		else
+			break;
+	}
+}
+
+/*
+ * Pack lines which are far enough back in the history and spill those further
+ * back still. Normally this is just the lines which have most recently gone
+ * past hcompress and hspill, but if a lot of lines have been unpacked to be
+ * read, or if all is set, look at every line.
+ */
+static void
+grid_pack_history(struct grid *gd, int all)
+{
+	u_int	pcold = 0, scold = 0, cold;
+
+	if (gd->hcompress != 0 && gd->hsize > gd->hcompress)
+		pcold = gd->hsize - gd->hcompress;
+	if (gd->hspill != 0 && gd->hsize > gd->hspill)
+		scold = gd->hsize - gd->hspill;
+	cold = (pcold > scold ? pcold : scold);
+	if (cold == 0)
+		return;
+
+	if (all || (gd->hunpacked > GRID_UNPACKED_LINES &&
+	    gd->hunpacked > cold / 8)) {
+		grid_pack_lines(gd, 0, cold);
+		gd->hunpacked = 0;
+		grid_spill_collect(gd);
+		return;
+	}
+	if (pcold != 0)
+		grid_pack_slot(gd, pcold - 1);
+	if (scold != 0)
+		grid_spill_slot(gd, scold - 1);
+}
+
+/* Set how many lines of history are kept unpacked, zero for all of them. */
+void
+grid_compress_history(struct grid *gd, u_int lines)
+{
+	gd->hcompress = lines;
+	grid_pack_history(gd, 1);
+}
+
+/* Set how many lines of history are kept in memory, zero for all of them. */
+void
+grid_spill_history(struct grid *gd, u_int lines)
+{
+	gd->hspill = lines;
+	grid_pack_history(gd, 1);
 }
 
 /*
- * Collect lines from the history if at the limit. Free the top (oldest) 10%
- * and shift up.
+ * Collect lines from the history if at the limit. Free the oldest lines to
+ * leave room for one more; the others stay where they are in the ring.
  */
 void
 grid_collect_history(struct grid *gd)
@@ -377,21 +1421,40 @@ grid_collect_history(struct grid *gd)
 	if (gd->hsize == 0 || gd->hsize < gd->hlimit)
 		return;
 
-	ny = gd->hlimit / 10;
-	if (ny < 1)
-		ny = 1;
+	ny = gd->hsize - gd->hlimit + 1;
 	if (ny > gd->hsize)
 		ny = gd->hsize;
-
-	/*
-	 * Free the lines from 0 to ny then move the remaining lines over
-	 * them.
-	 */
 	grid_trim_history(gd, ny);
+}
 
-	gd->hsize -= ny;
-	if (gd->hscrolled > gd->hsize)
-		gd->hscrolled = gd->hsize;
+/* Bytes of memory used by the lines of a grid, including the whole ring. */
+size_t
+grid_bytes(struct grid *gd)
+{
+	return (gd->bytes + gd->linesize * sizeof *gd->linedata);
+}
+
+/*
+ * Free lines from the top of the history until at least the given number of
+ * bytes has been released, and shrink the ring to the lines left. Returns the
+ * number of bytes actually released.
+ */
+size_t
+grid_release_history(struct grid *gd, size_t target)
+{
+	size_t	released = 0, before = grid_bytes(gd);
+	u_int	ny = 0;
+
+	while (ny < gd->hsize && released < target) {
+		released += grid_line_bytes(grid_slot(gd, ny)) +
+		    sizeof *gd->linedata;
+		ny++;
+	}
+	if (ny != 0) {
+		grid_trim_history(gd, ny);
+		grid_resize_lines(gd, gd->hsize + gd->sy);
+	}
+	return (before - grid_bytes(gd));
 }
 
 /* Remove lines from the bottom of the history. */
@@ -414,17 +1477,22 @@ grid_remove_history(struct grid *gd, u_int ny)
 void
 grid_scroll_history(struct grid *gd, u_int bg)
 {
-	u_int	yy;
+	struct grid_line	*gl;
+	u_int			 yy;
 
 	yy = gd->hsize + gd->sy;
-	gd->linedata = xreallocarray(gd->linedata, yy + 1,
-	    sizeof *gd->linedata);
+	grid_reserve_lines(gd, yy + 1);
 	grid_empty_line(gd, yy, bg);
 
 	gd->hscrolled++;
-	grid_compact_line(&gd->linedata[gd->hsize]);
-	gd->linedata[gd->hsize].time = current_time;
+	gl = grid_slot(gd, gd->hsize);
+	gd->bytes -= grid_line_bytes(gl);
+	grid_compact_line(gl);
+	gd->bytes += grid_line_bytes(gl);
+	gl->time = current_time;
 	gd->hsize++;
+
+	grid_pack_history(gd, 0);
 }
 
 /* Clear the history. */
@@ -432,46 +1500,80 @@ void
 grid_clear_history(struct grid *gd)
 {
 	grid_trim_history(gd, gd->hsize);
+	grid_resize_lines(gd, gd->sy);
+}
 
-	gd->hscrolled = 0;
-	gd->hsize = 0;
+/*
+ * Move the first ny lines of another grid to the top of the history. If the
+ * history would go over the limit, the oldest of them are dropped instead.
+ */
+void
+grid_prepend_history(struct grid *gd, struct grid *src, u_int ny)
+{
+	struct grid_line	*gl;
+	u_int			 yy, skip = 0;
+
+	if (ny > src->hsize + src->sy)
+		ny = src->hsize + src->sy;
+	if (gd->hsize >= gd->hlimit)
+		return;
+	if (gd->hsize + ny > gd->hlimit) {
+		skip = gd->hsize + ny - gd->hlimit;
+		ny -= skip;
+	}
+	if (ny == 0)
+		return;
+
+	/* Step the start of the ring back over the new lines. */
+	grid_reserve_lines(gd, gd->hsize + gd->sy + ny);
+	gd->linestart += gd->linesize - ny;
+	if (gd->linestart >= gd->linesize)
+		gd->linestart -= gd->linesize;
+	for (yy = 0; yy < ny; yy++) {
+		gl = grid_slot(src, skip + yy);
+		if (gl->flags & GRID_LINE_SPILLED)
+			grid_unspill_line(src, gl);
+		src->bytes -= grid_line_bytes(gl);
+		gd->bytes += grid_line_bytes(gl);
+		memcpy(grid_slot(gd, yy), gl, sizeof *gd->linedata);
+		memset(grid_slot(src, skip + yy), 0, sizeof *src->linedata);
+	}
 
-	gd->linedata = xreallocarray(gd->linedata, gd->sy,
-	    sizeof *gd->linedata);
+	gd->hsize += ny;
+	if (gd->hreflow != 0)
+		gd->hreflow += ny;
+	grid_pack_history(gd, 1);
 }
 
 /* Scroll a region up, moving the top line into the history. */
 void
 grid_scroll_history_region(struct grid *gd, u_int upper, u_int lower, u_int bg)
 {
-	struct grid_line	*gl_history, *gl_upper;
+	struct grid_line	 gl;
 	u_int			 yy;
 
 	/* Create a space for a new line. */
 	yy = gd->hsize + gd->sy;
-	gd->linedata = xreallocarray(gd->linedata, yy + 1,
-	    sizeof *gd->linedata);
-
-	/* Move the entire screen down to free a space for this line. */
-	gl_history = &gd->linedata[gd->hsize];
-	memmove(gl_history + 1, gl_history, gd->sy * sizeof *gl_history);
-
-	/* Adjust the region and find its start and end. */
-	upper++;
-	gl_upper = &gd->linedata[upper];
-	lower++;
+	grid_reserve_lines(gd, yy + 1);
 
-	/* Move the line into the history. */
-	memcpy(gl_history, gl_upper, sizeof *gl_history);
-	gl_history->time = current_time;
-
-	/* Then move the region up and clear the bottom line. */
-	memmove(gl_upper, gl_upper + 1, (lower - upper) * sizeof *gl_upper);
-	grid_empty_line(gd, lower, bg);
+	/*
+	 * The top line of the region goes into the history. Move the lines
+	 * above the region down over it and those below down by one to make
+	 * space for an empty line. The region itself stays where it is, which
+	 * is now one line further up the screen.
+	 */
+	memcpy(&gl, grid_slot(gd, upper), sizeof gl);
+	grid_move_line_data(gd, gd->hsize + 1, gd->hsize, upper - gd->hsize);
+	grid_move_line_data(gd, lower + 2, lower + 1, yy - lower - 1);
+	memcpy(grid_slot(gd, gd->hsize), &gl, sizeof gl);
+	grid_slot(gd, gd->hsize)->time = current_time;
+	grid_empty_line(gd, lower + 1, bg);
 
 	/* Move the history offset down over the line. */
 	gd->hscrolled++;
 	gd->hsize++;
+
+	grid_pack_history(gd, 0);
 }
 
 /* Expand line to fit to cell. */
@@ -481,7 +1583,7 @@ grid_expand_line(struct grid *gd, u_int py, u_int sx, u_int bg)
 	struct grid_line	*gl;
 	u_int			 xx;
 
-	gl = &gd->linedata[py];
+	gl = grid_line(gd, py);
 	if (sx <= gl->cellsize)
 		return;
 
@@ -493,6 +1595,7 @@ grid_expand_line(struct grid *gd, u_int py, u_int sx, u_int bg)
 		sx = gd->sx;
 
 	gl->celldata = xreallocarray(gl->celldata, sx, sizeof *gl->celldata);
+	gd->bytes += (sx - gl->cellsize) * sizeof *gl->celldata;
 	for (xx = gl->cellsize; xx < sx; xx++)
 		grid_clear_cell(gd, xx, py, bg);
 	gl->cellsize = sx;
@@ -502,7 +1605,7 @@ grid_expand_line(struct grid *gd, u_int py, u_int sx, u_int bg)
 void
 grid_empty_line(struct grid *gd, u_int py, u_int bg)
 {
-	memset(&gd->linedata[py], 0, sizeof gd->linedata[py]);
+	memset(grid_slot(gd, py), 0, sizeof *gd->linedata);
 	if (!COLOUR_DEFAULT(bg))
 		grid_expand_line(gd, py, gd->sx, bg);
 }
@@ -513,7 +1616,20 @@ grid_peek_line(struct grid *gd, u_int py)
 {
 	if (grid_check_y(gd, __func__, py) != 0)
 		return (NULL);
-	return (&gd->linedata[py]);
+	return (grid_read_line(gd, py));
+}
+
+/*
+ * Peek at grid line without unpacking it. If the line is packed, only the
+ * flags, cellused and packed data are valid, and if it is also spilled the
+ * packed data is in the spill file.
+ */
+const struct grid_line *
+grid_peek_packed_line(struct grid *gd, u_int py)
+{
+	if (grid_check_y(gd, __func__, py) != 0)
+		return (NULL);
+	return (grid_slot(gd, py));
 }
 
 /* Get cell from line. */
@@ -522,18 +1638,20 @@ grid_get_cell1(struct grid_line *gl, u_int px, struct grid_cell *gc)
 {
 	struct grid_cell_entry	*gce = &gl->celldata[px];
 	struct grid_extd_entry	*gee;
+	struct grid_style	*gs;
 
 	if (gce->flags & GRID_FLAG_EXTENDED) {
 		if (gce->offset >= gl->extdsize)
 			memcpy(gc, &grid_default_cell, sizeof *gc);
 		else {
 			gee = &gl->extddata[gce->offset];
+			gs = grid_style_list[gee->style];
 			gc->flags = gee->flags;
-			gc->attr = gee->attr;
-			gc->fg = gee->fg;
-			gc->bg = gee->bg;
-			gc->us = gee->us;
-			gc->link = gee->link;
+			gc->attr = gs->attr;
+			gc->fg = gs->fg;
+			gc->bg = gs->bg;
+			gc->us = gs->us;
+			gc->link = gs->link;
 
 			if (gc->flags & GRID_FLAG_TAB)
 				grid_set_tab(gc, gee->data);
@@ -560,11 +1678,17 @@ grid_get_cell1(struct grid_line *gl, u_int px, struct grid_cell *gc)
 void
 grid_get_cell(struct grid *gd, u_int px, u_int py, struct grid_cell *gc)
 {
-	if (grid_check_y(gd, __func__, py) != 0 ||
-	    px >= gd->linedata[py].cellsize)
+	struct grid_line	*gl;
+
+	if (grid_check_y(gd, __func__, py) != 0) {
+		memcpy(gc, &grid_default_cell, sizeof *gc);
+		return;
+	}
+	gl = grid_read_line(gd, py);
+	if (px >= gl->cellsize)
 		memcpy(gc, &grid_default_cell, sizeof *gc);
 	else
-		grid_get_cell1(&gd->linedata[py], px, gc);
+		grid_get_cell1(gl, px, gc);
 }
 
 /* Set cell at position. */
@@ -579,13 +1703,13 @@ grid_set_cell(struct grid *gd, u_int px, u_int py, const struct grid_cell *gc)
 
 	grid_expand_line(gd, py, px + 1, 8);
 
-	gl = &gd->linedata[py];
+	gl = grid_line(gd, py);
 	if (px + 1 > gl->cellused)
 		gl->cellused = px + 1;
 
 	gce = &gl->celldata[px];
 	if (grid_need_extended_cell(gce, gc))
-		grid_extended_cell(gl, gce, gc);
+		grid_extended_cell(gd, gl, gce, gc);
 	else
 		grid_store_cell(gce, gc, gc->data.data[0]);
 }
@@ -612,20 +1736,64 @@ grid_set_cells(struct grid *gd, u_int px, u_int py, const struct grid_cell *gc,
 
 	grid_expand_line(gd, py, px + slen, 8);
 
-	gl = &gd->linedata[py];
+	gl = grid_line(gd, py);
 	if (px + slen > gl->cellused)
 		gl->cellused = px + slen;
 
 	for (i = 0; i < slen; i++) {
 		gce = &gl->celldata[px + i];
 		if (grid_need_extended_cell(gce, gc)) {
-			gee = grid_extended_cell(gl, gce, gc);
+			gee = grid_extended_cell(gd, gl, gce, gc);
 			gee->data = utf8_build_one(s[i]);
 		} else
 			grid_store_cell(gce, gc, s[i]);
 	}
 }
 
+/* Set cells of UTF-8 characters at position, zero is padding. */
+void
+grid_set_utf8_cells(struct grid *gd, u_int px, u_int py,
+    const struct grid_cell *gc, const utf8_char *uc, size_t n)
+{
+	struct grid_line	*gl;
+	struct grid_cell_entry	*gce;
+	struct grid_extd_entry	*gee;
+	struct grid_cell	 one;
+	const struct grid_cell	*pc = &grid_padding_cell;
+	u_int			 i;
+	u_char			 c;
+
+	if (grid_check_y(gd, __func__, py) != 0)
+		return;
+
+	grid_expand_line(gd, py, px + n, 8);
+
+	gl = grid_line(gd, py);
+	if (px + n > gl->cellused)
+		gl->cellused = px + n;
+
+	memcpy(&one, gc, sizeof one);
+	utf8_set(&one.data, ' ');
+	for (i = 0; i < n; i++) {
+		gce = &gl->celldata[px + i];
+		if (uc[i] == 0) {
+			if (grid_need_extended_cell(gce, pc))
+				grid_extended_cell(gd, gl, gce, pc);
+			else
+				grid_store_cell(gce, pc, pc->data.data[0]);
+			continue;
+		}
+		c = uc[i] & 0xff;
+		if (uc[i] == utf8_build_one(c) &&
+		    !grid_need_extended_cell(gce, &one))
+			grid_store_cell(gce, &one, c);
+		else {
+			gee = grid_extended_cell(gd, gl, gce, &one);
+			gee->data = uc[i];
+		}
+	}
+}
+
 /* Clear area. */
 void
 grid_clear(struct grid *gd, u_int px, u_int py, u_int nx, u_int ny, u_int bg)
@@ -647,7 +1815,7 @@ grid_clear(struct grid *gd, u_int px, u_int py, u_int nx, u_int ny, u_int bg)
 		return;
 
 	for (yy = py; yy < py + ny; yy++) {
-		gl = &gd->linedata[yy];
+		gl = grid_line(gd, yy);
 
 		sx = gd->sx;
 		if (sx > gl->cellsize)
@@ -685,7 +1853,7 @@ grid_clear_lines(struct grid *gd, u_int py, u_int ny, u_int bg)
 		grid_empty_line(gd, yy, bg);
 	}
 	if (py != 0)
-		gd->linedata[py - 1].flags &= ~GRID_LINE_WRAPPED;
+		grid_slot(gd, py - 1)->flags &= ~GRID_LINE_WRAPPED;
 }
 
 /* Move a group of lines. */
@@ -713,10 +1881,9 @@ grid_move_lines(struct grid *gd, u_int dy, u_int py, u_int ny, u_int bg)
 		grid_free_line(gd, yy);
 	}
 	if (dy != 0)
-		gd->linedata[dy - 1].flags &= ~GRID_LINE_WRAPPED;
+		grid_slot(gd, dy - 1)->flags &= ~GRID_LINE_WRAPPED;
 
-	memmove(&gd->linedata[dy], &gd->linedata[py],
-	    ny * (sizeof *gd->linedata));
+	grid_move_line_data(gd, dy, py, ny);
 
 	/*
 	 * Wipe any lines that have been moved (without freeing them - they are
@@ -727,7 +1894,7 @@ grid_move_lines(struct grid *gd, u_int dy, u_int py, u_int ny, u_int bg)
 			grid_empty_line(gd, yy, bg);
 	}
 	if (py != 0 && (py < dy || py >= dy + ny))
-		gd->linedata[py - 1].flags &= ~GRID_LINE_WRAPPED;
+		grid_slot(gd, py - 1)->flags &= ~GRID_LINE_WRAPPED;
 }
 
 /* Move a group of cells. */
@@ -743,7 +1910,7 @@ grid_move_cells(struct grid *gd, u_int dx, u_int px, u_int py, u_int nx,
 
 	if (grid_check_y(gd, __func__, py) != 0)
 		return;
-	gl = &gd->linedata[py];
+	gl = grid_line(gd, py);
 
 	grid_expand_line(gd, py, px + nx, 8);
 	grid_expand_line(gd, py, dx + nx, 8);
@@ -1157,7 +2324,8 @@ grid_duplicate_lines(struct grid *dst, u_int dy, struct grid *src, u_int sy,
     u_int ny)
 {
 	struct grid_line	*dstl, *srcl;
-	u_int			 yy;
+	u_char			*data;
+	u_int			 yy, i;
 
 	if (dy + ny > dst->hsize + dst->sy)
 		ny = dst->hsize + dst->sy - dy;
@@ -1166,11 +2334,41 @@ grid_duplicate_lines(struct grid *dst, u_int dy, struct grid *src, u_int sy,
 	grid_free_lines(dst, dy, ny);
 
 	for (yy = 0; yy < ny; yy++) {
-		srcl = &src->linedata[sy];
-		dstl = &dst->linedata[dy];
+		srcl = grid_slot(src, sy);
+		dstl = grid_slot(dst, dy);
 
 		memcpy(dstl, srcl, sizeof *dstl);
-		if (srcl->cellsize != 0) {
+		if (srcl->flags & GRID_LINE_SPILLED) {
+			/*
+			 * Share the spill file if possible, otherwise read the
+			 * line back in. Either way any styles need another
+			 * reference.
+			 */
+			if (dst->spill == NULL) {
+				dst->spill = src->spill;
+				dst->spill->references++;
+			}
+			if (dst->spill != src->spill ||
+			    (srcl->flags & GRID_LINE_EXTENDED)) {
+				data = xmalloc(srcl->packsize);
+				grid_spill_read(src->spill, srcl->spilloff,
+				    data, srcl->packsize);
+				if (srcl->flags & GRID_LINE_EXTENDED)
+					grid_pack_styles(data, 1);
+			} else
+				data = NULL;
+			if (dst->spill == src->spill) {
+				src->spill->live += srcl->packsize;
+				free(data);
+			} else {
+				dstl->flags &= ~GRID_LINE_SPILLED;
+				dstl->packdata = data;
+			}
+		} else if (srcl->flags & GRID_LINE_PACKED) {
+			dstl->packdata = xmalloc(srcl->packsize);
+			memcpy(dstl->packdata, srcl->packdata, srcl->packsize);
+			grid_pack_styles(dstl->packdata, 1);
+		} else if (srcl->cellsize != 0) {
 			dstl->celldata = xreallocarray(NULL,
 			    srcl->cellsize, sizeof *dstl->celldata);
 			memcpy(dstl->celldata, srcl->celldata,
@@ -1183,8 +2381,11 @@ grid_duplicate_lines(struct grid *dst, u_int dy, struct grid *src, u_int sy,
 			    sizeof *dstl->extddata);
 			memcpy(dstl->extddata, srcl->extddata, dstl->extdsize *
 			    sizeof *dstl->extddata);
+			for (i = 0; i < dstl->extdsize; i++)
+				grid_style_reference(dstl->extddata[i].style);
 		} else
 			dstl->extddata = NULL;
+		dst->bytes += grid_line_bytes(dstl);
 
 		sy++;
 		dy++;
@@ -1206,8 +2407,8 @@ grid_reflow_add(struct grid *gd, u_int n)
 	struct grid_line	*gl;
 	u_int			 sy = gd->sy + n;
 
-	gd->linedata = xreallocarray(gd->linedata, sy, sizeof *gd->linedata);
-	gl = &gd->linedata[gd->sy];
+	grid_reserve_lines(gd, sy);
+	gl = grid_slot(gd, gd->sy);
 	memset(gl, 0, n * (sizeof *gl));
 	gd->sy = sy;
 	return (gl);
@@ -1225,10 +2426,13 @@ grid_reflow_move(struct grid *gd, struct grid_line *from)
 	return (to);
 }
 
-/* Join line below onto this one. */
+/*
+ * Join line below onto this one. The target holds the reflowed lines starting
+ * from line offset of the grid.
+ */
 static void
-grid_reflow_join(struct grid *target, struct grid *gd, u_int sx, u_int yy,
-    u_int width, int already)
+grid_reflow_join(struct grid *target, struct grid *gd, u_int offset, u_int sx,
+    u_int yy, u_int width, int already)
 {
 	struct grid_line	*gl, *from = NULL;
 	struct grid_cell	 gc;
@@ -1241,10 +2445,10 @@ grid_reflow_join(struct grid *target, struct grid *gd, u_int sx, u_int yy,
 	 */
 	if (!already) {
 		to = target->sy;
-		gl = grid_reflow_move(target, &gd->linedata[yy]);
+		gl = grid_reflow_move(target, grid_line(gd, yy));
 	} else {
 		to = target->sy - 1;
-		gl = &target->linedata[to];
+		gl = grid_line(target, to);
 	}
 	at = gl->cellused;
 
@@ -1262,9 +2466,9 @@ grid_reflow_join(struct grid *target, struct grid *gd, u_int sx, u_int yy,
 		line = yy + 1 + lines;
 
 		/* If the next line is empty, skip it. */
-		if (~gd->linedata[line].flags & GRID_LINE_WRAPPED)
+		if (~grid_slot(gd, line)->flags & GRID_LINE_WRAPPED)
 			wrapped = 0;
-		if (gd->linedata[line].cellused == 0) {
+		if (grid_slot(gd, line)->cellused == 0) {
 			if (!wrapped)
 				break;
 			lines++;
@@ -1276,7 +2480,7 @@ grid_reflow_join(struct grid *target, struct grid *gd, u_int sx, u_int yy,
 		 * separately because we need to leave "from" set to the last
 		 * line if this line is full.
 		 */
-		grid_get_cell1(&gd->linedata[line], 0, &gc);
+		grid_get_cell1(grid_line(gd, line), 0, &gc);
 		if (width + gc.data.width > sx)
 			break;
 		width += gc.data.width;
@@ -1284,7 +2488,7 @@ grid_reflow_join(struct grid *target, struct grid *gd, u_int sx, u_int yy,
 		at++;
 
 		/* Join as much more as possible onto the current line. */
-		from = &gd->linedata[line];
+		from = grid_line(gd, line);
 		for (want = 1; want < from->cellused; want++) {
 			grid_get_cell1(from, want, &gc);
 			if (width + gc.data.width > sx)
@@ -1321,24 +2525,23 @@ grid_reflow_join(struct grid *target, struct grid *gd, u_int sx, u_int yy,
 
 	/* Remove the lines that were completely consumed. */
 	for (i = yy + 1; i < yy + 1 + lines; i++) {
-		free(gd->linedata[i].celldata);
-		free(gd->linedata[i].extddata);
-		grid_reflow_dead(&gd->linedata[i]);
+		grid_free_line(gd, i);
+		grid_reflow_dead(grid_slot(gd, i));
 	}
 
 	/* Adjust scroll position. */
-	if (gd->hscrolled > to + lines)
+	if (gd->hscrolled > offset + to + lines)
 		gd->hscrolled -= lines;
-	else if (gd->hscrolled > to)
-		gd->hscrolled = to;
+	else if (gd->hscrolled > offset + to)
+		gd->hscrolled = offset + to;
 }
 
 /* Split this line into several new ones */
 static void
-grid_reflow_split(struct grid *target, struct grid *gd, u_int sx, u_int yy,
-    u_int at)
+grid_reflow_split(struct grid *target, struct grid *gd, u_int offset,
+    u_int sx, u_int yy, u_int at)
 {
-	struct grid_line	*gl = &gd->linedata[yy], *first;
+	struct grid_line	*gl = grid_line(gd, yy), *first;
 	struct grid_cell	 gc;
 	u_int			 line, lines, width, i, xx;
 	u_int			 used = gl->cellused;
@@ -1370,7 +2573,7 @@ grid_reflow_split(struct grid *target, struct grid *gd, u_int sx, u_int yy,
 	for (i = at; i < used; i++) {
 		grid_get_cell1(gl, i, &gc);
 		if (width + gc.data.width > sx) {
-			target->linedata[line].flags |= GRID_LINE_WRAPPED;
+			grid_slot(target, line)->flags |= GRID_LINE_WRAPPED;
 
 			line++;
 			width = 0;
@@ -1381,7 +2584,7 @@ grid_reflow_split(struct grid *target, struct grid *gd, u_int sx, u_int yy,
 		xx++;
 	}
 	if (flags & GRID_LINE_WRAPPED)
-		target->linedata[line].flags |= GRID_LINE_WRAPPED;
+		grid_slot(target, line)->flags |= GRID_LINE_WRAPPED;
 
 	/* Move the remainder of the original line. */
 	gl->cellsize = gl->cellused = at;
@@ -1398,32 +2601,59 @@ grid_reflow_split(struct grid *target, struct grid *gd, u_int sx, u_int yy,
 	 * in the last new line, try to join with the next lines.
 	 */
 	if (width < sx && (flags & GRID_LINE_WRAPPED))
-		grid_reflow_join(target, gd, sx, yy, width, 1);
+		grid_reflow_join(target, gd, offset, sx, yy, width, 1);
 }
 
-/* Reflow lines on grid to new width. */
-void
-grid_reflow(struct grid *gd, u_int sx)
+/* Find the first line of the unwrapped line containing a line. */
+static u_int
+grid_reflow_start(struct grid *gd, u_int py)
+{
+	while (py > 0 && (grid_slot(gd, py - 1)->flags & GRID_LINE_WRAPPED))
+		py--;
+	return (py);
+}
+
+/*
+ * Reflow lines from first to last to a new width. The first line must start
+ * an unwrapped line and the last must either end one or be the end of the
+ * grid. The new lines take the place of the old, moving whichever of the lines
+ * before or after is fewer.
+ */
+static void
+grid_reflow_lines(struct grid *gd, u_int sx, u_int first, u_int last)
 {
 	struct grid		*target;
 	struct grid_line	*gl;
 	struct grid_cell	 gc;
-	u_int			 yy, width, i, at;
+	u_int			 yy, width, i, at, end, old, new, n;
+	size_t			 bytes = gd->bytes;
+
+	end = gd->hsize + gd->sy;
+	for (yy = first; yy < last; yy++)
+		bytes -= grid_line_bytes(grid_slot(gd, yy));
 
 	/*
 	 * Create a destination grid. This is just used as a container for the
 	 * line data and may not be fully valid.
 	 */
 	target = grid_create(gd->sx, 0, 0);
+	target->spill = gd->spill;
 
 	/*
 	 * Loop over each source line.
 	 */
-	for (yy = 0; yy < gd->hsize + gd->sy; yy++) {
-		gl = &gd->linedata[yy];
+	for (yy = first; yy < last; yy++) {
+		gl = grid_slot(gd, yy);
 		if (gl->flags & GRID_LINE_DEAD)
 			continue;
 
+		/*
+		 * A packed line can be moved across without unpacking unless
+		 * the cell widths are needed.
+		 */
+		if (gl->flags & GRID_LINE_EXTENDED)
+			gl = grid_line(gd, yy);
+
 		/*
 		 * Work out the width of this line. at is the point at which
 		 * the available width is hit, and width is the full line
@@ -1459,7 +2689,7 @@ grid_reflow(struct grid *gd, u_int sx)
 		 * it was previously wrapped.
 		 */
 		if (width > sx) {
-			grid_reflow_split(target, gd, sx, yy, at);
+			grid_reflow_split(target, gd, first, sx, yy, at);
 			continue;
 		}
 
@@ -1468,22 +2698,88 @@ grid_reflow(struct grid *gd, u_int sx)
 		 * of the next line.
 		 */
 		if (gl->flags & GRID_LINE_WRAPPED)
-			grid_reflow_join(target, gd, sx, yy, width, 0);
+			grid_reflow_join(target, gd, first, sx, yy, width, 0);
 		else
 			grid_reflow_move(target, gl);
 	}
 
 	/*
-	 * Replace the old grid with the new.
+	 * Put the new lines in place of the old, making sure there are still
+	 * enough for the screen.
 	 */
-	if (target->sy < gd->sy)
-		grid_reflow_add(target, gd->sy - target->sy);
-	gd->hsize = target->sy - gd->sy;
+	if (last == end && first + target->sy < gd->sy)
+		grid_reflow_add(target, gd->sy - first - target->sy);
+	old = last - first;
+	new = target->sy;
+	grid_reserve_lines(gd, end - old + new);
+	if (new != old && first < end - last) {
+		if (new > old) {
+			n = new - old;
+			gd->linestart += gd->linesize - n;
+			if (gd->linestart >= gd->linesize)
+				gd->linestart -= gd->linesize;
+			grid_move_line_data(gd, 0, n, first);
+		} else {
+			n = old - new;
+			grid_move_line_data(gd, n, 0, first);
+			gd->linestart += n;
+			if (gd->linestart >= gd->linesize)
+				gd->linestart -= gd->linesize;
+		}
+	} else if (new != old)
+		grid_move_line_data(gd, first + new, last, end - last);
+	for (yy = 0; yy < new; yy++) {
+		gl = grid_slot(gd, first + yy);
+		memcpy(gl, grid_slot(target, yy), sizeof *gl);
+		bytes += grid_line_bytes(gl);
+	}
+	free(target->linedata);
+	free(target);
+
+	gd->hsize = end - old + new - gd->sy;
 	if (gd->hscrolled > gd->hsize)
 		gd->hscrolled = gd->hsize;
-	free(gd->linedata);
-	gd->linedata = target->linedata;
-	free(target);
+	gd->bytes = bytes;
+	grid_pack_lines(gd, first, new);
+}
+
+/*
+ * Reflow grid to new width. If the grid allows it, only the screen and the
+ * most recent history are done now and older history is left for
+ * grid_reflow_history.
+ */
+void
+grid_reflow(struct grid *gd, u_int sx)
+{
+	u_int	first = 0;
+
+	if ((gd->flags & GRID_REFLOW_LATER) && gd->hsize > GRID_REFLOW_LINES)
+		first = grid_reflow_start(gd, gd->hsize - GRID_REFLOW_LINES);
+	gd->hreflow = first;
+	grid_reflow_lines(gd, sx, first, gd->hsize + gd->sy);
+}
+
+/*
+ * Reflow history left by grid_reflow, either all of it or the most recent
+ * part. Returns 1 if there is still more to do.
+ */
+int
+grid_reflow_history(struct grid *gd, int all)
+{
+	u_int	first = 0, last;
+
+	if (gd->hreflow > gd->hsize)
+		gd->hreflow = gd->hsize;
+	if (gd->hreflow == 0)
+		return (0);
+	last = gd->hreflow;
+
+	if (!all && last > GRID_REFLOW_LINES)
+		first = grid_reflow_start(gd, last - GRID_REFLOW_LINES);
+	log_debug("%s: lines %u-%u of %u", __func__, first, last, gd->hsize);
+	grid_reflow_lines(gd, gd->sx, first, last);
+	gd->hreflow = first;
+	return (first != 0);
 }
 
 /* Convert to position based on wrapped lines. */
@@ -1493,14 +2789,14 @@ grid_wrap_position(struct grid *gd, u_int px, u_int py, u_int *wx, u_int *wy)
 	u_int	ax = 0, ay = 0, yy;
 
 	for (yy = 0; yy < py; yy++) {
-		if (gd->linedata[yy].flags & GRID_LINE_WRAPPED)
-			ax += gd->linedata[yy].cellused;
+		if (grid_slot(gd, yy)->flags & GRID_LINE_WRAPPED)
+			ax += grid_slot(gd, yy)->cellused;
 		else {
 			ax = 0;
 			ay++;
 		}
 	}
-	if (px >= gd->linedata[yy].cellused)
+	if (px >= grid_slot(gd, yy)->cellused)
 		ax = UINT_MAX;
 	else
 		ax += px;
@@ -1517,7 +2813,7 @@ grid_unwrap_position(struct grid *gd, u_int *px, u_int *py, u_int wx, u_int wy)
 	for (yy = 0; yy < gd->hsize + gd->sy - 1; yy++) {
 		if (ay == wy)
 			break;
-		if (~gd->linedata[yy].flags & GRID_LINE_WRAPPED)
+		if (~grid_slot(gd, yy)->flags & GRID_LINE_WRAPPED)
 			ay++;
 	}
 
@@ -1526,14 +2822,14 @@ grid_unwrap_position(struct grid *gd, u_int *px, u_int *py, u_int wx, u_int wy)
 	 * until we find the end or the line now containing wx.
 	 */
 	if (wx == UINT_MAX) {
-		while (gd->linedata[yy].flags & GRID_LINE_WRAPPED)
+		while (grid_slot(gd, yy)->flags & GRID_LINE_WRAPPED)
 			yy++;
-		wx = gd->linedata[yy].cellused;
+		wx = grid_slot(gd, yy)->cellused;
 	} else {
-		while (gd->linedata[yy].flags & GRID_LINE_WRAPPED) {
-			if (wx < gd->linedata[yy].cellused)
+		while (grid_slot(gd, yy)->flags & GRID_LINE_WRAPPED) {
+			if (wx < grid_slot(gd, yy)->cellused)
 				break;
-			wx -= gd->linedata[yy].cellused;
+			wx -= grid_slot(gd, yy)->cellused;
 			yy++;
 		}
 	}
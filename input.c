@@ -26,6 +26,12 @@
 #include <string.h>
 #include <time.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "tmux.h"
 
 /*
@@ -124,9 +130,12 @@ struct input_ctx {
 
 	/*
 	 * All input received since we were last in the ground state. Sent to
-	 * control clients on connection.
+	 * control clients on connection. Input from the buffer being parsed
+	 * is only added when the parse finishes, since_ground_start is where
+	 * it begins or NULL.
 	 */
 	struct evbuffer		*since_ground;
+	const u_char		*since_ground_start;
 };
 
 /* Helper functions. */
@@ -166,9 +175,13 @@ static void 	input_exit_remote(struct input_ctx *);
 
 /* Input state handlers. */
 static int	input_print(struct input_ctx *);
+static size_t	input_print_run(const u_char *, size_t);
+static void	input_print_span(struct input_ctx *, const u_char *, size_t);
 static int	input_intermediate(struct input_ctx *);
 static int	input_parameter(struct input_ctx *);
 static int	input_input(struct input_ctx *);
+static size_t	input_input_run(struct input_ctx *, const u_char *, size_t);
+static void	input_input_span(struct input_ctx *, const u_char *, size_t);
 static int	input_c0_dispatch(struct input_ctx *);
 static int	input_esc_dispatch(struct input_ctx *);
 static int	input_csi_dispatch(struct input_ctx *);
@@ -338,6 +351,7 @@ struct input_state {
 	void				(*enter)(struct input_ctx *);
 	void				(*exit)(struct input_ctx *);
 	const struct input_transition	*transitions;
+	u_int				 index;	/* into input_lookup */
 };
 
 /* State transitions available from all states. */
@@ -365,123 +379,169 @@ static const struct input_transition input_state_apc_string_table[];
 static const struct input_transition input_state_rename_string_table[];
 static const struct input_transition input_state_consume_st_table[];
 
+/*
+ * Transition for every byte in every state, built from the state tables on
+ * first use so finding a transition is a single lookup.
+ */
+#define INPUT_STATES 17
+static const struct input_transition *input_lookup[INPUT_STATES][256];
+static int input_lookup_built;
+
 /* ground state definition. */
 static const struct input_state input_state_ground = {
 	"ground",
 	input_ground, NULL,
-	input_state_ground_table
+	input_state_ground_table,
+	0
 };
 
 /* esc_enter state definition. */
 static const struct input_state input_state_esc_enter = {
 	"esc_enter",
 	input_clear, NULL,
-	input_state_esc_enter_table
+	input_state_esc_enter_table,
+	1
 };
 
 /* esc_intermediate state definition. */
 static const struct input_state input_state_esc_intermediate = {
 	"esc_intermediate",
 	NULL, NULL,
-	input_state_esc_intermediate_table
+	input_state_esc_intermediate_table,
+	2
 };
 
 /* csi_enter state definition. */
 static const struct input_state input_state_csi_enter = {
 	"csi_enter",
 	input_clear, NULL,
-	input_state_csi_enter_table
+	input_state_csi_enter_table,
+	3
 };
 
 /* csi_parameter state definition. */
 static const struct input_state input_state_csi_parameter = {
 	"csi_parameter",
 	NULL, NULL,
-	input_state_csi_parameter_table
+	input_state_csi_parameter_table,
+	4
 };
 
 /* csi_intermediate state definition. */
 static const struct input_state input_state_csi_intermediate = {
 	"csi_intermediate",
 	NULL, NULL,
-	input_state_csi_intermediate_table
+	input_state_csi_intermediate_table,
+	5
 };
 
 /* csi_ignore state definition. */
 static const struct input_state input_state_csi_ignore = {
 	"csi_ignore",
 	NULL, NULL,
-	input_state_csi_ignore_table
+	input_state_csi_ignore_table,
+	6
 };
 
 /* dcs_enter state definition. */
 static const struct input_state input_state_dcs_enter = {
 	"dcs_enter",
 	input_enter_dcs, NULL,
-	input_state_dcs_enter_table
+	input_state_dcs_enter_table,
+	7
 };
 
 /* dcs_parameter state definition. */
 static const struct input_state input_state_dcs_parameter = {
 	"dcs_parameter",
 	NULL, NULL,
-	input_state_dcs_parameter_table
+	input_state_dcs_parameter_table,
+	8
 };
 
 /* dcs_intermediate state definition. */
 static const struct input_state input_state_dcs_intermediate = {
 	"dcs_intermediate",
 	NULL, NULL,
-	input_state_dcs_intermediate_table
+	input_state_dcs_intermediate_table,
+	9
 };
 
 /* dcs_handler state definition. */
 static const struct input_state input_state_dcs_handler = {
 	"dcs_handler",
 	input_enter_dcs_handler, NULL,
-	input_state_dcs_handler_table
+	input_state_dcs_handler_table,
+	10
 };
 
 /* dcs_escape state definition. */
 static const struct input_state input_state_dcs_escape = {
 	"dcs_escape",
 	NULL, NULL,
-	input_state_dcs_escape_table
+	input_state_dcs_escape_table,
+	11
 };
 
 /* dcs_ignore state definition. */
 static const struct input_state input_state_dcs_ignore = {
 	"dcs_ignore",
 	NULL, NULL,
-	input_state_dcs_ignore_table
+	input_state_dcs_ignore_table,
+	12
 };
 
 /* osc_string state definition. */
 static const struct input_state input_state_osc_string = {
 	"osc_string",
 	input_enter_osc, input_exit_osc,
-	input_state_osc_string_table
+	input_state_osc_string_table,
+	13
 };
 
 /* apc_string state definition. */
 static const struct input_state input_state_apc_string = {
 	"apc_string",
 	input_enter_apc, input_exit_apc,
-	input_state_apc_string_table
+	input_state_apc_string_table,
+	14
 };
 
 /* rename_string state definition. */
 static const struct input_state input_state_rename_string = {
 	"rename_string",
 	input_enter_rename, input_exit_rename,
-	input_state_rename_string_table
+	input_state_rename_string_table,
+	15
 };
 
 /* consume_st state definition. */
 static const struct input_state input_state_consume_st = {
 	"consume_st",
 	input_enter_rename, NULL, /* rename also waits for ST */
-	input_state_consume_st_table
+	input_state_consume_st_table,
+	16
+};
+
+/* All states, in index order. */
+static const struct input_state *input_states[INPUT_STATES] = {
+	&input_state_ground,
+	&input_state_esc_enter,
+	&input_state_esc_intermediate,
+	&input_state_csi_enter,
+	&input_state_csi_parameter,
+	&input_state_csi_intermediate,
+	&input_state_csi_ignore,
+	&input_state_dcs_enter,
+	&input_state_dcs_parameter,
+	&input_state_dcs_intermediate,
+	&input_state_dcs_handler,
+	&input_state_dcs_escape,
+	&input_state_dcs_ignore,
+	&input_state_osc_string,
+	&input_state_apc_string,
+	&input_state_rename_string,
+	&input_state_consume_st
 };
 
 /* ground state table. */
@@ -817,6 +877,34 @@ input_restore_state(struct input_ctx *ictx)
 	screen_write_cursormove(sctx, ictx->old_cx, ictx->old_cy, 0);
 }
 
+/* Fill in the lookup tables from the state tables. */
+static void
+input_build_lookup(void)
+{
+	const struct input_state	*state;
+	const struct input_transition	*itr;
+	u_int				 i;
+	int				 ch;
+
+	for (i = 0; i < INPUT_STATES; i++) {
+		state = input_states[i];
+		if (state->index != i)
+			fatalx("state %s has index %u", state->name, state->index);
+		for (ch = 0; ch < 256; ch++) {
+			itr = state->transitions;
+			while (itr->first != -1 && itr->last != -1) {
+				if (ch >= itr->first && ch <= itr->last)
+					break;
+				itr++;
+			}
+			if (itr->first == -1 || itr->last == -1)
+				fatalx("no transition from state %s", state->name);
+			input_lookup[i][ch] = itr;
+		}
+	}
+	input_lookup_built = 1;
+}
+
 /* Initialise input parser. */
 struct input_ctx *
 input_init(struct window_pane *wp, struct bufferevent *bev,
@@ -824,6 +912,9 @@ input_init(struct window_pane *wp, struct bufferevent *bev,
 {
 	struct input_ctx	*ictx;
 
+	if (!input_lookup_built)
+		input_build_lookup();
+
 	ictx = xcalloc(1, sizeof *ictx);
 	ictx->wp = wp;
 	ictx->event = bev;
@@ -861,6 +952,17 @@ input_free(struct input_ctx *ictx)
 	free(ictx);
 }
 
+/*
+ * Stop diverting to a remote client. Must be called before the pane event is
+ * freed because the remote reads from a filter on top of it.
+ */
+void
+input_stop_remote(struct input_ctx *ictx)
+{
+	if (ictx->flags & INPUT_REMOTE)
+		input_exit_remote(ictx);
+}
+
 /* Reset input state and clear screen. */
 void
 input_reset(struct input_ctx *ictx, int clear)
@@ -908,42 +1010,52 @@ static size_t
 input_parse(struct input_ctx *ictx, u_char *buf, size_t len)
 {
 	struct screen_write_ctx		*sctx = &ictx->ctx;
-	const struct input_state	*state = NULL;
-	const struct input_transition	*itr = NULL;
-	size_t				 off = 0;
+	const struct input_transition	*itr;
+	size_t				 off = 0, n;
 
 	/* Parse the input. */
 	while (off < len) {
 		ictx->ch = buf[off++];
 
 		/* Find the transition. */
-		if (ictx->state != state ||
-		    itr == NULL ||
-		    ictx->ch < itr->first ||
-		    ictx->ch > itr->last) {
-			itr = ictx->state->transitions;
-			while (itr->first != -1 && itr->last != -1) {
-				if (ictx->ch >= itr->first &&
-				    ictx->ch <= itr->last)
-					break;
-				itr++;
-			}
-			if (itr->first == -1 || itr->last == -1) {
-				/* No transition? Eh? */
-				fatalx("no transition from state");
+		itr = input_lookup[ictx->state->index][ictx->ch];
+
+		/*
+		 * Any state except print (or UTF-8) stops the current
+		 * collection. This is an optimization to avoid checking if the
+		 * attributes have changed for every character. It will stop
+		 * unnecessarily for sequences that don't make a terminal
+		 * change, but they should be the minority.
+		 */
+		if (itr->handler == input_top_bit_set)
+			;
+		else if (itr->handler != input_print)
+			screen_write_collect_end(sctx);
+		else {
+			/*
+			 * Printable characters are only handled in the ground
+			 * state, so hand the whole run over at once.
+			 */
+			n = input_print_run(buf + off, len - off);
+			if (n != 0) {
+				input_print_span(ictx, buf + off - 1, n + 1);
+				off += n;
+				continue;
 			}
 		}
-		state = ictx->state;
 
 		/*
-		 * Any state except print stops the current collection. This is
-		 * an optimization to avoid checking if the attributes have
-		 * changed for every character. It will stop unnecessarily for
-		 * sequences that don't make a terminal change, but they should
-		 * be the minority.
+		 * String payloads are only collected outside the ground
+		 * state, so take everything up to the terminator in one go.
 		 */
-		if (itr->handler != input_print)
-			screen_write_collect_end(sctx);
+		if (itr->handler == input_input && itr->state == NULL) {
+			n = input_input_run(ictx, buf + off, len - off);
+			input_input_span(ictx, buf + off - 1, n + 1);
+			if (ictx->since_ground_start == NULL)
+				ictx->since_ground_start = buf + off - 1;
+			off += n;
+			continue;
+		}
 
 		/*
 		 * Execute the handler, if any. Don't switch state if it
@@ -958,11 +1070,22 @@ input_parse(struct input_ctx *ictx, u_char *buf, size_t len)
 
 		/* Divert input to the remote */
 		if (ictx->flags & INPUT_REMOTE)
-			return off;
+			break;
 
-		/* If not in ground state, save input. */
-		if (ictx->state != &input_state_ground)
-			evbuffer_add(ictx->since_ground, &ictx->ch, 1);
+		/*
+		 * If not in ground state, save input. Entering the ground
+		 * state throws away what was saved.
+		 */
+		if (ictx->state != &input_state_ground &&
+		    ictx->since_ground_start == NULL)
+			ictx->since_ground_start = buf + off - 1;
+	}
+
+	/* Save whatever was not consumed by the end of a sequence. */
+	if (ictx->since_ground_start != NULL) {
+		evbuffer_add(ictx->since_ground, ictx->since_ground_start,
+		    buf + off - ictx->since_ground_start);
+		ictx->since_ground_start = NULL;
 	}
 
 	return off;
@@ -1008,6 +1131,9 @@ input_parse_buffer(struct window_pane *wp, u_char *buf, size_t len)
 
 	len = input_parse(ictx, buf, len);
 	screen_write_stop(sctx);
+
+	/* Leaving the alternate screen may have resized the normal screen. */
+	window_pane_reflow(wp);
 	return len;
 }
 
@@ -1145,6 +1271,7 @@ input_ground(struct input_ctx *ictx)
 {
 	event_del(&ictx->timer);
 	evbuffer_drain(ictx->since_ground, EVBUFFER_LENGTH(ictx->since_ground));
+	ictx->since_ground_start = NULL;
 
 	if (ictx->input_space > INPUT_BUF_START) {
 		ictx->input_space = INPUT_BUF_START;
@@ -1177,6 +1304,67 @@ input_print(struct input_ctx *ictx)
 	return (0);
 }
 
+/* Find the length of the run of printable ASCII at the start of a buffer. */
+static size_t
+input_print_run(const u_char *buf, size_t len)
+{
+	size_t	n = 0;
+#if defined(__AVX2__)
+	__m256i	v, lo = _mm256_set1_epi8(0x1f), hi = _mm256_set1_epi8(0x7f);
+	u_int	mask;
+
+	for (; len - n >= 32; n += 32) {
+		v = _mm256_loadu_si256((const __m256i *)(buf + n));
+		mask = ~_mm256_movemask_epi8(_mm256_andnot_si256(
+		    _mm256_cmpeq_epi8(v, hi), _mm256_cmpgt_epi8(v, lo)));
+		if (mask != 0)
+			return (n + __builtin_ctz(mask));
+	}
+#elif defined(__SSE2__)
+	__m128i	v, lo = _mm_set1_epi8(0x1f), hi = _mm_set1_epi8(0x7f);
+	u_int	mask;
+
+	for (; len - n >= 16; n += 16) {
+		v = _mm_loadu_si128((const __m128i *)(buf + n));
+		mask = ~_mm_movemask_epi8(_mm_andnot_si128(
+		    _mm_cmpeq_epi8(v, hi), _mm_cmpgt_epi8(v, lo))) & 0xffff;
+		if (mask != 0)
+			return (n + __builtin_ctz(mask));
+	}
+#endif
+
+	while (n < len && buf[n] >= 0x20 && buf[n] <= 0x7e)
+		n++;
+	return (n);
+}
+
+/* Print a run of printable ASCII. */
+static void
+input_print_span(struct input_ctx *ictx, const u_char *buf, size_t len)
+{
+	struct screen_write_ctx	*sctx = &ictx->ctx;
+	size_t			 i;
+	int			 set;
+
+	set = ictx->cell.set == 0 ? ictx->cell.g0set : ictx->cell.g1set;
+	if (set == 1) {
+		for (i = 0; i < len; i++) {
+			ictx->ch = buf[i];
+			input_print(ictx);
+		}
+		return;
+	}
+
+	ictx->utf8started = 0; /* can't be valid UTF-8 */
+	ictx->cell.cell.attr &= ~GRID_ATTR_CHARSET;
+	screen_write_collect_span(sctx, &ictx->cell.cell, buf, len);
+
+	ictx->ch = buf[len - 1];
+	utf8_set(&ictx->cell.cell.data, ictx->ch);
+	utf8_copy(&ictx->last, &ictx->cell.cell.data);
+	ictx->flags |= INPUT_LAST;
+}
+
 /* Collect intermediate string. */
 static int
 input_intermediate(struct input_ctx *ictx)
@@ -1219,23 +1407,54 @@ input_enter_dcs_handler(struct input_ctx *ictx)
 /* Collect input string. */
 static int
 input_input(struct input_ctx *ictx)
+{
+	u_char	ch = ictx->ch;
+
+	input_input_span(ictx, &ch, 1);
+	return (0);
+}
+
+/*
+ * Return how many bytes from buf are collected as input string without
+ * leaving the current state.
+ */
+static size_t
+input_input_run(struct input_ctx *ictx, const u_char *buf, size_t len)
+{
+	const struct input_transition	**lookup;
+	const struct input_transition	 *itr;
+	size_t				  n;
+
+	lookup = input_lookup[ictx->state->index];
+	for (n = 0; n < len; n++) {
+		itr = lookup[buf[n]];
+		if (itr->handler != input_input || itr->state != NULL)
+			break;
+	}
+	return (n);
+}
+
+/* Collect a run of input string. */
+static void
+input_input_span(struct input_ctx *ictx, const u_char *buf, size_t len)
 {
 	size_t available;
 
 	available = ictx->input_space;
-	while (ictx->input_len + 1 >= available) {
+	while (ictx->input_len + len >= available) {
 		available *= 2;
 		if (available > input_buffer_size) {
 			ictx->flags |= INPUT_DISCARD;
-			return (0);
+			return;
 		}
+	}
+	if (available != ictx->input_space) {
 		ictx->input_buf = xrealloc(ictx->input_buf, available);
 		ictx->input_space = available;
 	}
-	ictx->input_buf[ictx->input_len++] = ictx->ch;
+	memcpy(ictx->input_buf + ictx->input_len, buf, len);
+	ictx->input_len += len;
 	ictx->input_buf[ictx->input_len] = '\0';
-
-	return (0);
 }
 
 /* Execute C0 control sequence. */
@@ -2444,6 +2663,7 @@ input_dcs_dispatch(struct input_ctx *ictx)
 
 struct divert_ctx {
 	struct window_pane  *wp;
+	struct bufferevent  *event;	/* kept by the filter until freed */
 	struct evbuffer	    *temp_buf;
 	bufferevent_data_cb  saved_readcb;
 	bufferevent_data_cb  saved_writecb;
@@ -2484,7 +2704,7 @@ input_restore(void *ctx)
 {
 	struct divert_ctx *d = ctx;
 
-	bufferevent_setcb(d->wp->event, d->saved_readcb, d->saved_writecb,
+	bufferevent_setcb(d->event, d->saved_readcb, d->saved_writecb,
 	    d->saved_eventcb, d->saved_cbarg);
 	evbuffer_free(d->temp_buf);
 	free(d);
@@ -2501,6 +2721,7 @@ input_divert(struct window_pane *wp)
 		return (NULL);
 
 	d->wp = wp;
+	d->event = wp->event;
 	d->temp_buf = evbuffer_new();
 	bufferevent_getcb(wp->event, &d->saved_readcb, &d->saved_writecb,
 	    &d->saved_eventcb, &d->saved_cbarg);
@@ -2534,6 +2755,7 @@ input_enter_remote(struct input_ctx *ictx)
 
 	event_del(&ictx->timer);
 	evbuffer_drain(ictx->since_ground, EV_SIZE_MAX);
+	ictx->since_ground_start = NULL;
 
 	ictx->flags |= INPUT_REMOTE;
 #endif
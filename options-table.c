@@ -355,6 +355,18 @@ const struct options_table_entry options_table[] = {
 	  .text = "Whether to send focus events to applications."
 	},
 
+	{ .name = "frame-rate",
+	  .type = OPTIONS_TABLE_NUMBER,
+	  .scope = OPTIONS_TABLE_SERVER,
+	  .minimum = 0,
+	  .maximum = 1000,
+	  .default_num = 0,
+	  .unit = "frames per second",
+	  .text = "Maximum number of times a second to update each client. "
+		  "Changes made in between are drawn together. "
+		  "0 means no limit."
+	},
+
 	{ .name = "history-file",
 	  .type = OPTIONS_TABLE_STRING,
 	  .scope = OPTIONS_TABLE_SERVER,
@@ -363,6 +375,18 @@ const struct options_table_entry options_table[] = {
 		  "Empty does not write a history file."
 	},
 
+	{ .name = "history-memory-limit",
+	  .type = OPTIONS_TABLE_NUMBER,
+	  .scope = OPTIONS_TABLE_SERVER,
+	  .minimum = 0,
+	  .maximum = INT_MAX,
+	  .default_num = 0,
+	  .unit = "kilobytes",
+	  .text = "Maximum memory used by the history of all panes together. "
+		  "Lines are released from the panes least recently seen "
+		  "first; 0 means no limit."
+	},
+
 	{ .name = "input-buffer-size",
 	  .type = OPTIONS_TABLE_NUMBER,
 	  .scope = OPTIONS_TABLE_SERVER,
@@ -698,6 +722,14 @@ const struct options_table_entry options_table[] = {
 	  .text = "A second prefix key."
 	},
 
+	{ .name = "remote-predict",
+	  .type = OPTIONS_TABLE_FLAG,
+	  .scope = OPTIONS_TABLE_SESSION,
+	  .default_num = 0,
+	  .text = "Whether keys typed into a remote pane are shown before "
+		  "they are echoed by the server."
+	},
+
 	{ .name = "renumber-windows",
 	  .type = OPTIONS_TABLE_FLAG,
 	  .scope = OPTIONS_TABLE_SESSION,
@@ -1074,6 +1106,28 @@ const struct options_table_entry options_table[] = {
 	  .text = "Character used to fill unused parts of window."
 	},
 
+	{ .name = "history-compress",
+	  .type = OPTIONS_TABLE_NUMBER,
+	  .scope = OPTIONS_TABLE_WINDOW|OPTIONS_TABLE_PANE,
+	  .minimum = 0,
+	  .maximum = INT_MAX,
+	  .default_num = 0,
+	  .unit = "lines",
+	  .text = "Number of lines of history to keep uncompressed. Older "
+		  "lines are compressed; 0 means none are."
+	},
+
+	{ .name = "history-spill",
+	  .type = OPTIONS_TABLE_NUMBER,
+	  .scope = OPTIONS_TABLE_WINDOW|OPTIONS_TABLE_PANE,
+	  .minimum = 0,
+	  .maximum = INT_MAX,
+	  .default_num = 0,
+	  .unit = "lines",
+	  .text = "Number of lines of history to keep in memory. Older lines "
+		  "are written to a file; 0 means none are."
+	},
+
 	{ .name = "main-pane-height",
 	  .type = OPTIONS_TABLE_STRING,
 	  .scope = OPTIONS_TABLE_WINDOW,
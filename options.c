@@ -1202,6 +1202,18 @@ options_push_changes(const char *name)
 		RB_FOREACH(wp, window_pane_tree, &all_window_panes)
 			window_pane_default_cursor(wp);
 	}
+	if (strcmp(name, "history-compress") == 0) {
+		RB_FOREACH(wp, window_pane_tree, &all_window_panes) {
+			grid_compress_history(wp->base.grid,
+			    options_get_number(wp->options, name));
+		}
+	}
+	if (strcmp(name, "history-spill") == 0) {
+		RB_FOREACH(wp, window_pane_tree, &all_window_panes) {
+			grid_spill_history(wp->base.grid,
+			    options_get_number(wp->options, name));
+		}
+	}
 	if (strcmp(name, "fill-character") == 0) {
 		RB_FOREACH(w, windows, &windows)
 			window_set_fill_character(w);
@@ -0,0 +1,39 @@
+#!/bin/sh
+
+# With frame-rate set, output that scrolls past quickly must not all be sent to
+# the client and the client must still end up showing the pane
+
+PATH=/bin:/usr/bin
+TERM=screen
+
+[ -z "$TEST_TMUX" ] && TEST_TMUX=$(readlink -f ../tmux)
+TMUX="$TEST_TMUX -Ltest"
+$TMUX kill-server 2>/dev/null
+TMUX2="$TEST_TMUX -Ltest2"
+$TMUX2 kill-server 2>/dev/null
+
+TMP1=$(mktemp)
+TMP2=$(mktemp)
+trap "rm -f $TMP1 $TMP2" 0 1 15
+
+$TMUX2 -f/dev/null new -d \; set -g frame-rate 30 \; \
+       set -g status-right '' || exit 1
+$TMUX -f/dev/null new -d -x60 -y10 "$TMUX2 attach" \; \
+      set -g status off || exit 1
+sleep 1
+
+C=$($TMUX2 lsc -F '#{client_name}')
+W1=$($TMUX2 display -c$C -p '#{client_written}')
+$TMUX2 send "seq 1 100000; $TMUX2 wait -S done" Enter || exit 1
+$TMUX2 wait done || exit 1
+sleep 1
+W2=$($TMUX2 display -c$C -p '#{client_written}')
+[ $((W2 - W1)) -lt 5000 ] || exit 1
+
+$TMUX capturep -p|head -9 >$TMP1
+$TMUX2 capturep -p >$TMP2
+cmp -s $TMP1 $TMP2 || exit 1
+
+$TMUX kill-server 2>/dev/null
+$TMUX2 kill-server 2>/dev/null
+exit 0
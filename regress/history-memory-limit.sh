@@ -0,0 +1,39 @@
+#!/bin/sh
+
+# history-memory-limit must keep the history of all panes under the limit,
+# taking lines from the largest pane first when none are being viewed, and
+# history_bytes must count the copy made by copy mode
+
+PATH=/bin:/usr/bin
+TERM=screen
+
+[ -z "$TEST_TMUX" ] && TEST_TMUX=$(readlink -f ../tmux)
+TMUX="$TEST_TMUX -Ltest"
+$TMUX kill-server 2>/dev/null
+
+$TMUX -f/dev/null new -d -x80 -y10 "seq 1 100; cat" || exit 1
+$TMUX set -g history-limit 5000 \; neww -d "seq 1 3000; cat" || exit 1
+sleep 1
+
+[ "$($TMUX display -pt:0 '#{history_size}')" = 91 ] || exit 1
+[ "$($TMUX display -pt:1 '#{history_size}')" = 2991 ] || exit 1
+T0=$($TMUX display -p '#{server_history_bytes}')
+
+# Copy mode works on a copy of the history, which is counted as well.
+B0=$($TMUX display -pt:1 '#{history_bytes}')
+$TMUX copy-mode -t:1 || exit 1
+B1=$($TMUX display -pt:1 '#{history_bytes}')
+[ "$B1" -gt $((B0 + B0 / 2)) ] || exit 1
+$TMUX send -t:1 -X cancel || exit 1
+[ "$($TMUX display -pt:1 '#{history_bytes}')" = "$B0" ] || exit 1
+
+$TMUX set -g history-memory-limit $((T0 / 2048)) || exit 1
+sleep 1
+
+T1=$($TMUX display -p '#{server_history_bytes}')
+[ "$T1" -le $((T0 / 2)) ] || exit 1
+[ "$($TMUX display -pt:0 '#{history_size}')" = 91 ] || exit 1
+[ "$($TMUX display -pt:1 '#{history_size}')" -lt 2991 ] || exit 1
+
+$TMUX kill-server 2>/dev/null
+exit 0
@@ -0,0 +1,67 @@
+#!/bin/sh
+
+# Old history left to be reflowed after a resize must end up the same as
+# history reflowed all at once
+
+PATH=/bin:/usr/bin
+TERM=screen
+
+[ -z "$TEST_TMUX" ] && TEST_TMUX=$(readlink -f ../tmux)
+TMUX="$TEST_TMUX -Ltest"
+$TMUX kill-server 2>/dev/null
+
+TMP1=$(mktemp)
+TMP2=$(mktemp)
+trap "rm -f $TMP1 $TMP2" 0 1 15
+
+CMD="
+for i in \$(seq 1 5000); do
+	printf '\033[3%dmline %d\033[m \303\251\344\270\226 %0*d\n' \
+	    \$((i % 8)) \$i \$((i % 70)) 0
+done
+cat"
+$TMUX -f/dev/null start \; set -g history-limit 10000 \; \
+      set -g default-size 40x10 \; new -d "$CMD" \; neww -d "$CMD" || exit 1
+sleep 2
+
+# Window 0 is reflowed at once by capturing, window 1 by the timer.
+$TMUX resizew -t:0 -x25 \; resizew -t:1 -x25 \; \
+      resizew -t:0 -x33 \; resizew -t:1 -x33 || exit 1
+$TMUX capturep -t:0 -peS- >$TMP1
+sleep 1
+$TMUX capturep -t:1 -peS- >$TMP2
+cmp -s $TMP1 $TMP2 || exit 1
+S0=$($TMUX display -pt:0 '#{history_size}')
+S1=$($TMUX display -pt:1 '#{history_size}')
+[ "$S0" = "$S1" ] || exit 1
+
+# Copy mode must see the whole history reflowed.
+$TMUX resizew -t:1 -x50 \; copy-mode -t:1 \; send -t:1 -X history-top \; \
+      send -t:1 -X begin-selection \; send -t:1 -X cursor-down \; \
+      send -t:1 -X end-of-line \; send -t:1 -X copy-selection || exit 1
+[ "$($TMUX showb)" = "line 1 é世 0
+line 2 é世 00" ] || exit 1
+
+# History resized while the alternate screen is active is reflowed when it is
+# left, and the rest must be finished by the timer without anything asking.
+ALT="
+for i in \$(seq 1 5000); do
+	printf 'line %d %0*d\n' \$i \$((i % 70)) 0
+done
+printf '\033[?1049h'
+read x
+printf '\033[?1049l'
+cat"
+$TMUX neww -d -t:2 "$ALT" \; neww -d -t:3 "$ALT" || exit 1
+sleep 2
+$TMUX send -t:3 Enter \; resizew -t:2 -x25 \; resizew -t:3 -x25 || exit 1
+sleep 1
+$TMUX send -t:2 Enter || exit 1
+sleep 1
+S2=$($TMUX display -pt:2 '#{history_size}')
+$TMUX capturep -t:3 -pS- >/dev/null
+S3=$($TMUX display -pt:3 '#{history_size}')
+[ "$S2" = "$S3" ] || exit 1
+
+$TMUX kill-server 2>/dev/null
+exit 0
@@ -0,0 +1,68 @@
+#!/bin/sh
+
+# History spilled to a file must capture the same as history kept in memory,
+# including after the lines have been reflowed and from copy mode, and reading
+# it must leave it in the file
+
+PATH=/bin:/usr/bin
+TERM=screen
+
+[ -z "$TEST_TMUX" ] && TEST_TMUX=$(readlink -f ../tmux)
+TMUX="$TEST_TMUX -Ltest"
+$TMUX kill-server 2>/dev/null
+
+TMP1=$(mktemp)
+TMP2=$(mktemp)
+trap "rm -f $TMP1 $TMP2" 0 1 15
+
+CMD="
+for i in \$(seq 1 300); do
+	printf '\033[3%dmline %d\033[m \303\251\344\270\226 ' \$((i % 8)) \$i
+	printf '\033[38;2;%d;0;0m%0*d\033[m\n' \$i \$((i % 50)) 0
+done
+cat"
+$TMUX -f/dev/null new -d -x40 -y10 "$CMD" || exit 1
+$TMUX set -g history-limit 1000 \; neww -d "$CMD" || exit 1
+$TMUX set -pt:1 history-spill 10 || exit 1
+sleep 1
+
+B0=$($TMUX display -pt:0 '#{history_bytes}')
+B1=$($TMUX display -pt:1 '#{history_bytes}')
+[ "$B1" -lt "$B0" ] || exit 1
+
+check()
+{
+	$TMUX capturep -t:0 -peJS- >$TMP1
+	$TMUX capturep -t:1 -peJS- >$TMP2
+	cmp -s $TMP1 $TMP2 || exit 1
+}
+check
+[ "$($TMUX display -pt:1 '#{history_bytes}')" -eq "$B1" ] || exit 1
+$TMUX resizew -t:0 -x25 \; resizew -t:1 -x25 || exit 1
+sleep 1
+check
+$TMUX resizew -t:0 -x60 \; resizew -t:1 -x60 || exit 1
+sleep 1
+check
+
+copy()
+{
+	$TMUX copy-mode -t:$1 \; send -t:$1 -X history-top \; \
+	      send -t:$1 -X search-forward 'line 20' \; \
+	      send -t:$1 -X begin-selection \; send -t:$1 -X cursor-down \; \
+	      send -t:$1 -X copy-selection || exit 1
+	$TMUX showb >$2 || exit 1
+}
+copy 0 $TMP1
+copy 1 $TMP2
+[ -s $TMP1 ] && cmp -s $TMP1 $TMP2 || exit 1
+
+# Copy mode has its own copy of the lines in memory but shares the file, so
+# searching them should change little more than what is on screen.
+B1=$($TMUX display -pt:1 '#{history_bytes}')
+$TMUX send -t:1 -X history-top \; send -t:1 -X search-forward 'line 290' || \
+	exit 1
+[ "$($TMUX display -pt:1 '#{history_bytes}')" -lt $((B1 + B1 / 10)) ] || exit 1
+
+$TMUX kill-server 2>/dev/null
+exit 0
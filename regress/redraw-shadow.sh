@@ -0,0 +1,61 @@
+#!/bin/sh
+
+# Redrawing a client must only send cells the terminal is not already showing
+# and must leave the terminal and the cursor the same as a full redraw
+
+PATH=/bin:/usr/bin
+TERM=screen
+
+[ -z "$TEST_TMUX" ] && TEST_TMUX=$(readlink -f ../tmux)
+TMUX="$TEST_TMUX -Ltest"
+$TMUX kill-server 2>/dev/null
+TMUX2="$TEST_TMUX -Ltest2"
+$TMUX2 kill-server 2>/dev/null
+
+TMP1=$(mktemp)
+TMP2=$(mktemp)
+trap "rm -f $TMP1 $TMP2" 0 1 15
+
+CMD="
+for i in \$(seq 1 30); do
+	printf '\033[3%dmline %d\033[m \303\251\344\270\226 %0*d\n' \
+	    \$((i % 8)) \$i \$((i % 40)) 0
+done
+cat"
+$TMUX2 -f/dev/null new -d "$CMD" \; set -g status-right '' \; \
+       set -g automatic-rename off \; neww -d "$CMD" || exit 1
+$TMUX -f/dev/null new -d -x60 -y10 "$TMUX2 attach" \; \
+      set -g status off || exit 1
+sleep 1
+
+check()
+{
+	$TMUX capturep -peJ >$TMP1
+	(
+		$TMUX2 capturep -peJ
+		$TMUX capturep -peJ|tail -1
+	) >$TMP2
+	cmp -s $TMP1 $TMP2 || exit 1
+	P1=$($TMUX display -p '#{cursor_x},#{cursor_y}')
+	P2=$($TMUX2 display -p '#{cursor_x},#{cursor_y}')
+	[ "$P1" = "$P2" ] || exit 1
+}
+check
+
+# The windows have the same content so only the status line is redrawn.
+C=$($TMUX2 lsc -F '#{client_name}')
+$TMUX2 selectw -t:1 || exit 1
+sleep 1
+check
+N=$($TMUX2 display -c$C -p '#{client_redraw_written}')
+[ "$N" -lt 200 ] || exit 1
+
+$TMUX2 splitw -h "seq 1 20; cat" \; resizep -Z || exit 1
+sleep 1
+$TMUX2 resizep -Z \; killp \; selectw -t:0 || exit 1
+sleep 1
+check
+
+$TMUX kill-server 2>/dev/null
+$TMUX2 kill-server 2>/dev/null
+exit 0
@@ -0,0 +1,46 @@
+#!/bin/sh
+
+# history above what was copied when attaching is fetched with its wrapping
+# when a search up does not find anything, and the search is run again once it
+# arrives
+
+PATH=/bin:/usr/bin
+TERM=screen
+
+[ -z "$TEST_TMUX" ] && TEST_TMUX=$(readlink -f ../tmux)
+TMUX="$TEST_TMUX -Ltest"
+TMUX2="$TEST_TMUX -Ltest2"
+$TMUX kill-server 2>/dev/null
+$TMUX2 kill-server 2>/dev/null
+
+CMD="
+for i in \$(seq 1 3000); do
+	printf '%0*d\n' \$((i % 230)) \$i
+done | sed '100s/\$/ needle/'
+cat"
+$TMUX2 -f/dev/null start \; set -g history-limit 10000 \; \
+       new -d -sinner -x80 -y24 "$CMD" || exit 1
+sleep 2
+$TMUX -f/dev/null start \; set -g history-limit 10000 \; \
+      new -souter -d -x80 -y24 "$TMUX2 -f/dev/null -CC attach -tinner" || \
+      exit 1
+sleep 2
+
+# Skip if built without remote support.
+$TMUX has -tinner 2>/dev/null || exit 0
+
+# The match is on the second row of line 100, well above the first copy.
+$TMUX copy-mode -tinner \; send -tinner -X search-backward needle || exit 1
+sleep 3
+P=$($TMUX display -pt inner '#{copy_cursor_x} #{copy_cursor_line}')
+[ "$P" = "21 $(printf '%020d' 100) needle" ] || exit 1
+
+# Fetched lines must keep their wrapping.
+$TMUX send -tinner -X history-top || exit 1
+sleep 3
+[ "$($TMUX capturep -pJ -tinner -S-)" = \
+  "$($TMUX2 capturep -pJ -tinner -S-)" ] || exit 1
+
+$TMUX kill-server 2>/dev/null
+$TMUX2 kill-server 2>/dev/null
+exit 0
@@ -0,0 +1,47 @@
+#!/bin/sh
+
+# keys typed into a remote pane are shown before their echo and removed again
+# if the echo never arrives
+
+PATH=/bin:/usr/bin
+TERM=screen
+
+[ -z "$TEST_TMUX" ] && TEST_TMUX=$(readlink -f ../tmux)
+TMUX="$TEST_TMUX -Ltest"
+TMUX2="$TEST_TMUX -Ltest2"
+$TMUX kill-server 2>/dev/null
+$TMUX2 kill-server 2>/dev/null
+
+$TMUX2 -f/dev/null new -d -sinner -x80 -y24 'PS1=$ sh' || exit 1
+$TMUX -f/dev/null new -souter -d -x80 -y24 \
+	"$TMUX2 -f/dev/null -CC attach -tinner" || exit 1
+sleep 2
+
+# Skip if built without remote support.
+$TMUX has -tinner 2>/dev/null || exit 0
+
+$TMUX set -g remote-predict on || exit 1
+$TMUX send -tinner 'clear' Enter || exit 1
+sleep 1
+$TMUX send -tinner 'clear' Enter || exit 1
+sleep 1
+
+# The first key is only shown once it has been seen to echo.
+$TMUX send -tinner -l 'e' || exit 1
+sleep 1
+$TMUX send -tinner -l 'cho ok' || exit 1
+sleep 1
+[ "$($TMUX capture-pane -p -tinner -E0)" = '$echo ok' ] || exit 1
+$TMUX display -p -tinner '#{session_remote_echo_latency}' |
+	grep -q '^[0-9][0-9]*$' || exit 1
+
+# Without an echo, predicted keys are taken away again.
+$TMUX2 send -tinner C-u 'clear; stty -echo' Enter || exit 1
+sleep 1
+$TMUX send -tinner -l 'abc' || exit 1
+sleep 3
+[ "$($TMUX capture-pane -p -tinner -E0)" = '$' ] || exit 1
+
+$TMUX kill-server 2>/dev/null
+$TMUX2 kill-server 2>/dev/null
+exit 0
@@ -0,0 +1,39 @@
+#!/bin/sh
+
+# commands sent to a remote server must all be answered, repeated window
+# selections coalesced and the queue reported through formats
+
+PATH=/bin:/usr/bin
+TERM=screen
+
+[ -z "$TEST_TMUX" ] && TEST_TMUX=$(readlink -f ../tmux)
+TMUX="$TEST_TMUX -Ltest"
+TMUX2="$TEST_TMUX -Ltest2"
+$TMUX kill-server 2>/dev/null
+$TMUX2 kill-server 2>/dev/null
+
+$TMUX2 -f/dev/null new -d -sinner -x80 -y24 'cat' || exit 1
+$TMUX2 neww -d -tinner:1 'cat' || exit 1
+$TMUX -f/dev/null new -souter -d -x80 -y24 \
+	"$TMUX2 -f/dev/null -CC attach -tinner" || exit 1
+sleep 2
+
+# Skip if built without remote support.
+$TMUX has -tinner 2>/dev/null || exit 0
+
+for i in 1 2 3 4 5 6 7 8 9 10; do
+	$TMUX selectw -tinner:1 || exit 1
+	$TMUX selectw -tinner:0 || exit 1
+done
+$TMUX selectw -tinner:1 || exit 1
+sleep 1
+
+[ "$($TMUX2 display -p -tinner '#{window_index}')" = 1 ] || exit 1
+[ "$($TMUX display -p -tinner '#{session_remote_queue}')" = 0 ] || exit 1
+$TMUX display -p -tinner '#{session_remote_latency}' |
+	grep -q '^[0-9][0-9]*\.[0-9][0-9][0-9]$' ||
+	exit 1
+
+$TMUX kill-server 2>/dev/null
+$TMUX2 kill-server 2>/dev/null
+exit 0
@@ -0,0 +1,60 @@
+#!/bin/sh
+
+# a remote session is kept when the control client goes away without %exit
+# and brought up to date when the same session is attached to again
+
+PATH=/bin:/usr/bin
+TERM=screen
+
+[ -z "$TEST_TMUX" ] && TEST_TMUX=$(readlink -f ../tmux)
+TMUX="$TEST_TMUX -Ltest"
+TMUX2="$TEST_TMUX -Ltest2"
+$TMUX kill-server 2>/dev/null
+$TMUX2 kill-server 2>/dev/null
+
+$TMUX2 -f/dev/null new -d -sinner -x80 -y24 'cat' || exit 1
+$TMUX2 neww -d -tinner:1 'echo same; cat' || exit 1
+$TMUX -f/dev/null new -souter -d -x80 -y24 'cat' || exit 1
+$TMUX neww -d -touter "$TMUX2 -f/dev/null -CC attach -tinner" || exit 1
+sleep 2
+
+# Skip if built without remote support.
+$TMUX has -tinner 2>/dev/null || exit 0
+
+$TMUX2 send -tinner:0 'before' Enter || exit 1
+sleep 1
+
+# Lose the control client.
+kill -9 $($TMUX2 lsc -F '#{client_pid}') || exit 1
+sleep 1
+$TMUX has -tinner || exit 1
+
+i=0
+while [ $i -lt 30 ]; do
+	$TMUX2 send -tinner:0 "line$i" Enter || exit 1
+	i=$((i + 1))
+done
+$TMUX2 neww -d -tinner:2 'echo new; cat' || exit 1
+sleep 1
+
+$TMUX neww -d -touter "$TMUX2 -f/dev/null -CC attach -tinner" || exit 1
+sleep 2
+
+[ "$($TMUX lsw -tinner -F '#{window_index}' | xargs)" = "0 1 2" ] || exit 1
+for w in 0 1 2; do
+	L=$($TMUX capture-pane -pJ -S- -tinner:$w)
+	R=$($TMUX2 capture-pane -pJ -S- -tinner:$w)
+	[ "$L" = "$R" ] || exit 1
+	L=$($TMUX display -p -tinner:$w '#{pane_checksum}')
+	R=$($TMUX2 display -p -tinner:$w '#{pane_checksum}')
+	[ "$L" = "$R" ] || exit 1
+done
+
+# Keys are forwarded again.
+$TMUX send -tinner:1 'after' Enter || exit 1
+sleep 1
+$TMUX2 capture-pane -p -tinner:1 | grep -q '^after$' || exit 1
+
+$TMUX kill-server 2>/dev/null
+$TMUX2 kill-server 2>/dev/null
+exit 0
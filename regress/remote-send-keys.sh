@@ -0,0 +1,37 @@
+#!/bin/sh
+
+# keys written to a remote pane must reach the inner pane unchanged
+
+PATH=/bin:/usr/bin
+TERM=screen
+
+[ -z "$TEST_TMUX" ] && TEST_TMUX=$(readlink -f ../tmux)
+TMUX="$TEST_TMUX -Ltest"
+TMUX2="$TEST_TMUX -Ltest2"
+$TMUX kill-server 2>/dev/null
+$TMUX2 kill-server 2>/dev/null
+
+IN=$(mktemp)
+OUT=$(mktemp)
+trap "rm -f $IN $OUT" 0 1 15
+
+# Everything except newline, which paste-buffer changes into \r.
+LC_ALL=C awk 'BEGIN { for (n = 0; n < 64; n++) for (i = 1; i < 256; i++)
+	if (i != 10) printf "%c", i }' </dev/null >$IN
+
+$TMUX -f/dev/null new -sremote -d -x80 -y24 \
+	"$TMUX2 -f/dev/null -CC new -x80 -y24 'stty raw -echo; cat >$OUT'" ||
+	exit 1
+sleep 2
+
+# Skip if built without remote support.
+$TMUX has -t0 2>/dev/null || exit 0
+
+$TMUX loadb $IN || exit 1
+$TMUX pasteb -t0: || exit 1
+sleep 2
+cmp -s $IN $OUT || exit 1
+
+$TMUX kill-server 2>/dev/null
+$TMUX2 kill-server 2>/dev/null
+exit 0
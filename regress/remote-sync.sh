@@ -0,0 +1,53 @@
+#!/bin/sh
+
+# windows and panes changed on the server must be mirrored in place
+
+PATH=/bin:/usr/bin
+TERM=screen
+
+[ -z "$TEST_TMUX" ] && TEST_TMUX=$(readlink -f ../tmux)
+TMUX="$TEST_TMUX -Ltest"
+TMUX2="$TEST_TMUX -Ltest2"
+$TMUX kill-server 2>/dev/null
+$TMUX2 kill-server 2>/dev/null
+
+$TMUX2 -f/dev/null new -d -sinner -x80 -y24 'seq 1 50; cat' || exit 1
+$TMUX -f/dev/null new -souter -d -x80 -y24 \
+	"$TMUX2 -f/dev/null -CC attach -tinner" || exit 1
+sleep 2
+
+# Skip if built without remote support.
+$TMUX has -tinner 2>/dev/null || exit 0
+
+check() {
+	sleep 1
+	F='#{window_index} #{window_name} #{pane_index} #{pane_width}x#{pane_height}'
+	L=$($TMUX lsp -s -tinner -F "$F")
+	R=$($TMUX2 lsp -s -tinner -F "$F")
+	[ "$L" = "$R" ] || exit 1
+}
+
+$TMUX2 renamew -tinner:0 first || exit 1
+$TMUX2 splitw -h -tinner:0 'echo pane; cat' || exit 1
+check
+$TMUX capture-pane -p -tinner:0.1 | grep -q '^pane$' || exit 1
+
+$TMUX2 neww -d -tinner:1 -nsecond 'cat' || exit 1
+$TMUX2 splitw -v -tinner:1 'cat' || exit 1
+check
+
+$TMUX2 kill-pane -tinner:0.0 || exit 1
+$TMUX2 resize-pane -tinner:1.0 -U 3 || exit 1
+check
+
+$TMUX2 breakp -d -s inner:1.1 || exit 1
+check
+$TMUX2 joinp -s inner:2 -t inner:1 || exit 1
+check
+
+$TMUX2 killw -tinner:1 || exit 1
+check
+
+$TMUX kill-server 2>/dev/null
+$TMUX2 kill-server 2>/dev/null
+exit 0
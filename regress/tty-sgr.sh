@@ -0,0 +1,39 @@
+#!/bin/sh
+
+# Attributes and colours changed with merged SGR sequences, turning some off on
+# their own rather than resetting, must leave the terminal showing the pane
+
+PATH=/bin:/usr/bin
+TERM=screen
+
+[ -z "$TEST_TMUX" ] && TEST_TMUX=$(readlink -f ../tmux)
+TMUX="$TEST_TMUX -Ltest"
+$TMUX kill-server 2>/dev/null
+TMUX2="$TEST_TMUX -Ltest2"
+$TMUX2 kill-server 2>/dev/null
+
+TMP1=$(mktemp)
+TMP2=$(mktemp)
+trap "rm -f $TMP1 $TMP2" 0 1 15
+
+CMD="
+printf '\033[1;31ma\033[22mb\033[2;44mc\033[1md\033[22;3me\033[23;4mf\n'
+printf '\033[4:3mg\033[4mh\033[24;7;38;5;100mi\033[27;39mj\033[49;9mk\n'
+printf '\033[38;2;1;2;3;48;2;4;5;6ml\033[39mm\033[0;91;102mn\033[31mo\n'
+printf '\033[58;5;3;4mp\033[59mq\033[53;5mr\033[55s\033[25;8mt\033[28mu\n'
+printf '\033[1;2;3;4;5;7;9mv\033[mw\033[7mx\033[27my\033[m\n'
+cat"
+$TMUX2 -f/dev/null new -d -x40 -y9 "$CMD" \; set -g status off \; \
+       set -as terminal-features '*:RGB:usstyle:overline:strikethrough' || \
+       exit 1
+$TMUX -f/dev/null start \; set -g default-terminal tmux-256color \; \
+      new -d -x40 -y9 "$TMUX2 attach" \; set -g status off || exit 1
+sleep 1
+
+$TMUX capturep -pe >$TMP1
+$TMUX2 capturep -pe >$TMP2
+cmp -s $TMP1 $TMP2 || exit 1
+
+$TMUX kill-server 2>/dev/null
+$TMUX2 kill-server 2>/dev/null
+exit 0
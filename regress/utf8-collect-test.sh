@@ -0,0 +1,67 @@
+#!/bin/sh
+
+# UTF-8 characters collected into a line must end up the same as when written
+# one at a time, both in the pane and on a terminal showing it, including one
+# with an overlay over part of the line
+
+PATH=/bin:/usr/bin
+TERM=screen
+
+[ -z "$TEST_TMUX" ] && TEST_TMUX=$(readlink -f ../tmux)
+TMUX="$TEST_TMUX -Ltest"
+$TMUX kill-server 2>/dev/null
+TMUX2="$TEST_TMUX -Ltest2"
+$TMUX2 kill-server 2>/dev/null
+
+TMP=$(mktemp)
+TMP1=$(mktemp)
+TMP2=$(mktemp)
+trap "rm -f $TMP $TMP1 $TMP2" 0 1 15
+
+LINES="
+printf '\e[H\e[J'
+printf '\e[1;1Hh\303\251llo \344\270\226\347\225\214 w\303\266rld\n'
+printf '\e[2;1H\344\270\226\347\225\214\344\270\226\347\225\214\e[2;2Hab\n'
+printf '\e[3;1H\344\270\226\347\225\214\344\270\226\347\225\214\e[3;2H\316\261\316\262\n'
+printf '\e[4;1H\344\270\226\347\225\214\344\270\226\347\225\214\e[4;4H\316\261\n'
+printf '\e[5;20H\344\270\226x\n'
+printf '\e[7;1H\342\224\214\342\224\200\342\224\200\342\224\220\e[7;2H\342\224\202\n'"
+
+# The pane as a whole.
+$TMUX -f/dev/null new -d -x20 -y10 "$LINES
+$TMUX capturep -p >>$TMP"
+sleep 1
+cmp $TMP utf8-collect-test.result || exit 1
+$TMUX has 2>/dev/null && exit 1
+
+# The same lines drawn to a client, the outer pane, as they arrive: once on
+# their own and once with a popup over columns 5 to 8 of rows 1 to 5.
+$TMUX2 -f/dev/null new -d -x20 -y10 "read x; $LINES; read x; $LINES; cat" \; \
+       set -g status off || exit 1
+$TMUX -f/dev/null new -d -x20 -y10 "$TMUX2 attach" \; \
+      set -g status off || exit 1
+sleep 1
+
+$TMUX2 send Enter || exit 1
+sleep 1
+$TMUX capturep -p >$TMP1
+$TMUX2 capturep -p >$TMP2
+cmp -s $TMP1 $TMP2 || exit 1
+
+C=$($TMUX2 lsc -F '#{client_name}')
+$TMUX2 display-popup -c$C -B -x5 -y6 -w4 -h5 'sleep 30' &
+sleep 1
+$TMUX2 send Enter || exit 1
+sleep 1
+$TMUX capturep -p >$TMP1
+
+# What the client should show: the lines with blanks where the popup is.
+$TMUX neww -d "$LINES
+printf '\e[%d;6H    ' 2 3 4 5 6
+$TMUX capturep -p -t:1 >$TMP2; cat" || exit 1
+sleep 1
+cmp -s $TMP1 $TMP2 || exit 1
+
+$TMUX kill-server 2>/dev/null
+$TMUX2 kill-server 2>/dev/null
+exit 0
@@ -8,6 +8,48 @@
 // temporary zig testing hack
 #define static
 
+/* Maximum number of key forwarding queries waiting for a reply. */
+#define REMOTE_INPUT_INFLIGHT 4
+
+/* Maximum number of bytes forwarded for one pane in one query. */
+#define REMOTE_INPUT_CHUNK 4096
+
+/* Seconds a remote pane may fall behind before the server pauses it. */
+#define REMOTE_PAUSE_AFTER 5
+
+/* Age in milliseconds after which panes in hidden windows are paused. */
+#define REMOTE_HOLD_AGE 1000
+
+/* Local backlog at which a pane is paused and below which it is resumed. */
+#define REMOTE_BACKLOG_HIGH (1024 * 1024)
+#define REMOTE_BACKLOG_LOW (64 * 1024)
+
+/* How often paused panes are checked, in milliseconds. */
+#define REMOTE_FLOW_INTERVAL 100
+
+/* History lines copied when attaching and fetched later on demand. */
+#define REMOTE_HISTORY_TAIL 100
+#define REMOTE_HISTORY_CHUNK 1000
+
+/* Maximum number of commands sent to the server and not yet answered. */
+#define REMOTE_QUERY_INFLIGHT 32
+
+/*
+ * Seconds without a reply after which outstanding queries are cancelled, and
+ * that a command may wait on the server before its query is cancelled.
+ */
+#define REMOTE_QUERY_TIMEOUT 10
+
+/* Number of recent round trip times kept for percentiles. */
+#define REMOTE_LATENCY_SAMPLES 256
+
+/*
+ * Milliseconds, on top of twice the round trip time, before a key that has
+ * not been echoed is given up on, and how often this is checked.
+ */
+#define REMOTE_PREDICT_TIMEOUT 500
+#define REMOTE_PREDICT_INTERVAL 100
+
 struct remote_query;
 typedef void (*remote_query_cb)(struct remote *, struct remote_query *);
 
@@ -17,8 +59,23 @@ struct remote_query {
 	remote_query_cb error;
 	int		arity;
 
-	TAILQ_ENTRY(remote_query) entry;
+	/* When the first command was sent. */
+	struct timeval	start;
+};
+
+/*
+ * A line of one or more commands. Lines wait until there is room to send
+ * them and replies are matched to them in order.
+ */
+struct remote_line {
+	struct remote_query *q;	/* NULL if cancelled */
+	char		    *text;
+	u_int		     n;	/* commands not yet answered */
+	struct timeval	     sent;
+
+	TAILQ_ENTRY(remote_line) entry;
 };
+TAILQ_HEAD(remote_lines, remote_line);
 
 struct remote {
 	struct window_pane *wp;
@@ -32,25 +89,166 @@ struct remote {
 
 	struct evbuffer *line_buffer;
 	struct evbuffer *reply_buffer;
+
+	/* %output being decoded straight from the input buffer. */
+	int		     out_state;
+#define REMOTE_OUTPUT_NONE 0
+#define REMOTE_OUTPUT_DATA 1
+#define REMOTE_OUTPUT_DISCARD 2
+	struct client_pane  *out_pane;
+	u_char		     out_esc[4];
+	u_int		     out_esc_len;
 	long		 reply_time;
 	u_int		 reply_number;
 
-	/* XXX: n-arity request (multiple bodies) */
-	TAILQ_HEAD(remote_quries, remote_query) queries;
+	struct event	 input_timer;
+	u_int		 input_inflight;
+
+	struct event	 flow_timer;
+
+	/* Commands waiting to be sent and sent but not answered. */
+	struct remote_lines waiting;
+	struct remote_lines sent;
+	u_int		 nwaiting;
+	u_int		 inflight;
+	struct event	 query_timer;
+	struct timeval	 last_reply;
+	long		 begin_offset;
+	int		 begin_offset_set;
+
+	/* Round trip times in microseconds. */
+	u_int		 latency;
+	u_int		 latency_avg;
+	u_int		 latency_samples[REMOTE_LATENCY_SAMPLES];
+	u_int		 nlatency;
+	u_int		 timeouts;
+
+	/* Time from a key to its echo and to it being shown, in ms. */
+	struct event	 predict_timer;
+	u_int		 echo_latency;
+	u_int		 input_latency;
+	u_int		 mispredictions;
+
+	struct remote_bootstrap_ctx *bootstrap;
+};
+
+/*
+ * A printable key sent to a pane and the cell it is expected to be echoed
+ * to. If remote-predict is on, the key is drawn there underlined until the
+ * echo arrives.
+ */
+struct remote_predict {
+	u_int		 x;
+	u_int		 y;	/* including history */
+	int		 drawn;
+	struct grid_cell gc;
+	struct grid_cell saved;
+	struct timeval	 time;
+
+	TAILQ_ENTRY(remote_predict) entry;
 };
+TAILQ_HEAD(remote_predicts, remote_predict);
 
 struct client_pane {
 	struct client_window cw;
 	struct bufferevent  *event;
 	u_int init_cx, init_cy;
 	u_int alt;
+
+	uint64_t	     age;
+	int		     flags;
+#define REMOTE_PANE_PAUSING 0x1
+#define REMOTE_PANE_PAUSED 0x2
+#define REMOTE_PANE_RESUMING 0x4
+#define REMOTE_PANE_FETCHING 0x8
+#define REMOTE_PANE_SYNCING 0x10
+#define REMOTE_PANE_NOPREDICT 0x20
+#define REMOTE_PANE_UNSURE 0x40
+
+	/*
+	 * History lines on the server above the top of ours, so the server
+	 * line at the top of ours is hmissing from the top of its history.
+	 * Lines trimmed here since are added when it is next used.
+	 */
+	u_int		     hmissing;
+	u_int		     htrimmed;
+
+	struct remote_predicts predictions;
+	struct timeval	     nopredict_time;
+};
+
+/* Control mode notifications. */
+enum remote_event_type {
+	REMOTE_EVENT_CLIENT_SESSION_CHANGED,
+	REMOTE_EVENT_CONTINUE,
+	REMOTE_EVENT_EXIT,
+	REMOTE_EVENT_EXTENDED_OUTPUT,
+	REMOTE_EVENT_LAYOUT_CHANGE,
+	REMOTE_EVENT_OUTPUT,
+	REMOTE_EVENT_PANE_MODE_CHANGED,
+	REMOTE_EVENT_PAUSE,
+	REMOTE_EVENT_SESSION_CHANGED,
+	REMOTE_EVENT_SESSION_RENAMED,
+	REMOTE_EVENT_SESSION_WINDOW_CHANGED,
+	REMOTE_EVENT_SESSIONS_CHANGED,
+	REMOTE_EVENT_SUBSCRIPTION_CHANGED,
+	REMOTE_EVENT_UNLINKED_WINDOW_ADD,
+	REMOTE_EVENT_UNLINKED_WINDOW_CLOSE,
+	REMOTE_EVENT_UNLINKED_WINDOW_RENAMED,
+	REMOTE_EVENT_WINDOW_ADD,
+	REMOTE_EVENT_WINDOW_CLOSE,
+	REMOTE_EVENT_WINDOW_PANE_CHANGED,
+	REMOTE_EVENT_WINDOW_RENAMED,
+};
+
+/*
+ * Notification table, sorted by name. The arguments are separated by single
+ * spaces and are: % @ $ for a pane, window or session ID; n for a number; w
+ * for a word; : for a literal colon; and r for the rest of the line.
+ */
+struct remote_event_entry {
+	const char	*name;
+	const char	*args;
+	int		 type;
+};
+static const struct remote_event_entry remote_event_table[] = {
+	{ "client-session-changed", "w$r",
+	  REMOTE_EVENT_CLIENT_SESSION_CHANGED },
+	{ "continue", "%", REMOTE_EVENT_CONTINUE },
+	{ "exit", "", REMOTE_EVENT_EXIT },
+	{ "extended-output", "%n:r", REMOTE_EVENT_EXTENDED_OUTPUT },
+	{ "layout-change", "@wr", REMOTE_EVENT_LAYOUT_CHANGE },
+	{ "output", "%r", REMOTE_EVENT_OUTPUT },
+	{ "pane-mode-changed", "%", REMOTE_EVENT_PANE_MODE_CHANGED },
+	{ "pause", "%", REMOTE_EVENT_PAUSE },
+	{ "session-changed", "$r", REMOTE_EVENT_SESSION_CHANGED },
+	{ "session-renamed", "$r", REMOTE_EVENT_SESSION_RENAMED },
+	{ "session-window-changed", "$@",
+	  REMOTE_EVENT_SESSION_WINDOW_CHANGED },
+	{ "sessions-changed", "", REMOTE_EVENT_SESSIONS_CHANGED },
+	{ "subscription-changed", "wr", REMOTE_EVENT_SUBSCRIPTION_CHANGED },
+	{ "unlinked-window-add", "@", REMOTE_EVENT_UNLINKED_WINDOW_ADD },
+	{ "unlinked-window-close", "@", REMOTE_EVENT_UNLINKED_WINDOW_CLOSE },
+	{ "unlinked-window-renamed", "@r",
+	  REMOTE_EVENT_UNLINKED_WINDOW_RENAMED },
+	{ "window-add", "@", REMOTE_EVENT_WINDOW_ADD },
+	{ "window-close", "@", REMOTE_EVENT_WINDOW_CLOSE },
+	{ "window-pane-changed", "@%", REMOTE_EVENT_WINDOW_PANE_CHANGED },
+	{ "window-renamed", "@r", REMOTE_EVENT_WINDOW_RENAMED },
+};
+
+/* Notification name being looked up. */
+struct remote_event_key {
+	const char	*name;
+	size_t		 len;
 };
 
-struct try_scanf_ctx {
-	const char *line;
-	size_t	    len;
-	int	    mark;
-	char	   *rest;
+/* Parsed notification arguments. */
+struct remote_event_args {
+	uint64_t	 num[3];
+	u_int		 nnum;
+	char		*word;
+	char		*rest;
 };
 
 struct remote_bootstrap_ctx {
@@ -65,6 +263,78 @@ struct remote_bootstrap_ctx {
 	struct client_window  *cw;
 };
 
+struct remote_pane_ctx {
+	struct remote_query q;
+	u_int		    pane_id;
+	int		    state;
+	u_int		    cx, cy;
+	u_int		    ny;
+	int		    full;	/* replace history as well as screen */
+};
+
+/* A kept session being brought up to date after reconnecting. */
+struct remote_resync_ctx {
+	struct remote_query q;
+	struct session	   *session;
+	int		    state;
+	u_int		    active;	/* active window ID */
+	u_int		   *ids;	/* windows on the server */
+	u_int		    nids;
+};
+
+/*
+ * A mirrored session kept after its control stream was lost, for example
+ * because ssh dropped, so it can be brought up to date rather than fetched
+ * again if the same session is attached to later.
+ */
+struct remote_orphan {
+	u_int		      session_id;
+	struct session	     *session;
+	struct client_windows windows;
+	struct client_windows panes;
+
+	TAILQ_ENTRY(remote_orphan) entry;
+};
+static TAILQ_HEAD(, remote_orphan) remote_orphans =
+    TAILQ_HEAD_INITIALIZER(remote_orphans);
+
+struct remote_window_ctx {
+	struct remote_query q;
+	u_int		    window_id;
+};
+
+/* Fields of REMOTE_RESYNC_FORMAT. */
+struct remote_resync_info {
+	u_int		 pane_id, hsize, hlimit;
+	const char	*checksum;
+};
+
+#define REMOTE_RESYNC_FORMAT \
+	"#{pane_id}\t"		\
+	"#{history_size}\t"	\
+	"#{history_limit}\t"	\
+	"#{pane_checksum}"
+
+/* Fields of REMOTE_PANE_FORMAT. */
+struct remote_pane_info {
+	u_int	window_id, window_index, sx, sy;
+	u_int	pane_id, pane_index, active, cx, cy;
+	u_int	hlimit, hsize;
+};
+
+#define REMOTE_PANE_FORMAT \
+	"#{window_id}\t"	\
+	"#{window_index}\t"	\
+	"#{window_width}\t"	\
+	"#{window_height}\t"	\
+	"#{pane_id}\t"		\
+	"#{pane_index}\t"	\
+	"#{pane_active}\t"	\
+	"#{cursor_x}\t"		\
+	"#{cursor_y}\t"		\
+	"#{history_limit}\t"	\
+	"#{history_size}"
+
 struct remote_input_ctx {
 	struct remote	   *r;
 	struct bufferevent *event;
@@ -72,25 +342,61 @@ struct remote_input_ctx {
 };
 
 /* Helper functions. */
-static int scanflike(3, 0) try_sscanf(struct try_scanf_ctx *, int, const char *, ...);
 static void printflike(2, 0) remote_log(struct remote *, const char *, ...);
 static size_t	 output_unescape(const char *, char *);
 static int	 evbuffer_remove_line(struct evbuffer *, struct evbuffer *);
 static char	*evbuffer_peek_string(struct evbuffer *, size_t *);
 
 static void	 remote_input(struct bufferevent *, void *);
+static void	 remote_input_schedule(struct remote *);
+static void	 remote_input_timer(int, short, void *);
+static void	 remote_input_done(struct remote *, struct remote_query *);
+static void	 remote_predict(struct remote *, struct client_pane *,
+		     const u_char *, size_t);
+static void	 remote_predict_check(struct remote *, struct client_pane *);
+static void	 remote_predict_free(struct client_pane *);
+static void	 remote_predict_timer(int, short, void *);
+static struct client_pane *remote_find_pane(struct remote *, u_int);
+static void	 remote_flow_schedule(struct remote *, int);
+static void	 remote_flow_timer(int, short, void *);
 static void	 remote_read_callback(struct bufferevent *, void *);
 static void	 remote_read_line(struct remote *, struct evbuffer *);
+static int	 remote_read_output_header(struct remote *, struct evbuffer *);
+static int	 remote_read_output(struct remote *, struct evbuffer *);
+static void	 remote_pane_written(struct remote *, struct client_pane *);
 static struct remote_query *printflike(3, 0)
     remote_run(struct remote *, struct remote_query *, const char *, ...);
+static void printflike(3, 4)
+    remote_run_latest(struct remote *, const char *, const char *, ...);
+static void	remote_send(struct remote *);
+static void	remote_query_schedule(struct remote *);
+static void	remote_query_timer(int, short, void *);
+static void	remote_cancel(struct remote *, struct remote_query *);
+static void	remote_update_latency(struct remote *, struct timeval *);
+static void	remote_query_finished(struct remote *, struct remote_query *);
 static void	remote_bootstrap_next(struct remote *, struct remote_query *);
+static void	remote_sync_window(struct remote *, u_int);
+static void	remote_sync_pane(struct remote *, struct client_pane *, u_int,
+		    int);
+static void	remote_orphan(struct remote *);
+static int	remote_adopt(struct remote *, u_int, const char *);
+static void	remote_resync_next(struct remote *, struct remote_query *);
+static void	remote_resync_error(struct remote *, struct remote_query *);
+static int	remote_apply_layout(struct remote *, struct window *,
+		    const char *);
 
 /* Protocol handlers. */
 static void	remote_begin_reply(struct remote *, u_char *);
+static void	remote_begin_check(struct remote *, long);
 static void	remote_dispatch_reply(struct remote *, u_char *, int);
+static int	remote_event_compare(const void *, const void *);
+static int	remote_parse_event(const struct remote_event_entry *, char *,
+		    size_t, size_t, struct remote_event_args *);
 static void	remote_dispatch_event(struct remote *, u_char *, size_t len);
 static void	remote_output(struct remote *, u_int, char *);
 static void	remote_extended_output(struct remote *, u_int, uint64_t, char *);
+static void	remote_pause(struct remote *, u_int);
+static void	remote_continue(struct remote *, u_int);
 static void	remote_pane_mode_changed(struct remote *, u_int);
 static void	remote_session_changed(struct remote *, u_int, char *);
 static void	remote_window_renamed(struct remote *, u_int, char *);
@@ -98,6 +404,8 @@ static void	remote_unlinked_window_renamed(struct remote *, u_int, char *);
 static void	remote_session_renamed(struct remote *, u_int, char *);
 static void	remote_client_session_changed(struct remote *, char *, u_int, char *);
 static void	remote_window_pane_changed(struct remote *, u_int, u_int);
+static void	remote_layout_change(struct remote *, u_int, char *);
+static void	remote_subscription_changed(struct remote *, char *, char *);
 static void	remote_window_close(struct remote *, u_int);
 static void	remote_unlinked_window_close(struct remote *, u_int);
 static void	remote_window_add(struct remote *, u_int);
@@ -119,38 +427,274 @@ remote_log(struct remote *r, const char *fmt, ...)
 struct remote *
 remote_create(struct bufferevent *bev, struct window_pane *wp)
 {
-	struct remote  *r;
+	struct remote	    *r;
+	struct remote_query *q;
 
 	r = xcalloc(1, sizeof *r);
 	r->line_buffer = evbuffer_new();
 	r->reply_buffer = evbuffer_new();
 	r->wp = wp;
 	r->event = bev;
-	TAILQ_INIT(&r->queries);
+	TAILQ_INIT(&r->waiting);
+	TAILQ_INIT(&r->sent);
+	evtimer_set(&r->input_timer, remote_input_timer, r);
+	evtimer_set(&r->flow_timer, remote_flow_timer, r);
+	evtimer_set(&r->query_timer, remote_query_timer, r);
+	evtimer_set(&r->predict_timer, remote_predict_timer, r);
 
 	bufferevent_setcb(bev, remote_read_callback, NULL, NULL, r);
 
 	remote_log(r, "** enter tmux control mode **");
 
+	/* Ask for %extended-output and %pause rather than being dropped. */
+	q = xcalloc(1, sizeof *q);
+	q->command = "refresh-client";
+	remote_run(r, q, "refresh-client -f pause-after=%u\n",
+	    REMOTE_PAUSE_AFTER);
+
 	return (r);
 }
 
+/*
+ * Queue a command for a query. Commands ending with ; are joined with the
+ * next one for the same query into a single line. Complete lines are sent
+ * once there is room.
+ */
 static struct remote_query*
 remote_run(struct remote *r, struct remote_query* q, const char *fmt, ...)
 {
-	va_list ap;
+	struct remote_line	*rl;
+	va_list			 ap;
+	char			*text, *joined;
+	size_t			 len;
+
+	va_start(ap, fmt);
+	xvasprintf(&text, fmt, ap);
+	va_end(ap);
 
-	if (TAILQ_LAST(&r->queries, remote_quries) != q)
-		TAILQ_INSERT_TAIL(&r->queries, q, entry);
+	log_debug("%s: %s: %s", __func__, q->command, text);
+
+	rl = TAILQ_LAST(&r->waiting, remote_lines);
+	len = (rl == NULL) ? 0 : strlen(rl->text);
+	if (rl != NULL && rl->q == q && len != 0 && rl->text[len - 1] != '\n') {
+		xasprintf(&joined, "%s%s", rl->text, text);
+		free(rl->text);
+		free(text);
+		rl->text = joined;
+	} else {
+		rl = xcalloc(1, sizeof *rl);
+		rl->q = q;
+		rl->text = text;
+		TAILQ_INSERT_TAIL(&r->waiting, rl, entry);
+	}
+	rl->n++;
 	q->arity++;
+	r->nwaiting++;
+
+	remote_send(r);
+	return q;
+}
 
-	log_debug("%s: %s: %s", __func__, q->command, fmt);
+/*
+ * Queue a command that replaces any waiting command for the same kind of
+ * query. Used where only the latest request matters, such as selecting a
+ * pane or window.
+ */
+static void printflike(3, 4)
+remote_run_latest(struct remote *r, const char *command, const char *fmt, ...)
+{
+	struct remote_query	*q;
+	struct remote_line	*rl;
+	va_list			 ap;
+	char			*text;
+
+	TAILQ_FOREACH(rl, &r->waiting, entry) {
+		q = rl->q;
+		if (q != NULL && q->arity == 1 && strcmp(q->command,
+		    command) == 0)
+			break;
+	}
+	if (rl != NULL) {
+		log_debug("%s: %s: replacing %s", __func__, command, rl->text);
+		free(rl->text);
+		va_start(ap, fmt);
+		xvasprintf(&rl->text, fmt, ap);
+		va_end(ap);
+		return;
+	}
 
+	q = xcalloc(1, sizeof *q);
+	q->command = command;
 	va_start(ap, fmt);
-	evbuffer_add_vprintf(r->event->output, fmt, ap);
+	xvasprintf(&text, fmt, ap);
 	va_end(ap);
+	remote_run(r, q, "%s", text);
+	free(text);
+}
 
-	return q;
+/*
+ * Send waiting lines while fewer than REMOTE_QUERY_INFLIGHT commands are
+ * outstanding. A line is always sent if nothing else is, so a query with
+ * more commands than the limit still goes out.
+ */
+static void
+remote_send(struct remote *r)
+{
+	struct remote_line	*rl;
+	struct remote_query	*q;
+	size_t			 len;
+
+	while ((rl = TAILQ_FIRST(&r->waiting)) != NULL) {
+		len = strlen(rl->text);
+		if (len == 0 || rl->text[len - 1] != '\n')
+			break;
+		if (r->inflight != 0 &&
+		    r->inflight + rl->n > REMOTE_QUERY_INFLIGHT)
+			break;
+
+		TAILQ_REMOVE(&r->waiting, rl, entry);
+		r->nwaiting -= rl->n;
+		r->inflight += rl->n;
+
+		gettimeofday(&rl->sent, NULL);
+		q = rl->q;
+		if (q != NULL && !timerisset(&q->start))
+			q->start = rl->sent;
+		if (TAILQ_EMPTY(&r->sent))
+			r->last_reply = rl->sent;
+		TAILQ_INSERT_TAIL(&r->sent, rl, entry);
+
+		evbuffer_add(r->event->output, rl->text, len);
+		free(rl->text);
+		rl->text = NULL;
+	}
+
+	if (!TAILQ_EMPTY(&r->sent) && !evtimer_pending(&r->query_timer, NULL))
+		remote_query_schedule(r);
+}
+
+static void
+remote_query_schedule(struct remote *r)
+{
+	struct timeval	tv = { .tv_sec = REMOTE_QUERY_TIMEOUT, .tv_usec = 0 };
+
+	evtimer_add(&r->query_timer, &tv);
+}
+
+/*
+ * Report the remaining commands of a query as failed. Replies to commands
+ * already sent are still read but discarded.
+ */
+static void
+remote_cancel(struct remote *r, struct remote_query *q)
+{
+	struct remote_line	*rl, *rl1;
+	u_int			 n = 0;
+
+	log_debug("%s: %s", __func__, q->command);
+
+	TAILQ_FOREACH_SAFE(rl, &r->waiting, entry, rl1) {
+		if (rl->q != q)
+			continue;
+		n += rl->n;
+		r->nwaiting -= rl->n;
+		TAILQ_REMOVE(&r->waiting, rl, entry);
+		free(rl->text);
+		free(rl);
+	}
+	TAILQ_FOREACH(rl, &r->sent, entry) {
+		if (rl->q == q) {
+			n += rl->n;
+			rl->q = NULL;
+		}
+	}
+
+	evbuffer_drain(r->reply_buffer, EV_SIZE_MAX);
+	while (n-- != 0) {
+		if (q->error != NULL)
+			q->error(r, q);
+		if (--q->arity == 0) {
+			free(q);
+			break;
+		}
+	}
+}
+
+/* Cancel everything if the server has not replied for too long. */
+static void
+remote_query_timer(__unused int fd, __unused short events, void *data)
+{
+	struct remote		*r = data;
+	struct remote_line	*rl;
+	struct remote_query	*q;
+	struct timeval		 now, tv;
+
+	if (TAILQ_EMPTY(&r->sent))
+		return;
+
+	gettimeofday(&now, NULL);
+	timersub(&now, &r->last_reply, &tv);
+	if (tv.tv_sec < REMOTE_QUERY_TIMEOUT) {
+		remote_query_schedule(r);
+		return;
+	}
+
+	remote_log(r, "no reply for %lld seconds, cancelling %u commands",
+	    (long long)tv.tv_sec, r->inflight + r->nwaiting);
+	r->timeouts++;
+
+	for (;;) {
+		q = NULL;
+		TAILQ_FOREACH(rl, &r->sent, entry) {
+			if ((q = rl->q) != NULL)
+				break;
+		}
+		if (q == NULL && (rl = TAILQ_FIRST(&r->waiting)) != NULL)
+			q = rl->q;
+		if (q == NULL)
+			break;
+		remote_cancel(r, q);
+	}
+	r->last_reply = now;
+	remote_query_schedule(r);
+}
+
+/* Number of commands waiting or sent and not answered. */
+u_int
+remote_queued(struct remote *r)
+{
+	return (r->nwaiting + r->inflight);
+}
+
+/* Smoothed round trip time in microseconds. */
+u_int
+remote_latency(struct remote *r)
+{
+	return (r->latency_avg);
+}
+
+static int
+remote_latency_cmp(const void *a, const void *b)
+{
+	u_int	ua = *(const u_int *)a, ub = *(const u_int *)b;
+
+	return (ua < ub ? -1 : (ua > ub));
+}
+
+/* Percentile of recent round trip times in microseconds. */
+u_int
+remote_latency_percentile(struct remote *r, u_int pct)
+{
+	u_int	sorted[REMOTE_LATENCY_SAMPLES], n;
+
+	n = r->nlatency;
+	if (n > REMOTE_LATENCY_SAMPLES)
+		n = REMOTE_LATENCY_SAMPLES;
+	if (n == 0)
+		return (0);
+	memcpy(sorted, r->latency_samples, n * sizeof *sorted);
+	qsort(sorted, n, sizeof *sorted, remote_latency_cmp);
+	return (sorted[(n - 1) * pct / 100]);
 }
 
 /* Move line from an evbuffer into another evbuffer, draining
@@ -199,14 +743,203 @@ remote_read_callback(struct bufferevent *bev, void *data)
 	struct evbuffer *input = bufferevent_get_input(bev);
 	struct evbuffer *line = r->line_buffer;
 
-	/* read stream line-by-line */
-	while (evbuffer_remove_line(input, line)) {
+	/*
+	 * Pane output is decoded as it arrives, everything else is read
+	 * line-by-line. Incomplete lines are left in the input buffer.
+	 */
+	for (;;) {
+		if (r->out_state != REMOTE_OUTPUT_NONE) {
+			if (!remote_read_output(r, input))
+				break;
+			continue;
+		}
+		if (r->reply_number == 0 &&
+		    remote_read_output_header(r, input))
+			continue;
+		if (!evbuffer_remove_line(input, line))
+			break;
 		remote_read_line(r, line);
 		evbuffer_drain(line, EV_SIZE_MAX);
 	}
+}
+
+/* Parse a decimal number. */
+static int
+remote_match_number(const char *buf, size_t len, size_t *off,
+    uint64_t *value)
+{
+	size_t	start = *off;
+
+	*value = 0;
+	while (*off < len && buf[*off] >= '0' && buf[*off] <= '9')
+		*value = *value * 10 + (buf[(*off)++] - '0');
+	return (*off != start);
+}
+
+/*
+ * Look for a %output or %extended-output header at the start of the input
+ * and, if found, drain it and start decoding into the pane. Anything else,
+ * including a header that has not arrived in full, is left to be read as a
+ * line.
+ */
+static int
+remote_read_output_header(struct remote *r, struct evbuffer *input)
+{
+	struct client_pane	*cp;
+	char			 buf[64];
+	ev_ssize_t		 n;
+	size_t			 len, off;
+	uint64_t		 pane, age = 0;
+	int			 extended;
+
+	if ((n = evbuffer_copyout(input, buf, sizeof buf)) <= 0)
+		return (0);
+	len = n;
+
+	if (len > 9 && memcmp(buf, "%output %", 9) == 0) {
+		extended = 0;
+		off = 9;
+	} else if (len > 18 && memcmp(buf, "%extended-output %", 18) == 0) {
+		extended = 1;
+		off = 18;
+	} else
+		return (0);
+
+	if (!remote_match_number(buf, len, &off, &pane))
+		return (0);
+	if (off == len || buf[off++] != ' ')
+		return (0);
+	if (extended) {
+		if (!remote_match_number(buf, len, &off, &age))
+			return (0);
+		if (len - off < 3 || memcmp(buf + off, " : ", 3) != 0)
+			return (0);
+		off += 3;
+	}
+	evbuffer_drain(input, off);
+
+	if ((cp = remote_find_pane(r, pane)) == NULL) {
+		remote_log(r, "%s: no such pane: %llu", __func__,
+		    (unsigned long long)pane);
+		r->out_state = REMOTE_OUTPUT_DISCARD;
+		return (1);
+	}
+	if (cp->flags & REMOTE_PANE_SYNCING) {
+		r->out_state = REMOTE_OUTPUT_DISCARD;
+		return (1);
+	}
+	if (extended)
+		cp->age = age;
+	r->out_pane = cp;
+	r->out_state = REMOTE_OUTPUT_DATA;
+	return (1);
+}
+
+/*
+ * Decode %output data from the input buffer into the pane until the end of
+ * the line. Escapes may be split between reads so partial ones are kept in
+ * out_esc. Returns 1 at the end of the line and 0 if the input ran out.
+ */
+static int
+remote_read_output(struct remote *r, struct evbuffer *input)
+{
+	struct client_pane	*cp = r->out_pane;
+	struct evbuffer		*dst = NULL;
+	struct evbuffer_iovec	 in, out;
+	const u_char		*src;
+	u_char			*p = NULL, *esc = r->out_esc, ch;
+	size_t			 i, j;
+	int			 done = 0;
+
+	if (r->out_state == REMOTE_OUTPUT_DATA)
+		dst = cp->event->output;
+
+	while (!done && evbuffer_peek(input, -1, NULL, &in, 1) > 0) {
+		src = in.iov_base;
+		if (dst != NULL) {
+			if (evbuffer_reserve_space(dst, in.iov_len + 4, &out,
+			    1) != 1)
+				fatalx("out of memory");
+			p = out.iov_base;
+		}
+
+		i = 0;
+		while (i < in.iov_len) {
+			/* Copy plain bytes up to the next one that matters. */
+			if (r->out_esc_len == 0) {
+				for (j = i; j < in.iov_len; j++) {
+					ch = src[j];
+					if (ch == '\\' || ch == '\n' || ch == '\r')
+						break;
+				}
+				if (dst != NULL) {
+					memcpy(p, src + i, j - i);
+					p += j - i;
+				}
+				if ((i = j) == in.iov_len)
+					break;
+			}
+
+			ch = src[i++];
+			if (ch == '\n') {
+				done = 1;
+				break;
+			}
+			if (dst == NULL || ch == '\r')
+				continue;
+
+			if (r->out_esc_len == 0) {
+				esc[r->out_esc_len++] = ch;
+				continue;
+			}
+			if (r->out_esc_len == 1 && ch == '\\') {
+				*p++ = '\\';
+				r->out_esc_len = 0;
+				continue;
+			}
+			if ((ch & ~7) == '0') {
+				esc[r->out_esc_len++] = ch;
+				if (r->out_esc_len != 4)
+					continue;
+				if (esc[1] <= '3') {
+					*p++ = (esc[1] & 7) << 6 |
+					    (esc[2] & 7) << 3 | (esc[3] & 7);
+				} else {
+					memcpy(p, esc, 4);
+					p += 4;
+				}
+				r->out_esc_len = 0;
+				continue;
+			}
+
+			/* Not an escape, keep it and look at ch again. */
+			memcpy(p, esc, r->out_esc_len);
+			p += r->out_esc_len;
+			r->out_esc_len = 0;
+			i--;
+		}
+
+		if (dst != NULL) {
+			if (done && r->out_esc_len != 0) {
+				memcpy(p, esc, r->out_esc_len);
+				p += r->out_esc_len;
+			}
+			out.iov_len = p - (u_char *)out.iov_base;
+			evbuffer_commit_space(dst, &out, 1);
+		}
+		evbuffer_drain(input, i);
+	}
+	if (!done)
+		return (0);
 
-	/* collect incomplete line, resetting bev high watermark */
-	bufferevent_read_buffer(bev, line);
+	r->out_state = REMOTE_OUTPUT_NONE;
+	r->out_pane = NULL;
+	r->out_esc_len = 0;
+	if (dst != NULL) {
+		bufferevent_flush(cp->event, EV_WRITE, BEV_FLUSH);
+		remote_pane_written(r, cp);
+	}
+	return (1);
 }
 
 static void
@@ -251,12 +984,50 @@ remote_begin_reply(struct remote *r, u_char *line)
 	log_debug("%s: %u %lu", __func__, number, time);
 	r->reply_number = number;
 	r->reply_time = time;
+
+	/* The server is making progress, so it has not stalled. */
+	gettimeofday(&r->last_reply, NULL);
+
+	if (flags & 1)
+		remote_begin_check(r, time);
+}
+
+/*
+ * Check when the server started the oldest command sent against when it was
+ * sent. The clocks may differ, so the smallest difference seen is taken as
+ * the offset between them. A command which waited REMOTE_QUERY_TIMEOUT
+ * seconds more than that has timed out: its query is cancelled and the reply
+ * discarded.
+ */
+static void
+remote_begin_check(struct remote *r, long time)
+{
+	struct remote_line	*rl;
+	long			 offset, delay;
+
+	if ((rl = TAILQ_FIRST(&r->sent)) == NULL)
+		return;
+
+	offset = time - (long)rl->sent.tv_sec;
+	if (!r->begin_offset_set || offset < r->begin_offset) {
+		r->begin_offset = offset;
+		r->begin_offset_set = 1;
+	}
+	delay = offset - r->begin_offset;
+	if (delay < REMOTE_QUERY_TIMEOUT || rl->q == NULL)
+		return;
+
+	remote_log(r, "command started after %ld seconds, cancelling %s",
+	    delay, rl->q->command);
+	r->timeouts++;
+	remote_cancel(r, rl->q);
 }
 
 static void
 remote_dispatch_reply(struct remote *r, u_char *footer, int error)
 {
 	struct remote_query *q;
+	struct remote_line  *rl;
 	remote_query_cb	     complete;
 	long		     time;
 	u_int		     number, flags;
@@ -274,127 +1045,225 @@ remote_dispatch_reply(struct remote *r, u_char *footer, int error)
 	log_debug("%s: %u %lu %u", __func__, number, time, flags);
 
 	if (flags & 1) /* client-originated command */ {
-		q = TAILQ_FIRST(&r->queries);
-		if (q == NULL) {
+		rl = TAILQ_FIRST(&r->sent);
+		if (rl == NULL) {
 			remote_log(r, "error: no requests pending");
+			evbuffer_drain(r->reply_buffer, EV_SIZE_MAX);
 			return;
 		}
+		q = rl->q;
+		remote_update_latency(r, &rl->sent);
 
-		complete = error ? q->error : q->done;
-		if (complete)
-			complete(r, q);
+		r->inflight--;
+		if (--rl->n == 0) {
+			TAILQ_REMOVE(&r->sent, rl, entry);
+			free(rl);
+		}
 
-		if (--q->arity == 0) {
-			TAILQ_REMOVE(&r->queries, q, entry);
-			free(q);
+		if (q != NULL) {
+			complete = error ? q->error : q->done;
+			if (complete)
+				complete(r, q);
+
+			if (--q->arity == 0) {
+				remote_query_finished(r, q);
+				free(q);
+			}
 		}
+
+		remote_send(r);
+		bufferevent_flush(r->event, EV_WRITE, BEV_FLUSH);
 	}
 
 	evbuffer_drain(r->reply_buffer, EV_SIZE_MAX);
 }
 
+/* Record the round trip time of a command sent at the given time. */
+static void
+remote_update_latency(struct remote *r, struct timeval *sent)
+{
+	struct timeval	now, tv;
+	u_int		us;
+
+	gettimeofday(&now, NULL);
+	r->last_reply = now;
+
+	timersub(&now, sent, &tv);
+	us = tv.tv_sec * 1000000 + tv.tv_usec;
+	r->latency = us;
+	r->latency_samples[r->nlatency++ % REMOTE_LATENCY_SAMPLES] = us;
+	if (r->latency_avg == 0)
+		r->latency_avg = us;
+	else
+		r->latency_avg = (7 * (uint64_t)r->latency_avg + us) / 8;
+}
+
+static void
+remote_query_finished(struct remote *r, struct remote_query *q)
+{
+	struct timeval	now, tv;
+
+	gettimeofday(&now, NULL);
+	timersub(&now, &q->start, &tv);
+	log_debug("%s: %s: %lld ms (%u queued, last %u ms)", __func__,
+	    q->command, (long long)tv.tv_sec * 1000 + tv.tv_usec / 1000,
+	    remote_queued(r), r->latency / 1000);
+}
+
 static int
-try_sscanf(struct try_scanf_ctx *ctx, int args, const char *fmt, ...)
+remote_event_compare(const void *key, const void *value)
 {
-	va_list ap;
-	int n;
+	const struct remote_event_key	*k = key;
+	const struct remote_event_entry	*entry = value;
+	int				 n;
 
-	va_start(ap, fmt);
-	n = vsscanf(ctx->line, fmt, ap);
-	va_end(ap);
+	if ((n = strncmp(k->name, entry->name, k->len)) != 0)
+		return (n);
+	return (entry->name[k->len] == '\0' ? 0 : -1);
+}
 
-	if (ctx->mark > 0) {
-		ctx->rest =
-		    xstrndup(ctx->line + ctx->mark, ctx->len - ctx->mark);
-		++n;
+/*
+ * Split the arguments of a notification as described by its table entry.
+ * Anything left over at the end is ignored.
+ */
+static int
+remote_parse_event(const struct remote_event_entry *entry, char *line,
+    size_t len, size_t off, struct remote_event_args *args)
+{
+	const char	*spec;
+	size_t		 end = 0;
+
+	memset(args, 0, sizeof *args);
+	for (spec = entry->args; *spec != '\0'; spec++) {
+		if (off == len || line[off++] != ' ')
+			return (0);
+		switch (*spec) {
+		case '%':
+		case '@':
+		case '$':
+			if (off == len || line[off++] != *spec)
+				return (0);
+			/* FALLTHROUGH */
+		case 'n':
+			if (args->nnum == nitems(args->num))
+				return (0);
+			if (!remote_match_number(line, len, &off,
+			    &args->num[args->nnum++]))
+				return (0);
+			break;
+		case ':':
+			if (off == len || line[off++] != ':')
+				return (0);
+			break;
+		case 'w':
+			args->word = line + off;
+			while (off < len && line[off] != ' ')
+				off++;
+			if (line + off == args->word)
+				return (0);
+			end = off;
+			break;
+		case 'r':
+			args->rest = line + off;
+			off = len;
+			break;
+		}
 	}
 
-	if (n == args)
-		return (1);
-	return (0);
+	/* Terminate the word now that nothing else needs the space. */
+	if (args->word != NULL)
+		line[end] = '\0';
+	return (1);
 }
 
 static void
 remote_dispatch_event(struct remote *r, u_char *line, size_t len)
 {
-	struct try_scanf_ctx ss = {
-	    .line = line,
-	    .len = len,
-	    .mark = -1,
-	    .rest = NULL,
-	};
-	char		  *client = NULL;
-	u_int		   session;
-	u_int		   pane;
-	u_int		   window;
-	unsigned long long age;
-
-	/* %output %pane data */
-	if (try_sscanf(&ss, 2, "%%output%*1[ ]%%%u%*1[ ]%n", &pane, &ss.mark))
-		remote_output(r, pane, ss.rest);
-	/* %extended-output %pane age : data */
-	else if (try_sscanf(&ss, 3,
-		     "%%extended-output%*1[ ]%%%u%*1[ ]%llu%*1[ ]:%*1[ ]%n",
-		     &pane, &age, &ss.mark))
-		remote_extended_output(r, pane, age, ss.rest);
-	/* %session-changed $session session-name */
-	else if (try_sscanf(&ss, 2, "%%session-changed%*1[ ]$%u%*1[ ]%n",
-		     &session, &ss.mark))
-		remote_session_changed(r, session, ss.rest);
-	/* %pane-mode-changed %pane */
-	else if (try_sscanf(&ss, 1, "%%pane-mode-changed%*1[ ]%%%u", &pane))
-		remote_pane_mode_changed(r, pane);
-	/* %window-renamed @window new-name */
-	else if (try_sscanf(&ss, 2, "%%window-renamed%*1[ ]@%u%*1[ ]%n",
-		     &window, &ss.mark))
-		remote_window_renamed(r, window, ss.rest);
-	/* %unlinked-window-renamed @window new-name */
-	else if (try_sscanf(&ss, 2,
-		     "%%unlinked-window-renamed%*1[ ]@%u%*1[ ]%n", &window,
-		     &ss.mark))
-		remote_unlinked_window_renamed(r, window, ss.rest);
-	/* %session-renamed $session new-nam */
-	else if (try_sscanf(&ss, 2, "%%session-renamed%*1[ ]$%u%*1[ ]%n",
-		     &session, &ss.mark))
-		remote_session_renamed(r, session, ss.rest);
-	/* %client-session-changed pty $session session-name */
-	else if (try_sscanf(&ss, 3,
-		     "%%client-session-changed%*1[ ]%63ms $%u%*1[ ]%n", &client,
-		     &session, &ss.mark))
-		remote_client_session_changed(r, client, session, ss.rest);
-	/* %window-pane-changed @window %pane */
-	else if (try_sscanf(&ss, 2, "%%window-pane-changed%*1[ ]@%u%*1[ ]%%%u",
-		     &window, &pane))
-		remote_window_pane_changed(r, window, pane);
-	/* %window-close @window */
-	else if (try_sscanf(&ss, 1, "%%window-close%*1[ ]@%u", &window))
-		remote_window_close(r, window);
-	/* %unlinked-window-close @window */
-	else if (try_sscanf(
-		     &ss, 1, "%%unlinked-window-close%*1[ ]@%u", &window))
-		remote_unlinked_window_close(r, window);
-	/* %window-add @window */
-	else if (try_sscanf(&ss, 1, "%%window-add%*1[ ]@%u", &window))
-		remote_window_add(r, window);
-	/* %unlinked-window-add @window */
-	else if (try_sscanf(&ss, 1, "%%unlinked-window-add%*1[ ]@%u", &window))
-		remote_unlinked_window_add(r, window);
-	/* %session-window-changed $session @window */
-	else if (try_sscanf(&ss, 2,
-		     "%%session-window-changed%*1[ ]$%u%*1[ ]@%u", &session,
-		     &window))
-		remote_session_window_changed(r, session, window);
-	/* %sessions-changed */
-	else if (strncmp(line, "%sessions-changed", 17) == 0)
+	struct remote_event_key		 key;
+	const struct remote_event_entry	*entry;
+	struct remote_event_args	 args;
+	char				*name = line + 1, *end;
+	uint64_t			*num = args.num;
+
+	if ((end = memchr(name, ' ', len - 1)) == NULL)
+		end = line + len;
+	key.name = name;
+	key.len = end - name;
+
+	entry = bsearch(&key, remote_event_table, nitems(remote_event_table),
+	    sizeof remote_event_table[0], remote_event_compare);
+	if (entry == NULL) {
+		log_debug("%s: unknown: %.*s", __func__, (int)key.len, name);
+		return;
+	}
+	if (!remote_parse_event(entry, line, len, end - (char *)line, &args)) {
+		remote_log(r, "%s: protocol error: bad arguments: %s",
+		    __func__, line);
+		return;
+	}
+
+	switch (entry->type) {
+	case REMOTE_EVENT_OUTPUT:
+		remote_output(r, num[0], args.rest);
+		break;
+	case REMOTE_EVENT_EXTENDED_OUTPUT:
+		remote_extended_output(r, num[0], num[1], args.rest);
+		break;
+	case REMOTE_EVENT_SESSION_CHANGED:
+		remote_session_changed(r, num[0], args.rest);
+		break;
+	case REMOTE_EVENT_PANE_MODE_CHANGED:
+		remote_pane_mode_changed(r, num[0]);
+		break;
+	case REMOTE_EVENT_WINDOW_RENAMED:
+		remote_window_renamed(r, num[0], args.rest);
+		break;
+	case REMOTE_EVENT_UNLINKED_WINDOW_RENAMED:
+		remote_unlinked_window_renamed(r, num[0], args.rest);
+		break;
+	case REMOTE_EVENT_SESSION_RENAMED:
+		remote_session_renamed(r, num[0], args.rest);
+		break;
+	case REMOTE_EVENT_CLIENT_SESSION_CHANGED:
+		remote_client_session_changed(r, args.word, num[0], args.rest);
+		break;
+	case REMOTE_EVENT_WINDOW_PANE_CHANGED:
+		remote_window_pane_changed(r, num[0], num[1]);
+		break;
+	case REMOTE_EVENT_WINDOW_CLOSE:
+		remote_window_close(r, num[0]);
+		break;
+	case REMOTE_EVENT_UNLINKED_WINDOW_CLOSE:
+		remote_unlinked_window_close(r, num[0]);
+		break;
+	case REMOTE_EVENT_WINDOW_ADD:
+		remote_window_add(r, num[0]);
+		break;
+	case REMOTE_EVENT_UNLINKED_WINDOW_ADD:
+		remote_unlinked_window_add(r, num[0]);
+		break;
+	case REMOTE_EVENT_SESSION_WINDOW_CHANGED:
+		remote_session_window_changed(r, num[0], num[1]);
+		break;
+	case REMOTE_EVENT_LAYOUT_CHANGE:
+		remote_layout_change(r, num[0], args.word);
+		break;
+	case REMOTE_EVENT_PAUSE:
+		remote_pause(r, num[0]);
+		break;
+	case REMOTE_EVENT_CONTINUE:
+		remote_continue(r, num[0]);
+		break;
+	case REMOTE_EVENT_SUBSCRIPTION_CHANGED:
+		remote_subscription_changed(r, args.word, args.rest);
+		break;
+	case REMOTE_EVENT_SESSIONS_CHANGED:
 		remote_sessions_changed(r);
-	else if (strncmp(line, "%exit", 5) == 0)
+		break;
+	case REMOTE_EVENT_EXIT:
 		remote_exit(r);
-
-	/* TODO: %subscription-changed */
-	/* TODO: %pause */
-
-	free(ss.rest);
-	free(client);
+		break;
+	}
 }
 
 static size_t
@@ -433,44 +1302,734 @@ output_unescape(const char *in, char *out)
 	return len;
 }
 
-static void
-remote_output(struct remote *r, u_int pane_id, char *data)
+static struct client_pane *
+remote_find_pane(struct remote *r, u_int pane_id)
 {
-	struct client_window *cw = RB_FIND(client_windows, &r->panes,
+	struct client_window *cw;
+
+	cw = RB_FIND(client_windows, &r->panes,
 	    &(struct client_window){ .window = pane_id });
-	struct client_pane   *cp =
-	      cw ? container_of(cw, struct client_pane, cw) : NULL;
-	size_t		      len;
+	if (cw == NULL || cw->pane == NULL)
+		return (NULL);
+	return (container_of(cw, struct client_pane, cw));
+}
 
-	if (cp == NULL) {
-		remote_log(r, "%s: no such pane: %u", __func__, pane_id);
-		return;
-	}
+/*
+ * Return the number of history lines above ours on the server. Lines trimmed
+ * from the top of ours by the limits are on the server still, so they are
+ * missing now.
+ */
+static u_int
+remote_pane_missing(struct client_pane *cp)
+{
+	struct grid	*gd = cp->cw.pane->base.grid;
 
-	len = output_unescape(data, data);
-	bufferevent_write(cp->event, data, len);
-	bufferevent_flush(cp->event, EV_WRITE, BEV_FLUSH);
+	cp->hmissing += gd->htrimmed - cp->htrimmed;
+	cp->htrimmed = gd->htrimmed;
+	return (cp->hmissing);
 }
 
-static void
-remote_input(struct bufferevent *kev, void *ctx)
+/* Bytes written to a pane but not yet consumed locally. */
+static size_t
+remote_pane_backlog(struct client_pane *cp)
+{
+	struct window_pane *wp = cp->cw.pane;
+
+	return (EVBUFFER_LENGTH(cp->event->output) +
+	    EVBUFFER_LENGTH(wp->event->input));
+}
+
+static int
+remote_pane_visible(struct remote *r, struct client_pane *cp)
+{
+	struct session *s = r->session;
+
+	if (s == NULL || s->curw == NULL)
+		return (1);
+	return (cp->cw.pane->window == s->curw->window);
+}
+
+static void
+remote_pause_done(struct remote *r, struct remote_query *q)
+{
+	struct remote_pane_ctx *ctx = (struct remote_pane_ctx *)q;
+	struct client_pane     *cp;
+
+	if ((cp = remote_find_pane(r, ctx->pane_id)) == NULL)
+		return;
+
+	/* The %pause line is part of the reply. */
+	cp->flags &= ~REMOTE_PANE_PAUSING;
+	cp->flags |= REMOTE_PANE_PAUSED;
+	remote_flow_schedule(r, 0);
+}
+
+static void
+remote_pause_error(struct remote *r, struct remote_query *q)
+{
+	struct remote_pane_ctx *ctx = (struct remote_pane_ctx *)q;
+	struct client_pane     *cp;
+
+	if ((cp = remote_find_pane(r, ctx->pane_id)) != NULL)
+		cp->flags &= ~REMOTE_PANE_PAUSING;
+}
+
+/* Stop output for a pane that the local side cannot keep up with. */
+static void
+remote_pause_pane(struct remote *r, struct client_pane *cp)
+{
+	struct remote_pane_ctx *ctx;
+
+	log_debug("%s: %%%u (age %llu, backlog %zu)", __func__, cp->cw.window,
+	    (unsigned long long)cp->age, remote_pane_backlog(cp));
+	cp->flags |= REMOTE_PANE_PAUSING;
+
+	ctx = xcalloc(1, sizeof *ctx);
+	ctx->q.command = "pause";
+	ctx->q.done = remote_pause_done;
+	ctx->q.error = remote_pause_error;
+	ctx->pane_id = cp->cw.window;
+	remote_run(r, &ctx->q, "refresh-client -A '%%%u:pause'\n",
+	    cp->cw.window);
+	bufferevent_flush(r->event, EV_WRITE, BEV_FLUSH);
+}
+
+/* Redraw the visible screen from the capture and continue the pane. */
+static void
+remote_resume_next(struct remote *r, struct remote_query *q)
+{
+	struct remote_pane_ctx *ctx = (struct remote_pane_ctx *)q;
+	struct evbuffer	       *reply = r->reply_buffer;
+	struct evbuffer	       *screen;
+	struct client_pane     *cp;
+	size_t			len, n_read_out;
+	u_int			y;
+	char		       *line;
+
+	if ((cp = remote_find_pane(r, ctx->pane_id)) == NULL)
+		return;
+
+	switch (ctx->state++) {
+	case 0:
+		line = evbuffer_peek_string(reply, NULL);
+		if (line == NULL || sscanf(line, "%u %u", &ctx->cx,
+		    &ctx->cy) != 2)
+			ctx->cx = ctx->cy = 0;
+		break;
+	case 1:
+		screen = evbuffer_new();
+		for (y = 0; (line = evbuffer_peek_string(reply,
+		    &n_read_out)) != NULL; y++) {
+			len = output_unescape(line, line);
+			evbuffer_add_printf(screen, "\033[%u;1H\033[2K", y + 1);
+			evbuffer_add(screen, line, len);
+			evbuffer_add(screen, "\033[m", 3);
+			evbuffer_drain(reply, n_read_out);
+		}
+		evbuffer_add_printf(screen, "\033[%u;%uH", ctx->cy + 1,
+		    ctx->cx + 1);
+		bufferevent_write_buffer(cp->event, screen);
+		bufferevent_flush(cp->event, EV_WRITE, BEV_FLUSH);
+		evbuffer_free(screen);
+		break;
+	default:
+		/* The %continue line is part of the reply. */
+		cp->flags &= ~(REMOTE_PANE_PAUSED|REMOTE_PANE_RESUMING);
+		cp->age = 0;
+		break;
+	}
+}
+
+static void
+remote_resume_error(struct remote *r, struct remote_query *q)
+{
+	struct remote_pane_ctx *ctx = (struct remote_pane_ctx *)q;
+	struct client_pane     *cp;
+
+	/* Wait for the refresh-client reply before trying again. */
+	if (++ctx->state != 3)
+		return;
+	if ((cp = remote_find_pane(r, ctx->pane_id)) != NULL)
+		cp->flags &= ~REMOTE_PANE_RESUMING;
+	remote_flow_schedule(r, 1);
+}
+
+/*
+ * Output was dropped while the pane was paused, so fetch the visible screen
+ * before continuing. These are separate lines so an error in one does not
+ * cancel the others.
+ */
+static void
+remote_resume_pane(struct remote *r, struct client_pane *cp)
+{
+	struct remote_pane_ctx *ctx;
+
+	if (cp->flags & REMOTE_PANE_RESUMING)
+		return;
+	log_debug("%s: %%%u", __func__, cp->cw.window);
+	cp->flags |= REMOTE_PANE_RESUMING;
+
+	ctx = xcalloc(1, sizeof *ctx);
+	ctx->q.command = "resume";
+	ctx->q.done = remote_resume_next;
+	ctx->q.error = remote_resume_error;
+	ctx->pane_id = cp->cw.window;
+	remote_run(r, &ctx->q,
+	    "display-message -pt %%%u '#{cursor_x} #{cursor_y}'\n",
+	    cp->cw.window);
+	remote_run(r, &ctx->q, "capture-pane -peqCN -t %%%u\n",
+	    cp->cw.window);
+	remote_run(r, &ctx->q, "refresh-client -A '%%%u:continue'\n",
+	    cp->cw.window);
+	bufferevent_flush(r->event, EV_WRITE, BEV_FLUSH);
+}
+
+/* Put the fetched lines on top of the pane history. */
+static void
+remote_fetch_done(struct remote *r, struct remote_query *q)
+{
+	struct remote_pane_ctx	*ctx = (struct remote_pane_ctx *)q;
+	struct evbuffer		*reply = r->reply_buffer;
+	struct evbuffer		*lines;
+	struct client_pane	*cp;
+	struct window_pane	*wp;
+	struct input_ctx	*ictx;
+	struct screen		 s;
+	size_t			 len, n_read_out;
+	u_int			 y;
+	char			*line;
+
+	if ((cp = remote_find_pane(r, ctx->pane_id)) == NULL)
+		return;
+	wp = cp->cw.pane;
+	cp->flags &= ~REMOTE_PANE_FETCHING;
+
+	/*
+	 * Wrapped lines are joined, so let them wrap again to get the rows
+	 * back with their flags. The last row is the one already at the top of
+	 * the history, asked for to end any line wrapped onto it.
+	 */
+	lines = evbuffer_new();
+	while ((line = evbuffer_peek_string(reply, &n_read_out)) != NULL) {
+		len = output_unescape(line, line);
+		if (EVBUFFER_LENGTH(lines) != 0)
+			evbuffer_add(lines, "\r\n", 2);
+		evbuffer_add(lines, line, len);
+		evbuffer_add(lines, "\033[m", 3);
+		evbuffer_drain(reply, n_read_out);
+	}
+	screen_init(&s, screen_size_x(&wp->base), ctx->ny + 1, 0);
+	ictx = input_init(NULL, NULL, NULL);
+	input_parse_screen(ictx, &s, NULL, NULL, EVBUFFER_DATA(lines),
+	    EVBUFFER_LENGTH(lines));
+	input_free(ictx);
+	evbuffer_free(lines);
+	y = s.cy;
+	log_debug("%s: %%%u: %u of %u lines", __func__, cp->cw.window, y,
+	    ctx->ny);
+
+	/* Fewer lines than asked for means the server has no more. */
+	if (y < ctx->ny || y > remote_pane_missing(cp))
+		cp->hmissing = 0;
+	else
+		cp->hmissing -= y;
+	if (y == 0) {
+		screen_free(&s);
+		return;
+	}
+
+	grid_prepend_history(wp->base.grid, s.grid, y);
+	screen_free(&s);
+
+	window_copy_history_added(wp);
+	wp->flags |= PANE_REDRAW;
+}
+
+static void
+remote_fetch_error(struct remote *r, struct remote_query *q)
+{
+	struct remote_pane_ctx *ctx = (struct remote_pane_ctx *)q;
+	struct client_pane     *cp;
+
+	if ((cp = remote_find_pane(r, ctx->pane_id)) != NULL)
+		cp->flags &= ~REMOTE_PANE_FETCHING;
+}
+
+/*
+ * Only the end of the history is copied when attaching, fetch the next chunk
+ * above what we already have. The history here may not end where the
+ * server's does (output dropped while paused is not in it) so the lines are
+ * found from the top of the server's history instead, which is hmissing
+ * lines above ours; the server works out where that is from the bottom.
+ */
+void
+remote_fetch_history(struct remote *r, struct window_pane *wp)
+{
+	struct remote_pane_ctx	*ctx;
+	struct client_window	*cw;
+	struct client_pane	*cp = NULL;
+	struct grid		*gd;
+	u_int			 ny;
+
+	RB_FOREACH(cw, client_windows, &r->panes) {
+		if (cw->pane == wp) {
+			cp = container_of(cw, struct client_pane, cw);
+			break;
+		}
+	}
+	if (cp == NULL || remote_pane_missing(cp) == 0)
+		return;
+	if (cp->flags & REMOTE_PANE_FETCHING)
+		return;
+
+	gd = wp->base.grid;
+	if (gd->hsize >= gd->hlimit)
+		return;
+	ny = REMOTE_HISTORY_CHUNK;
+	if (ny > cp->hmissing)
+		ny = cp->hmissing;
+	if (ny > gd->hlimit - gd->hsize)
+		ny = gd->hlimit - gd->hsize;
+
+	log_debug("%s: %%%u: %u lines above %u", __func__, cp->cw.window, ny,
+	    cp->hmissing);
+	cp->flags |= REMOTE_PANE_FETCHING;
+
+	ctx = xcalloc(1, sizeof *ctx);
+	ctx->q.command = "fetch";
+	ctx->q.done = remote_fetch_done;
+	ctx->q.error = remote_fetch_error;
+	ctx->pane_id = cp->cw.window;
+	ctx->ny = ny;
+	remote_run(r, &ctx->q, "capture-pane -peqCJN "
+	    "-S '#{e|-:%u,#{history_size}}' -E '#{e|-:%u,#{history_size}}' "
+	    "-t %%%u\n", cp->hmissing - ny, cp->hmissing, cp->cw.window);
+	bufferevent_flush(r->event, EV_WRITE, BEV_FLUSH);
+}
+
+static void
+remote_flow_schedule(struct remote *r, int delay)
+{
+	struct timeval	tv = { .tv_sec = 0, .tv_usec = 0 };
+
+	if (delay)
+		tv.tv_usec = REMOTE_FLOW_INTERVAL * 1000;
+	if (evtimer_pending(&r->flow_timer, NULL)) {
+		if (delay)
+			return;
+		evtimer_del(&r->flow_timer);
+	}
+	evtimer_add(&r->flow_timer, &tv);
+}
+
+/* Resume paused panes once they have drained and are visible. */
+static void
+remote_flow_timer(__unused int fd, __unused short events, void *data)
+{
+	struct remote		*r = data;
+	struct client_window	*cw;
+	struct client_pane	*cp;
+	int			 waiting = 0;
+
+	RB_FOREACH(cw, client_windows, &r->panes) {
+		if (cw->pane == NULL)
+			continue;
+		cp = container_of(cw, struct client_pane, cw);
+
+		if (~cp->flags & REMOTE_PANE_PAUSED)
+			continue;
+		if (cp->flags & REMOTE_PANE_RESUMING)
+			continue;
+		if (remote_pane_backlog(cp) >= REMOTE_BACKLOG_LOW) {
+			waiting = 1;
+			continue;
+		}
+
+		/* Hidden windows stay paused until they are shown. */
+		if (remote_pane_visible(r, cp))
+			remote_resume_pane(r, cp);
+	}
+	if (waiting)
+		remote_flow_schedule(r, 1);
+}
+
+static void
+remote_pane_write(struct remote *r, struct client_pane *cp, char *data)
+{
+	size_t	len;
+
+	if (cp->flags & REMOTE_PANE_SYNCING)
+		return;
+	len = output_unescape(data, data);
+	bufferevent_write(cp->event, data, len);
+	bufferevent_flush(cp->event, EV_WRITE, BEV_FLUSH);
+	remote_pane_written(r, cp);
+}
+
+/* Check if a pane that was written to should be paused. */
+static void
+remote_pane_written(struct remote *r, struct client_pane *cp)
+{
+	remote_predict_check(r, cp);
+
+	if (cp->flags & (REMOTE_PANE_PAUSING|REMOTE_PANE_PAUSED))
+		return;
+	if (remote_pane_backlog(cp) >= REMOTE_BACKLOG_HIGH ||
+	    (cp->age >= REMOTE_HOLD_AGE && !remote_pane_visible(r, cp)))
+		remote_pause_pane(r, cp);
+}
+
+static void
+remote_output(struct remote *r, u_int pane_id, char *data)
+{
+	struct client_pane *cp;
+
+	if ((cp = remote_find_pane(r, pane_id)) == NULL) {
+		remote_log(r, "%s: no such pane: %u", __func__, pane_id);
+		return;
+	}
+	remote_pane_write(r, cp, data);
+}
+
+/* Keys were written to a remote pane, forward them on the next loop. */
+static void
+remote_input(__unused struct bufferevent *kev, void *ctx)
 {
 	struct remote_input_ctx *ictx = ctx;
-	struct remote		*r = ictx->r;
-	struct remote_query	*q = xcalloc(1, sizeof *q);
-	const char		*keys = EVBUFFER_DATA(kev->input);
-	size_t			 i, n = EVBUFFER_LENGTH(kev->input);
-	char			*hex = xmalloc(3 * n);
-
-	for (i = 0; i < n; ++i)
-		sprintf(hex + (i * 3), "%02X ", keys[i]);
-	hex[3 * n] = '\0';
-	evbuffer_drain(kev->input, n);
-
-	/* q->error = remote_shutdown_because_of_error; */
-	remote_run(r, q, "send-keys -t %%%u -lH %s\n", ictx->pane_id, hex);
-	free(hex);
+
+	remote_input_schedule(ictx->r);
+}
+
+static void
+remote_input_schedule(struct remote *r)
+{
+	struct timeval	tv = { .tv_sec = 0, .tv_usec = 0 };
+
+	if (r->input_inflight >= REMOTE_INPUT_INFLIGHT)
+		return;
+	if (!evtimer_pending(&r->input_timer, NULL))
+		evtimer_add(&r->input_timer, &tv);
+}
+
+static int
+remote_input_printable(u_char ch)
+{
+	return (ch >= 0x20 && ch <= 0x7e && ch != '\'');
+}
+
+/*
+ * Queue send-keys commands for a block of keys. Printable runs are sent as
+ * single-quoted literals and everything else as hex. Each command goes on
+ * its own line so a failed command does not drop the rest of the batch.
+ */
+static void
+remote_send_keys(struct remote *r, struct remote_query *q, u_int pane_id,
+    const u_char *keys, size_t n)
+{
+	size_t	 i, j, k;
+	char	*hex;
+
+	for (i = 0; i < n; i = j) {
+		if (remote_input_printable(keys[i])) {
+			for (j = i; j < n && remote_input_printable(keys[j]); j++)
+				/* nothing */;
+			remote_run(r, q, "send-keys -t %%%u -l -- '%.*s'\n",
+			    pane_id, (int)(j - i), keys + i);
+			continue;
+		}
+
+		for (j = i; j < n && !remote_input_printable(keys[j]); j++)
+			/* nothing */;
+		hex = xmalloc(3 * (j - i) + 1);
+		for (k = i; k < j; k++)
+			sprintf(hex + 3 * (k - i), "%02X ", keys[k]);
+		hex[3 * (j - i) - 1] = '\0';
+		remote_run(r, q, "send-keys -t %%%u -H %s\n", pane_id, hex);
+		free(hex);
+	}
+}
+
+/* Forward pending keys for all panes in a single query. */
+static void
+remote_input_timer(__unused int fd, __unused short events, void *data)
+{
+	struct remote		*r = data;
+	struct remote_query	*q = NULL;
+	struct client_window	*cw;
+	struct client_pane	*cp;
+	struct evbuffer		*evb;
+	size_t			 n;
+	int			 more = 0;
+
+	if (r->input_inflight >= REMOTE_INPUT_INFLIGHT)
+		return;
+
+	RB_FOREACH(cw, client_windows, &r->panes) {
+		if (cw->pane == NULL)
+			continue;
+		cp = container_of(cw, struct client_pane, cw);
+
+		evb = cp->event->input;
+		if ((n = EVBUFFER_LENGTH(evb)) == 0)
+			continue;
+		if (n > REMOTE_INPUT_CHUNK) {
+			n = REMOTE_INPUT_CHUNK;
+			more = 1;
+		}
+
+		if (q == NULL) {
+			q = xcalloc(1, sizeof *q);
+			q->command = "send-keys";
+			q->done = remote_input_done;
+			q->error = remote_input_done;
+		}
+		remote_send_keys(r, q, cw->window, EVBUFFER_DATA(evb), n);
+		remote_predict(r, cp, EVBUFFER_DATA(evb), n);
+		evbuffer_drain(evb, n);
+	}
+	if (q == NULL)
+		return;
+
+	r->input_inflight++;
 	bufferevent_flush(r->event, EV_WRITE, BEV_FLUSH);
+
+	if (more)
+		remote_input_schedule(r);
+}
+
+static void
+remote_input_done(struct remote *r, struct remote_query *q)
+{
+	if (q->arity != 1)
+		return;
+	r->input_inflight--;
+	remote_input_schedule(r);
+}
+
+/* Draw a cell without moving the cursor. */
+static void
+remote_predict_draw(struct window_pane *wp, u_int x, u_int y,
+    const struct grid_cell *gc)
+{
+	struct screen_write_ctx	 ctx;
+	struct screen		*s = &wp->base;
+	u_int			 cx = s->cx, cy = s->cy;
+
+	screen_write_start_pane(&ctx, wp, s);
+	screen_write_cursormove(&ctx, x, y - s->grid->hsize, 0);
+	screen_write_cell(&ctx, gc);
+	screen_write_cursormove(&ctx, cx, cy, 0);
+	screen_write_stop(&ctx);
+}
+
+/*
+ * Keys can only be matched to their echo in a pane that is not in a mode, not
+ * paused and not waiting for an earlier key to settle.
+ */
+static int
+remote_predict_ready(struct client_pane *cp)
+{
+	struct window_pane	*wp = cp->cw.pane;
+	struct screen		*s = &wp->base;
+
+	if (cp->flags & (REMOTE_PANE_PAUSING|REMOTE_PANE_PAUSED|
+	    REMOTE_PANE_SYNCING|REMOTE_PANE_NOPREDICT))
+		return (0);
+	if (wp->screen != s)
+		return (0);
+	if (s->mode & MODE_INSERT)
+		return (0);
+	return (1);
+}
+
+static void
+remote_predict_schedule(struct remote *r)
+{
+	struct timeval	tv = { .tv_sec = 0 };
+
+	tv.tv_usec = REMOTE_PREDICT_INTERVAL * 1000;
+	if (!evtimer_pending(&r->predict_timer, NULL))
+		evtimer_add(&r->predict_timer, &tv);
+}
+
+/*
+ * Record where keys sent to a pane should be echoed and, if remote-predict
+ * is on, show them there straight away. Anything other than a printable key
+ * may move the cursor, so stop until the pane has settled. Until a key has
+ * been seen to echo where expected (and again after a misprediction), keys
+ * are only recorded, because the application may not be echoing at all.
+ */
+static void
+remote_predict(struct remote *r, struct client_pane *cp, const u_char *keys,
+    size_t n)
+{
+	struct window_pane	*wp = cp->cw.pane;
+	struct screen		*s = &wp->base;
+	struct remote_predict	*rp, *last;
+	struct timeval		 now;
+	size_t			 i;
+	int			 draw;
+
+	if (r->session == NULL)
+		return;
+	draw = options_get_number(r->session->options, "remote-predict");
+	gettimeofday(&now, NULL);
+
+	for (i = 0; i < n; i++) {
+		if (keys[i] < 0x20 || keys[i] > 0x7e) {
+			cp->flags |= REMOTE_PANE_NOPREDICT;
+			cp->nopredict_time = now;
+			break;
+		}
+		if (!remote_predict_ready(cp))
+			break;
+
+		rp = xcalloc(1, sizeof *rp);
+		if ((last = TAILQ_LAST(&cp->predictions,
+		    remote_predicts)) != NULL) {
+			rp->x = last->x + 1;
+			rp->y = last->y;
+		} else {
+			rp->x = s->cx;
+			rp->y = s->grid->hsize + s->cy;
+		}
+		if (rp->x >= screen_size_x(s) - 1) {
+			free(rp);
+			break;
+		}
+		grid_get_cell(s->grid, rp->x, rp->y, &rp->saved);
+		memcpy(&rp->gc, &grid_default_cell, sizeof rp->gc);
+		rp->gc.attr |= GRID_ATTR_UNDERSCORE;
+		utf8_set(&rp->gc.data, keys[i]);
+		rp->time = now;
+		TAILQ_INSERT_TAIL(&cp->predictions, rp, entry);
+
+		if (draw && (~cp->flags & REMOTE_PANE_UNSURE)) {
+			remote_predict_draw(wp, rp->x, rp->y, &rp->gc);
+			rp->drawn = 1;
+		}
+	}
+	if (!TAILQ_EMPTY(&cp->predictions) || (cp->flags & REMOTE_PANE_NOPREDICT))
+		remote_predict_schedule(r);
+}
+
+/*
+ * Match keys to what the server has drawn. A key is echoed once its cell has
+ * changed or the cursor has moved past it. Keys that are not echoed in time
+ * were mispredicted and their cell is put back.
+ */
+static void
+remote_predict_check(struct remote *r, struct client_pane *cp)
+{
+	struct window_pane	*wp = cp->cw.pane;
+	struct screen		*s = &wp->base;
+	struct grid		*gd = s->grid;
+	struct remote_predict	*rp, *rp1;
+	struct grid_cell	 gc;
+	struct timeval		 now, tv;
+	u_int			 ms, timeout, cy = gd->hsize + s->cy;
+	int			 echoed;
+
+	gettimeofday(&now, NULL);
+	timeout = REMOTE_PREDICT_TIMEOUT + 2 * (r->latency_avg / 1000);
+
+	TAILQ_FOREACH_SAFE(rp, &cp->predictions, entry, rp1) {
+		timersub(&now, &rp->time, &tv);
+		ms = tv.tv_sec * 1000 + tv.tv_usec / 1000;
+
+		if (rp->y >= gd->hsize + gd->sy) {
+			/* History was trimmed, the cell is gone. */
+			echoed = 1;
+		} else {
+			grid_get_cell(gd, rp->x, rp->y, &gc);
+			if (rp->drawn)
+				echoed = !grid_cells_equal(&gc, &rp->gc);
+			else {
+				echoed = !grid_cells_equal(&gc, &rp->saved) ||
+				    cy > rp->y || (cy == rp->y && s->cx > rp->x);
+			}
+		}
+
+		if (echoed) {
+			if (!rp->drawn && rp->y < gd->hsize + gd->sy &&
+			    gc.data.size == 1 &&
+			    gc.data.data[0] == rp->gc.data.data[0])
+				cp->flags &= ~REMOTE_PANE_UNSURE;
+			r->echo_latency = (3 * r->echo_latency + ms) / 4;
+			r->input_latency = (3 * r->input_latency +
+			    (rp->drawn ? 0 : ms)) / 4;
+		} else if (ms >= timeout) {
+			log_debug("%s: %%%u: no echo at %u,%u after %u ms",
+			    __func__, cp->cw.window, rp->x, rp->y, ms);
+			if (rp->drawn && rp->y >= gd->hsize)
+				remote_predict_draw(wp, rp->x, rp->y, &rp->saved);
+			r->mispredictions++;
+			cp->flags |= (REMOTE_PANE_NOPREDICT|REMOTE_PANE_UNSURE);
+			cp->nopredict_time = now;
+		} else
+			continue;
+		TAILQ_REMOVE(&cp->predictions, rp, entry);
+		free(rp);
+	}
+
+	/* Start again once the keys have been answered and things are quiet. */
+	if ((cp->flags & REMOTE_PANE_NOPREDICT) &&
+	    TAILQ_EMPTY(&cp->predictions) && r->input_inflight == 0) {
+		timersub(&now, &cp->nopredict_time, &tv);
+		if (tv.tv_sec * 1000000 + tv.tv_usec >= r->latency_avg)
+			cp->flags &= ~REMOTE_PANE_NOPREDICT;
+	}
+}
+
+/* Forget keys for a pane without drawing anything. */
+static void
+remote_predict_free(struct client_pane *cp)
+{
+	struct remote_predict	*rp;
+
+	while ((rp = TAILQ_FIRST(&cp->predictions)) != NULL) {
+		TAILQ_REMOVE(&cp->predictions, rp, entry);
+		free(rp);
+	}
+	cp->flags &= ~REMOTE_PANE_NOPREDICT;
+}
+
+static void
+remote_predict_timer(__unused int fd, __unused short events, void *data)
+{
+	struct remote		*r = data;
+	struct client_window	*cw;
+	struct client_pane	*cp;
+	int			 pending = 0;
+
+	if (r->session == NULL)
+		return;
+	RB_FOREACH(cw, client_windows, &r->panes) {
+		if (cw->pane == NULL)
+			continue;
+		cp = container_of(cw, struct client_pane, cw);
+
+		remote_predict_check(r, cp);
+		if (!TAILQ_EMPTY(&cp->predictions) ||
+		    (cp->flags & REMOTE_PANE_NOPREDICT))
+			pending = 1;
+	}
+	if (pending)
+		remote_predict_schedule(r);
+}
+
+/* Smoothed time from a key being sent to its echo, in milliseconds. */
+u_int
+remote_echo_latency(struct remote *r)
+{
+	return (r->echo_latency);
+}
+
+/* Smoothed time from a key being sent to it being shown, in milliseconds. */
+u_int
+remote_input_latency(struct remote *r)
+{
+	return (r->input_latency);
 }
 
 static void
@@ -493,84 +2052,114 @@ remote_show_environment(struct remote *r, struct environ *env, int flags)
 }
 
 static void
-remote_add_panes(struct remote *r, struct remote_bootstrap_ctx *ctx)
+remote_parse_pane(char **iter, struct remote_pane_info *pi)
+{
+	pi->window_id = atol(strsep(iter, "\t") + /*@*/1);
+	pi->window_index = atol(strsep(iter, "\t"));
+	pi->sx = atol(strsep(iter, "\t"));
+	pi->sy = atol(strsep(iter, "\t"));
+	pi->pane_id = atol(strsep(iter, "\t") + /*%*/1);
+	pi->pane_index = atol(strsep(iter, "\t"));
+	pi->active = atol(strsep(iter, "\t"));
+	pi->cx = atol(strsep(iter, "\t"));
+	pi->cy = atol(strsep(iter, "\t"));
+	pi->hlimit = atol(strsep(iter, "\t"));
+	pi->hsize = atol(strsep(iter, "\t"));
+}
+
+/* Connect a local pane to a remote one. */
+static struct client_pane *
+remote_new_pane(struct remote *r, struct client_windows *panes,
+    struct window_pane *wp, struct remote_pane_info *pi)
 {
-	struct session	     *s = ctx->session;
-	struct evbuffer	     *reply = r->reply_buffer;
-	struct window	     *w;
-	struct winlink	     *wl;
-	struct client_window *cw;
-	struct client_pane   *cp;
-	struct window_pane   *wp = NULL;
 	struct remote_input_ctx *rictx;
-	struct bufferevent   *pipe[2];
+	struct client_window	*cw;
+	struct client_pane	*cp;
+	struct bufferevent	*pipe[2];
+
+	/* Pane IDs are not reused, so a closed pane has moved here. */
+	cw = RB_FIND(client_windows, panes,
+	    &(struct client_window){ .window = pi->pane_id });
+	if (cw != NULL) {
+		RB_REMOVE(client_windows, panes, cw);
+		free(container_of(cw, struct client_pane, cw));
+	}
+
+	bufferevent_pair_new(NULL, 0, pipe);
+	window_pane_set_event_nofd(wp, pipe[1]);
+
+	rictx = xcalloc(1, sizeof *rictx);
+	rictx->r = r;
+	rictx->pane_id = pi->pane_id;
+	bufferevent_setcb(pipe[0], remote_input, NULL, NULL, rictx);
+	bufferevent_enable(pipe[0], EV_READ);
+
+	cp = xcalloc(1, sizeof *cp);
+	cp->cw.window = pi->pane_id;
+	cp->cw.pane = wp;
+	cp->init_cx = pi->cx;
+	cp->init_cy = pi->cy;
+	cp->event = pipe[0];
+	cp->flags = REMOTE_PANE_UNSURE;
+	TAILQ_INIT(&cp->predictions);
+	if (pi->hsize > REMOTE_HISTORY_TAIL)
+		cp->hmissing = pi->hsize - REMOTE_HISTORY_TAIL;
+	cp->htrimmed = wp->base.grid->htrimmed;
+
+	RB_INSERT(client_windows, panes, &cp->cw);
+	return (cp);
+}
+
+static void
+remote_add_panes(struct remote *r, struct remote_bootstrap_ctx *ctx)
+{
+	struct session		*s = ctx->session;
+	struct evbuffer		*reply = r->reply_buffer;
+	struct window		*w;
+	struct winlink		*wl;
+	struct client_window	*cw;
+	struct window_pane	*wp = NULL;
+	struct remote_pane_info	 pi;
 	size_t			 n_read_out;
 	char			*line, *iter;
-	u_int		      window_id, pane_id;
-	u_int		      window_index, pane_index;
-	u_int		      cx, cy, sx, sy, active, hsize, hlimit;
 
 	while ((line = evbuffer_peek_string(reply, &n_read_out))) {
 		remote_log(r, "pane: %s", line);
 
 		iter = line;
-		window_id = atol(strsep(&iter, "\t") + /*@*/1);
-		window_index = atol(strsep(&iter, "\t"));
-		sx = atol(strsep(&iter, "\t"));
-		sy = atol(strsep(&iter, "\t"));
-		pane_id = atol(strsep(&iter, "\t") + /*%*/1);
-		pane_index = atol(strsep(&iter, "\t"));
-		active = atol(strsep(&iter, "\t"));
-		cx = atol(strsep(&iter, "\t"));
-		cy = atol(strsep(&iter, "\t"));
-		hlimit = atol(strsep(&iter, "\t"));
+		remote_parse_pane(&iter, &pi);
 
 		cw = RB_FIND(client_windows, &ctx->windows,
-		    &(struct client_window){.window = window_id});
+		    &(struct client_window){.window = pi.window_id});
 
 		if (cw == NULL) {
-			wl = winlink_add(&s->windows, window_index);
+			wl = winlink_add(&s->windows, pi.window_index);
 			wl->session = s;
 
-			w = window_create(sx, sy, 0, 0);
+			w = window_create(pi.sx, pi.sy, 0, 0);
 			winlink_set_window(wl, w);
+			options_set_number(w->options, "automatic-rename", 0);
 			if (s->curw == NULL)
 				s->curw = wl;
 		} else {
 			w = cw->pane->window;
 		}
 
-		wp = window_add_pane(w, wp, hlimit, 0);
+		wp = window_add_pane(w, wp, pi.hlimit, 0);
 		if (cw == NULL)
 			layout_init(w, wp);
 
-		if (active || cw == NULL)
+		if (pi.active || cw == NULL)
 			w->active = wp;
 
 		if (cw == NULL) {
 			cw = xcalloc(1, sizeof *cw);
-			cw->window = window_id;
+			cw->window = pi.window_id;
 			cw->pane = wp;
 			RB_INSERT(client_windows, &ctx->windows, cw);
 		}
 
-		bufferevent_pair_new(NULL, 0, pipe);
-		window_pane_set_event_nofd(wp, pipe[1]);
-
-		rictx = xcalloc(1, sizeof *rictx);
-		rictx->r = r;
-		rictx->pane_id = pane_id;
-		bufferevent_setcb(pipe[0], remote_input, NULL, NULL, rictx);
-		bufferevent_enable(pipe[0], EV_READ);
-
-		cp = xcalloc(1, sizeof *cp);
-		cp->cw.window = pane_id;
-		cp->cw.pane = wp;
-		cp->init_cx = cx;
-		cp->init_cy = cy;
-		cp->event = pipe[0];
-
-		RB_INSERT(client_windows, &ctx->panes, &cp->cw);
+		remote_new_pane(r, &ctx->panes, wp, &pi);
 
 		evbuffer_drain(reply, n_read_out);
 	}
@@ -611,198 +2200,963 @@ remote_fix_windows(struct remote *r, struct remote_bootstrap_ctx *ctx)
 			free(cause);
 		}
 
-		// XXX: populate_history broke naming
-		free(w->name);
-		utf8_stravis(&w->name, name, VIS_OCTAL|VIS_CSTYLE|VIS_TAB|VIS_NL);
+		free(w->name);
+		utf8_stravis(&w->name, name, VIS_OCTAL|VIS_CSTYLE|VIS_TAB|VIS_NL);
+
+		evbuffer_drain(reply, n_read_out);
+	}
+}
+
+static void
+remote_populate_history(struct remote *r, struct remote_bootstrap_ctx *ctx)
+{
+	struct evbuffer	   *reply = r->reply_buffer;
+	struct evbuffer	   *history = evbuffer_new();
+	struct client_pane *cp = container_of(ctx->cw, struct client_pane, cw);
+	struct window_pane *wp = ctx->cw->pane;
+	struct grid *tmp;
+	size_t		    len, n_read_out;
+	char		   *text;
+
+	remote_log(r, "populate_history %%%u", ctx->cw->window);
+
+	while ((text = evbuffer_peek_string(reply, &n_read_out))) {
+		len = output_unescape(text, text);
+		evbuffer_remove_buffer(reply, history, len);
+		evbuffer_drain(reply, n_read_out - len);
+		if (evbuffer_get_length(reply))
+			evbuffer_add(history, "\r\n", 2);
+	}
+
+	text = EVBUFFER_DATA(history);
+	len = EVBUFFER_LENGTH(history);
+
+	if (cp->alt) {
+		wp->screen->saved_grid = wp->screen->grid;
+		wp->screen->grid = grid_create(
+		    screen_size_x(wp->screen), screen_size_y(wp->screen), 0);
+
+		input_parse_buffer(wp, text, len);
+
+		tmp = wp->screen->saved_grid;
+		wp->screen->saved_grid = wp->screen->grid;
+		wp->screen->grid = tmp;
+	} else {
+		input_parse_buffer(wp, text, len);
+	}
+
+	evbuffer_free(history);
+
+
+	if (cp->alt) {
+		ctx->cw = RB_NEXT(client_windows, &r->panes, ctx->cw);
+		wp->base.cx = cp->init_cx;
+		wp->base.cy = cp->init_cy;
+	} else {
+		cp->alt = 1;
+	}
+}
+
+static void
+remote_request_history(struct remote *r, struct remote_query *q, struct remote_bootstrap_ctx *ctx)
+{
+	struct client_window	    *cw = NULL;
+
+	ctx->cw = RB_MIN(client_windows, &ctx->panes);
+	RB_FOREACH(cw, client_windows, &ctx->panes) {
+		remote_run(r, q,
+		    "capture-pane -peqCJN -S -%u -t %%%u ; ",
+		    REMOTE_HISTORY_TAIL, cw->window);
+		remote_run(r, q,
+		    "capture-pane -apeqCJN -S -%u -t %%%u\n",
+		    REMOTE_HISTORY_TAIL, cw->window);
+	}
+	bufferevent_flush(r->event, EV_WRITE, BEV_FLUSH);
+}
+
+static void
+remote_bootstrap_next(struct remote *r, struct remote_query *q)
+{
+	struct options		    *oo;
+	struct remote_bootstrap_ctx *ctx;
+
+	ctx = (struct remote_bootstrap_ctx*) q;
+
+	remote_log(r, "bootstrap_next from state = %u", ctx->state);
+
+	switch (ctx->state++) {
+	case 0:
+		remote_show_environment(r, ctx->env, 0);
+		break;
+	case 1:
+		remote_show_environment(r, ctx->env, ENVIRON_HIDDEN);
+		oo = options_create(global_s_options);
+		ctx->session = session_create(
+		    NULL, ctx->session_name, "/tmp", ctx->env, oo, NULL);
+		ctx->session->remote = r;
+		break;
+	case 2:
+		remote_add_panes(r, ctx);
+		remote_request_history(r, q, ctx);
+		break;
+	case 3:
+		remote_fix_windows(r, ctx);
+		break;
+	default:
+		remote_populate_history(r, ctx);
+		break;
+	}
+
+	if (q->arity == 1) {
+		remote_log(r, "bootstrap finished");
+
+		/* commit */
+		r->bootstrap = NULL;
+		r->session_id = ctx->session_id;
+		r->session = ctx->session;
+		r->windows = ctx->windows;
+		r->panes = ctx->panes;
+
+		server_redraw_session(r->session);
+		remote_input_schedule(r);
+	}
+}
+
+static void
+remote_bootstrap_error(struct remote *r, struct remote_query *q)
+{
+	struct remote_bootstrap_ctx *ctx = (struct remote_bootstrap_ctx *)q;
+	struct evbuffer *reply = r->reply_buffer;
+	const char *msg = evbuffer_peek_string(reply, NULL);
+
+	remote_log(r, "bootstrap failed: %s: %s", q->command,
+	    msg == NULL ? "cancelled" : msg);
+
+	/* Nothing will commit the session if the last command failed. */
+	if (q->arity == 1 && r->bootstrap == ctx) {
+		if (ctx->session != NULL)
+			session_destroy(ctx->session, 1, __func__);
+		ctx->session = NULL;
+		r->bootstrap = NULL;
+	}
+}
+
+/* The attached session was changed. */
+static void
+remote_session_changed(struct remote *r, u_int session_id, char *name)
+{
+	struct remote_bootstrap_ctx *ctx;
+
+	if (r->session) {
+		session_destroy(r->session, 1, __func__);
+		r->session = NULL;
+	}
+
+	/* Throw away a bootstrap for a session that is no longer attached. */
+	if ((ctx = r->bootstrap) != NULL) {
+		if (ctx->session != NULL)
+			session_destroy(ctx->session, 1, __func__);
+		ctx->session = NULL;
+		r->bootstrap = NULL;
+		remote_cancel(r, &ctx->q);
+	}
+
+	if (remote_adopt(r, session_id, name))
+		return;
+
+	ctx = xcalloc(1, sizeof *ctx);
+	ctx->q.command = "bootstrap";
+	ctx->q.done = remote_bootstrap_next;
+	ctx->q.error = remote_bootstrap_error;
+	ctx->env = environ_create();
+	ctx->session_id = session_id;
+	ctx->session_name = xstrdup(name);
+	RB_INIT(&ctx->windows);
+	RB_INIT(&ctx->panes);
+
+	r->bootstrap = ctx;
+	remote_run(r, &ctx->q, "show-environment -t $%u;", session_id);
+	remote_run(r, &ctx->q, "show-environment -ht $%u;", session_id);
+	remote_run(r, &ctx->q, "list-panes -st $%u -F \"%s\";", session_id,
+	    REMOTE_PANE_FORMAT);
+	remote_run(r, &ctx->q, "list-windows -t $%u -F \"%s\"\n", session_id,
+	    "#{window_id}\t"
+	    "#{window_name}\t"
+	    "#{window_layout}\t"
+	    "#{window_flags}\t"
+	    "#{?window_active,1,0}");
+
+	/* iterm: */
+	/* kStateDictPaneId, kStateDictSavedGrid,
+	   kStateDictAltSavedCX, kStateDictAltSavedCY, kStateDictCursorX,
+	   kStateDictCursorY, kStateDictScrollRegionUpper,
+	   kStateDictScrollRegionLower,
+	   kStateDictTabstops, kStateDictCursorMode, kStateDictInsertMode,
+           kStateDictKCursorMode,
+	   kStateDictKKeypadMode, kStateDictWrapMode,
+	   kStateDictMouseStandardMode,
+	   kStateDictMouseButtonMode, kStateDictMouseAnyMode,
+	   kStateDictMouseUTF8Mode, kStateDictMouseSGRMode ];
+	*/
+
+	/* show-options -g */
+	bufferevent_flush(r->event, EV_WRITE, BEV_FLUSH);
+}
+
+/* Pick another pane to find a window by when one of its panes goes away. */
+static void
+remote_forget_pane(struct remote *r, struct window_pane *wp)
+{
+	struct client_window	*cw;
+	struct window_pane	*loop;
+
+	RB_FOREACH(cw, client_windows, &r->windows) {
+		if (cw->pane != wp)
+			continue;
+		TAILQ_FOREACH(loop, &wp->window->panes, entry) {
+			if (loop != wp)
+				break;
+		}
+		cw->pane = loop;
+	}
+}
+
+/* A pane no longer exists on the server. */
+static void
+remote_close_pane(struct remote *r, struct window_pane *wp)
+{
+	struct session		*s;
+	struct client_window	*cw;
+	struct client_pane	*cp;
+
+	RB_FOREACH(cw, client_windows, &r->panes) {
+		if (cw->pane == wp) {
+			log_debug("%s: %%%u", __func__, cw->window);
+			cp = container_of(cw, struct client_pane, cw);
+			remote_predict_free(cp);
+			bufferevent_free(cp->event);
+			cp->event = NULL;
+			cw->pane = NULL; /* tombstone */
+			break;
+		}
+	}
+	remote_forget_pane(r, wp);
+
+	/*
+	 * Killing the last pane of the last window destroys the session, so
+	 * forget it now rather than leaving %exit or the orphan code with a
+	 * dead session.
+	 */
+	s = r->session;
+	if (s != NULL &&
+	    window_count_panes(wp->window) == 1 &&
+	    winlink_count(&s->windows) == 1 &&
+	    session_has(s, wp->window)) {
+		log_debug("%s: last pane of session %s", __func__, s->name);
+		s->remote = NULL;
+		r->session = NULL;
+	}
+	server_kill_pane(wp);
+}
+
+/* Move a pane that was joined or broken to another window on the server. */
+static void
+remote_move_pane(struct remote *r, struct window_pane *wp, struct window *w)
+{
+	struct window	*old = wp->window;
+
+	log_debug("%s: %%%u from @%u to @%u", __func__, wp->id, old->id, w->id);
+	remote_forget_pane(r, wp);
+
+	layout_close_pane(wp);
+	server_client_remove_pane(wp);
+	window_lost_pane(old, wp);
+	TAILQ_REMOVE(&old->panes, wp, entry);
+
+	wp->window = w;
+	options_set_parent(wp->options, w->options);
+	wp->flags |= (PANE_STYLECHANGED|PANE_THEMECHANGED);
+	TAILQ_INSERT_TAIL(&w->panes, wp, entry);
+	if (w->layout_root == NULL)
+		layout_init(w, wp);
+	colour_palette_from_option(&wp->palette, wp->options);
+
+	if (TAILQ_EMPTY(&old->panes))
+		server_kill_window(old, 1);
+	else
+		server_redraw_window(old);
+}
+
+/* Copy the screen and some history of a pane added after bootstrap. */
+static void
+remote_sync_pane_next(struct remote *r, struct remote_query *q)
+{
+	struct remote_pane_ctx	*ctx = (struct remote_pane_ctx *)q;
+	struct evbuffer		*reply = r->reply_buffer;
+	struct evbuffer		*lines;
+	struct client_pane	*cp;
+	struct window_pane	*wp;
+	struct screen_write_ctx	 sctx;
+	size_t			 len, n_read_out;
+	u_int			 hsize;
+	char			*line;
+
+	if ((cp = remote_find_pane(r, ctx->pane_id)) == NULL)
+		return;
+	wp = cp->cw.pane;
+
+	switch (ctx->state++) {
+	case 0:
+		line = evbuffer_peek_string(reply, NULL);
+		if (line == NULL || sscanf(line, "%u %u %u", &ctx->cx,
+		    &ctx->cy, &hsize) != 3)
+			ctx->cx = ctx->cy = hsize = 0;
+
+		/* The history copied starts this far down the server's. */
+		if (ctx->full) {
+			if (hsize > ctx->ny)
+				cp->hmissing = hsize - ctx->ny;
+			else
+				cp->hmissing = 0;
+		}
+		break;
+	default:
+		lines = evbuffer_new();
+		while ((line = evbuffer_peek_string(reply,
+		    &n_read_out)) != NULL) {
+			len = output_unescape(line, line);
+			evbuffer_add(lines, line, len);
+			evbuffer_drain(reply, n_read_out);
+			if (EVBUFFER_LENGTH(reply) != 0)
+				evbuffer_add(lines, "\r\n", 2);
+		}
+
+		/* The capture replaces the screen and follows the history. */
+		screen_write_start(&sctx, &wp->base);
+		if (ctx->full)
+			screen_write_clearhistory(&sctx);
+		screen_write_scrollregion(&sctx, 0,
+		    screen_size_y(&wp->base) - 1);
+		screen_write_clearscreen(&sctx, 8);
+		screen_write_stop(&sctx);
+		if (ctx->full)
+			cp->htrimmed = wp->base.grid->htrimmed;
+
+		input_parse_buffer(wp, EVBUFFER_DATA(lines),
+		    EVBUFFER_LENGTH(lines));
+		evbuffer_free(lines);
+
+		wp->base.cx = ctx->cx;
+		wp->base.cy = ctx->cy;
+		wp->flags |= PANE_REDRAW;
+		cp->flags &= ~REMOTE_PANE_SYNCING;
+		break;
+	}
+}
+
+static void
+remote_sync_pane_error(struct remote *r, struct remote_query *q)
+{
+	struct remote_pane_ctx	*ctx = (struct remote_pane_ctx *)q;
+	struct client_pane	*cp;
+
+	ctx->state++;
+	if ((cp = remote_find_pane(r, ctx->pane_id)) != NULL)
+		cp->flags &= ~REMOTE_PANE_SYNCING;
+}
+
+/*
+ * Fetch the screen of a pane and the given number of history lines above it.
+ * These are added to the end of the history or, if full is set, replace it.
+ * Output is dropped until the capture arrives because the capture already
+ * includes it.
+ */
+static void
+remote_sync_pane(struct remote *r, struct client_pane *cp, u_int lines,
+    int full)
+{
+	struct remote_pane_ctx	*ctx;
+
+	cp->flags |= REMOTE_PANE_SYNCING;
+
+	ctx = xcalloc(1, sizeof *ctx);
+	ctx->q.command = "sync-pane";
+	ctx->q.done = remote_sync_pane_next;
+	ctx->q.error = remote_sync_pane_error;
+	ctx->pane_id = cp->cw.window;
+	ctx->ny = lines;
+	ctx->full = full;
+	remote_run(r, &ctx->q,
+	    "display-message -pt %%%u '#{cursor_x} #{cursor_y} "
+	    "#{history_size}'\n", cp->cw.window);
+	remote_run(r, &ctx->q, "capture-pane -peqCJN -S -%u -t %%%u\n",
+	    lines, cp->cw.window);
+}
+
+/* Create a window that was added on the server. */
+static struct window *
+remote_new_window(struct remote *r, struct remote_pane_info *pi,
+    const char *name)
+{
+	struct session	*s = r->session;
+	struct winlink	*wl;
+	struct window	*w;
+
+	wl = winlink_add(&s->windows, pi->window_index);
+	if (wl == NULL) {
+		wl = winlink_add(&s->windows,
+		    -1 - options_get_number(s->options, "base-index"));
+	}
+	wl->session = s;
+
+	w = window_create(pi->sx, pi->sy, 0, 0);
+	winlink_set_window(wl, w);
+	options_set_number(w->options, "automatic-rename", 0);
+	window_set_name(w, name);
+	return (w);
+}
+
+/*
+ * Bring one window up to date with its pane list from the server: create
+ * new panes, move panes from other windows, close panes that are gone and
+ * apply the layout. Only new panes have their contents fetched.
+ */
+static void
+remote_sync_window_done(struct remote *r, struct remote_query *q)
+{
+	struct remote_window_ctx *ctx = (struct remote_window_ctx *)q;
+	struct evbuffer		*reply = r->reply_buffer;
+	struct client_window	*cw;
+	struct client_pane	*cp;
+	struct window		*w = NULL;
+	struct window_pane	*wp, *active = NULL;
+	struct remote_pane_info	 pi;
+	size_t			 n_read_out;
+	u_int			 n = 0;
+	char			*line, *iter, *layout = NULL;
+
+	if (r->session == NULL)
+		return;
+	cw = RB_FIND(client_windows, &r->windows,
+	    &(struct client_window){ .window = ctx->window_id });
+	if (cw != NULL) {
+		if (cw->pane == NULL)
+			return; /* closed */
+		w = cw->pane->window;
+	}
+
+	while ((line = evbuffer_peek_string(reply, &n_read_out)) != NULL) {
+		iter = line;
+		remote_parse_pane(&iter, &pi);
+		free(layout);
+		layout = xstrdup(strsep(&iter, "\t"));
+		if (w == NULL)
+			w = remote_new_window(r, &pi, iter == NULL ? "" : iter);
+
+		cp = remote_find_pane(r, pi.pane_id);
+		if (cp == NULL) {
+			wp = window_add_pane(w, NULL, pi.hlimit,
+			    SPAWN_FULLSIZE);
+			if (w->layout_root == NULL)
+				layout_init(w, wp);
+			cp = remote_new_pane(r, &r->panes, wp, &pi);
+			remote_sync_pane(r, cp, REMOTE_HISTORY_TAIL, 1);
+		} else if (cp->cw.pane->window != w)
+			remote_move_pane(r, cp->cw.pane, w);
+		wp = cp->cw.pane;
+		if (pi.active)
+			active = wp;
+
+		/* Listed panes end up at the back in server order. */
+		TAILQ_REMOVE(&w->panes, wp, entry);
+		TAILQ_INSERT_TAIL(&w->panes, wp, entry);
+		n++;
+
+		evbuffer_drain(reply, n_read_out);
+	}
+	if (w == NULL || n == 0)
+		return;
+
+	while (window_count_panes(w) > n)
+		remote_close_pane(r, TAILQ_FIRST(&w->panes));
+
+	if (cw == NULL) {
+		cw = xcalloc(1, sizeof *cw);
+		cw->window = ctx->window_id;
+		RB_INSERT(client_windows, &r->windows, cw);
+	}
+	cw->pane = TAILQ_FIRST(&w->panes);
+	if (active != NULL)
+		w->active = active;
+
+	if (layout != NULL && remote_apply_layout(r, w, layout) != 0) {
+		remote_log(r, "window @%u: bad layout: %s", ctx->window_id,
+		    layout);
+		server_redraw_window(w);
+	}
+	free(layout);
+
+	server_status_session(r->session);
+	bufferevent_flush(r->event, EV_WRITE, BEV_FLUSH);
+}
+
+static void
+remote_sync_window_error(struct remote *r, struct remote_query *q)
+{
+	struct remote_window_ctx *ctx = (struct remote_window_ctx *)q;
+
+	remote_log(r, "window @%u: sync failed", ctx->window_id);
+}
+
+/* Ask the server for the panes of a window that changed. */
+static void
+remote_sync_window(struct remote *r, u_int window_id)
+{
+	struct remote_window_ctx *ctx;
+
+	if (r->session == NULL)
+		return;
+	log_debug("%s: @%u", __func__, window_id);
+
+	ctx = xcalloc(1, sizeof *ctx);
+	ctx->q.command = "sync-window";
+	ctx->q.done = remote_sync_window_done;
+	ctx->q.error = remote_sync_window_error;
+	ctx->window_id = window_id;
+	remote_run(r, &ctx->q, "list-panes -t @%u -F \"%s\"\n", window_id,
+	    REMOTE_PANE_FORMAT "\t#{window_layout}\t#{window_name}");
+	bufferevent_flush(r->event, EV_WRITE, BEV_FLUSH);
+}
 
-		evbuffer_drain(reply, n_read_out);
+/*
+ * Put the panes of a window in the order of the layout and apply it. Fails
+ * if the layout does not have exactly the panes the window has.
+ */
+static int
+remote_apply_layout(struct remote *r, struct window *w, const char *layout)
+{
+	struct client_pane	*cp;
+	struct window_pane	*wp;
+	const char		*p;
+	char			*end, *cause = NULL;
+	u_int			 n = 0, id;
+
+	if ((p = strchr(layout, ',')) == NULL)
+		return (-1);
+	p++;
+
+	/* Each cell is WxH,X,Y followed by ,ID for a pane or { or [. */
+	while (*p != '\0') {
+		strtoul(p, &end, 10);
+		if (*end != 'x')
+			return (-1);
+		strtoul(end + 1, &end, 10);
+		if (*end != ',')
+			return (-1);
+		strtoul(end + 1, &end, 10);
+		if (*end != ',')
+			return (-1);
+		strtoul(end + 1, &end, 10);
+		if (*end == ',') {
+			id = strtoul(end + 1, &end, 10);
+			if ((cp = remote_find_pane(r, id)) == NULL)
+				return (-1);
+			wp = cp->cw.pane;
+			if (wp->window != w)
+				return (-1);
+			TAILQ_REMOVE(&w->panes, wp, entry);
+			TAILQ_INSERT_TAIL(&w->panes, wp, entry);
+			n++;
+		}
+		p = end;
+		while (*p != '\0' && strchr("{}[],", *p) != NULL)
+			p++;
+	}
+	if (n != window_count_panes(w))
+		return (-1);
+
+	if (layout_parse(w, layout, &cause) != 0) {
+		remote_log(r, "window @%u: bad layout: %s", w->id, cause);
+		free(cause);
+		return (-1);
 	}
+	server_redraw_window(w);
+	return (0);
 }
 
+/* Keep the mirrored session when the control stream is lost. */
 static void
-remote_populate_history(struct remote *r, struct remote_bootstrap_ctx *ctx)
+remote_orphan(struct remote *r)
 {
-	struct evbuffer	   *reply = r->reply_buffer;
-	struct evbuffer	   *history = evbuffer_new();
-	struct client_pane *cp = container_of(ctx->cw, struct client_pane, cw);
-	struct window_pane *wp = ctx->cw->pane;
-	struct grid *tmp;
-	size_t		    len, n_read_out;
-	char		   *text;
+	struct remote_orphan	*o;
+	struct client_window	*cw;
+	struct client_pane	*cp;
+	struct remote_predict	*rp;
+	struct window_pane	*wp;
+	struct grid		*gd;
 
-	remote_log(r, "populate_history %%%u", ctx->cw->window);
-
-	while ((text = evbuffer_peek_string(reply, &n_read_out))) {
-		len = output_unescape(text, text);
-		evbuffer_remove_buffer(reply, history, len);
-		evbuffer_drain(reply, n_read_out - len);
-		if (evbuffer_get_length(reply))
-			evbuffer_add(history, "\r\n", 2);
+	RB_FOREACH(cw, client_windows, &r->panes) {
+		if ((wp = cw->pane) == NULL)
+			continue;
+		cp = container_of(cw, struct client_pane, cw);
+
+		gd = wp->base.grid;
+		TAILQ_FOREACH(rp, &cp->predictions, entry) {
+			if (rp->drawn && rp->y >= gd->hsize &&
+			    rp->y < gd->hsize + gd->sy)
+				remote_predict_draw(wp, rp->x, rp->y, &rp->saved);
+		}
+		remote_predict_free(cp);
+		cp->flags = REMOTE_PANE_UNSURE;
+		bufferevent_disable(cp->event, EV_READ);
 	}
 
-	text = EVBUFFER_DATA(history);
-	len = EVBUFFER_LENGTH(history);
+	o = xcalloc(1, sizeof *o);
+	o->session_id = r->session_id;
+	o->session = r->session;
+	o->windows = r->windows;
+	o->panes = r->panes;
+	TAILQ_INSERT_TAIL(&remote_orphans, o, entry);
+	log_debug("%s: keeping session %s", __func__, o->session->name);
 
-	if (cp->alt) {
-		wp->screen->saved_grid = wp->screen->grid;
-		wp->screen->grid = grid_create(
-		    screen_size_x(wp->screen), screen_size_y(wp->screen), 0);
+	session_add_ref(o->session, __func__);
+	o->session->remote = NULL;
+	r->session = NULL;
+	RB_INIT(&r->windows);
+	RB_INIT(&r->panes);
+}
 
-		input_parse_buffer(wp, text, len);
+/* Stop forwarding keys for a kept pane. */
+static void
+remote_orphan_close_pane(struct client_pane *cp)
+{
+	void	*arg;
 
-		tmp = wp->screen->saved_grid;
-		wp->screen->saved_grid = wp->screen->grid;
-		wp->screen->grid = tmp;
-	} else {
-		input_parse_buffer(wp, text, len);
+	if (cp->event != NULL) {
+		bufferevent_getcb(cp->event, NULL, NULL, NULL, &arg);
+		free(arg);
+		bufferevent_free(cp->event);
+		cp->event = NULL;
 	}
+	cp->cw.pane = NULL; /* tombstone */
+}
 
-	evbuffer_free(history);
+/* Forget a kept session, destroying it if it still exists. */
+static void
+remote_orphan_free(struct remote_orphan *o)
+{
+	struct client_window	*cw, *cw1;
+	struct client_pane	*cp;
+
+	RB_FOREACH_SAFE(cw, client_windows, &o->panes, cw1) {
+		RB_REMOVE(client_windows, &o->panes, cw);
+		cp = container_of(cw, struct client_pane, cw);
+		remote_orphan_close_pane(cp);
+		free(cp);
+	}
+	RB_FOREACH_SAFE(cw, client_windows, &o->windows, cw1) {
+		RB_REMOVE(client_windows, &o->windows, cw);
+		free(cw);
+	}
 
+	if (session_alive(o->session))
+		session_destroy(o->session, 1, __func__);
+	session_remove_ref(o->session, __func__);
+	TAILQ_REMOVE(&remote_orphans, o, entry);
+	free(o);
+}
 
-	if (cp->alt) {
-		ctx->cw = RB_NEXT(client_windows, &r->panes, ctx->cw);
-		wp->base.cx = cp->init_cx;
-		wp->base.cy = cp->init_cy;
-	} else {
-		cp->alt = 1;
+static int
+remote_session_has_pane(struct session *s, struct window_pane *wp)
+{
+	struct winlink		*wl;
+	struct window_pane	*loop;
+
+	RB_FOREACH(wl, winlinks, &s->windows) {
+		TAILQ_FOREACH(loop, &wl->window->panes, entry) {
+			if (loop == wp)
+				return (1);
+		}
 	}
+	return (0);
 }
 
-static void
-remote_request_history(struct remote *r, struct remote_query *q, struct remote_bootstrap_ctx *ctx)
+/*
+ * Take over a kept session if it is the one just attached to, and start
+ * bringing it up to date. Panes and windows closed locally in the meantime
+ * are forgotten so they are created again. Returns 1 if the session was
+ * adopted.
+ */
+static int
+remote_adopt(struct remote *r, u_int session_id, const char *name)
 {
-	struct client_window	    *cw = NULL;
+	struct remote_orphan	 *o, *o1;
+	struct remote_resync_ctx *ctx;
+	struct session		 *s;
+	struct client_window	 *cw, *cw1;
+	struct client_pane	 *cp;
+	struct remote_input_ctx	 *rictx;
+	void			 *arg;
+
+	TAILQ_FOREACH_SAFE(o, &remote_orphans, entry, o1) {
+		if (!session_alive(o->session))
+			remote_orphan_free(o);
+	}
+	TAILQ_FOREACH(o, &remote_orphans, entry) {
+		if (strcmp(o->session->name, name) == 0)
+			break;
+	}
+	if (o == NULL)
+		return (0);
+	if (o->session_id != session_id) {
+		remote_orphan_free(o);
+		return (0);
+	}
+	s = o->session;
+	remote_log(r, "resync session %s", s->name);
+
+	RB_FOREACH(cw, client_windows, &o->panes) {
+		if (cw->pane == NULL)
+			continue;
+		cp = container_of(cw, struct client_pane, cw);
+		if (!remote_session_has_pane(s, cw->pane)) {
+			remote_orphan_close_pane(cp);
+			continue;
+		}
 
-	ctx->cw = RB_MIN(client_windows, &ctx->panes);
-	RB_FOREACH(cw, client_windows, &ctx->panes) {
-		remote_run(r, q,
-		    "capture-pane -peqCJN -S -%u -t %%%u ; ",
-		    screen_hlimit(&cw->pane->base), cw->window);
-		remote_run(r, q,
-		    "capture-pane -apeqCJN -S -%u -t %%%u\n",
-		    screen_hlimit(&cw->pane->base), cw->window);
+		/* Keys typed while disconnected are dropped, not sent blind. */
+		bufferevent_getcb(cp->event, NULL, NULL, NULL, &arg);
+		rictx = arg;
+		rictx->r = r;
+		evbuffer_drain(cp->event->input, EV_SIZE_MAX);
+		evbuffer_drain(cw->pane->event->output, EV_SIZE_MAX);
+		bufferevent_enable(cp->event, EV_READ);
+	}
+	RB_FOREACH_SAFE(cw, client_windows, &o->windows, cw1) {
+		if (cw->pane != NULL && !remote_session_has_pane(s, cw->pane)) {
+			RB_REMOVE(client_windows, &o->windows, cw);
+			free(cw);
+		}
 	}
+
+	r->session_id = session_id;
+	r->session = s;
+	r->windows = o->windows;
+	r->panes = o->panes;
+	s->remote = r;
+	session_remove_ref(s, __func__);
+	TAILQ_REMOVE(&remote_orphans, o, entry);
+	free(o);
+
+	ctx = xcalloc(1, sizeof *ctx);
+	ctx->q.command = "resync";
+	ctx->q.done = remote_resync_next;
+	ctx->q.error = remote_resync_error;
+	ctx->session = s;
+	remote_run(r, &ctx->q, "list-windows -t $%u -F \"%s\"\n", session_id,
+	    "#{window_id}\t#{?window_active,1,0}\t#{window_name}");
 	bufferevent_flush(r->event, EV_WRITE, BEV_FLUSH);
+	return (1);
 }
 
+/*
+ * Bring the windows of a kept session up to date. Each is synchronized as if
+ * it had changed, which only fetches panes that are new. The panes are then
+ * listed once all windows are done.
+ */
 static void
-remote_bootstrap_next(struct remote *r, struct remote_query *q)
+remote_resync_windows(struct remote *r, struct remote_resync_ctx *ctx)
 {
-	struct options		    *oo;
-	struct remote_bootstrap_ctx *ctx;
+	struct evbuffer		*reply = r->reply_buffer;
+	struct client_window	*cw;
+	struct window		*w;
+	size_t			 n_read_out;
+	u_int			 id;
+	const char		*name;
+	char			*line, *iter;
 
-	ctx = (struct remote_bootstrap_ctx*) q;
+	while ((line = evbuffer_peek_string(reply, &n_read_out)) != NULL) {
+		iter = line;
+		id = atol(strsep(&iter, "\t") + /*@*/1);
+		if (atoi(strsep(&iter, "\t")))
+			ctx->active = id;
+		name = (iter == NULL) ? "" : iter;
 
-	remote_log(r, "bootstrap_next from state = %u", ctx->state);
+		ctx->ids = xreallocarray(ctx->ids, ctx->nids + 1,
+		    sizeof *ctx->ids);
+		ctx->ids[ctx->nids++] = id;
 
-	switch (ctx->state++) {
-	case 0:
-		remote_show_environment(r, ctx->env, 0);
-		break;
-	case 1:
-		remote_show_environment(r, ctx->env, ENVIRON_HIDDEN);
-		oo = options_create(global_s_options);
-		ctx->session = session_create(
-		    NULL, ctx->session_name, "/tmp", ctx->env, oo, NULL);
-		ctx->session->remote = r;
-		break;
-	case 2:
-		remote_add_panes(r, ctx);
-		remote_request_history(r, q, ctx);
-		break;
-	case 3:
-		remote_fix_windows(r, ctx);
-		break;
-	default:
-		remote_populate_history(r, ctx);
-		break;
+		cw = RB_FIND(client_windows, &r->windows,
+		    &(struct client_window){ .window = id });
+		if (cw != NULL && cw->pane != NULL) {
+			w = cw->pane->window;
+			if (strcmp(w->name, name) != 0)
+				window_set_name(w, name);
+		}
+		remote_sync_window(r, id);
+
+		evbuffer_drain(reply, n_read_out);
 	}
 
-	if (q->arity == 1) {
-		remote_log(r, "bootstrap finished");
+	remote_run(r, &ctx->q, "list-panes -st $%u -F \"%s\"\n", r->session_id,
+	    REMOTE_RESYNC_FORMAT);
+}
 
-		/* commit */
-		r->session_id = ctx->session_id;
-		r->session = ctx->session;
-		r->windows = ctx->windows;
-		r->panes = ctx->panes;
+/*
+ * Decide how much of a kept pane to fetch. A pane with the same checksum and
+ * no new history is left alone. If the history has grown by a known number
+ * of lines, only those lines and the screen are fetched; otherwise the
+ * history is replaced by its last lines as when attaching.
+ */
+static void
+remote_resync_pane(struct remote *r, struct client_pane *cp,
+    struct remote_resync_info *ri)
+{
+	struct screen	*s = &cp->cw.pane->base;
+	struct grid	*gd = s->grid;
+	u_int		 known, csum;
+	char		*end;
+	int		 same;
+
+	known = gd->hsize + remote_pane_missing(cp);
+	if (known > ri->hlimit)
+		known = ri->hlimit;
+	csum = strtoul(ri->checksum, &end, 10);
+	same = (*ri->checksum != '\0' && *end == '\0' &&
+	    csum == grid_checksum(gd, gd->hsize, screen_size_y(s)));
+
+	if (same && ri->hsize == known) {
+		log_debug("%s: %%%u: unchanged", __func__, ri->pane_id);
+		return;
+	}
+	if (ri->hsize >= known && ri->hsize < ri->hlimit &&
+	    ri->hsize - known <= REMOTE_HISTORY_CHUNK) {
+		log_debug("%s: %%%u: %u new lines", __func__, ri->pane_id,
+		    ri->hsize - known);
+		remote_sync_pane(r, cp, ri->hsize - known, 0);
+		return;
+	}
+	log_debug("%s: %%%u: fetching again", __func__, ri->pane_id);
+	if (ri->hsize > REMOTE_HISTORY_TAIL)
+		cp->hmissing = ri->hsize - REMOTE_HISTORY_TAIL;
+	else
+		cp->hmissing = 0;
+	remote_sync_pane(r, cp, REMOTE_HISTORY_TAIL, 1);
+}
 
-		server_redraw_session(r->session);
+/* Close windows that are gone and fetch panes that have changed. */
+static void
+remote_resync_panes(struct remote *r, struct remote_resync_ctx *ctx)
+{
+	struct evbuffer			*reply = r->reply_buffer;
+	struct client_window		*cw, *cw1;
+	struct client_pane		*cp;
+	struct remote_resync_info	 ri;
+	size_t				 n_read_out;
+	u_int				 i;
+	char				*line, *iter;
+
+	RB_FOREACH_SAFE(cw, client_windows, &r->windows, cw1) {
+		if (cw->pane == NULL)
+			continue;
+		for (i = 0; i < ctx->nids; i++) {
+			if (ctx->ids[i] == cw->window)
+				break;
+		}
+		if (i == ctx->nids)
+			remote_window_close(r, cw->window);
+	}
+
+	while ((line = evbuffer_peek_string(reply, &n_read_out)) != NULL) {
+		iter = line;
+		ri.pane_id = atol(strsep(&iter, "\t") + /*%*/1);
+		ri.hsize = atol(strsep(&iter, "\t"));
+		ri.hlimit = atol(strsep(&iter, "\t"));
+		ri.checksum = (iter == NULL) ? "" : iter;
+
+		cp = remote_find_pane(r, ri.pane_id);
+		if (cp != NULL && (~cp->flags & REMOTE_PANE_SYNCING))
+			remote_resync_pane(r, cp, &ri);
+
+		evbuffer_drain(reply, n_read_out);
 	}
+
+	if (ctx->active != 0)
+		remote_session_window_changed(r, r->session_id, ctx->active);
+	server_redraw_session(r->session);
+	remote_input_schedule(r);
+	bufferevent_flush(r->event, EV_WRITE, BEV_FLUSH);
 }
 
 static void
-remote_bootstrap_error(struct remote *r, struct remote_query *q)
+remote_resync_next(struct remote *r, struct remote_query *q)
 {
-	struct evbuffer *reply = r->reply_buffer;
-	const char *msg = evbuffer_peek_string(reply, NULL);
-	remote_log(r, "bootstrap failed: %s: %s", q->command, msg);
+	struct remote_resync_ctx *ctx = (struct remote_resync_ctx *)q;
+
+	if (r->session == ctx->session) {
+		switch (ctx->state) {
+		case 0:
+			remote_resync_windows(r, ctx);
+			break;
+		case 1:
+			remote_resync_panes(r, ctx);
+			break;
+		}
+	}
+	ctx->state++;
+	if (q->arity == 1)
+		free(ctx->ids);
 }
 
-/* The attached session was changed. */
 static void
-remote_session_changed(struct remote *r, u_int session_id, char *name)
+remote_resync_error(struct remote *r, struct remote_query *q)
 {
-	struct remote_bootstrap_ctx *ctx;
+	struct remote_resync_ctx *ctx = (struct remote_resync_ctx *)q;
 
-	if (r->session)
-		session_destroy(r->session, 1, __func__);
+	remote_log(r, "resync failed: %s", q->command);
+	ctx->state++;
+	if (q->arity == 1)
+		free(ctx->ids);
+}
 
-	ctx = xcalloc(1, sizeof *ctx);
-	ctx->q.command = "bootstrap";
-	ctx->q.done = remote_bootstrap_next;
-	ctx->q.error = remote_bootstrap_error;
-	ctx->env = environ_create();
-	ctx->session_id = session_id;
-	ctx->session_name = xstrdup(name);
-	RB_INIT(&ctx->windows);
-	RB_INIT(&ctx->panes);
+/* Replaces %output when flow control is enabled. */
+static void
+remote_extended_output(struct remote *r, u_int pane_id, uint64_t age,
+    char *data)
+{
+	struct client_pane *cp;
 
-	/* XXX: reset inflight requests? */
-	/* XXX: set timer? */
-	remote_run(r, &ctx->q, "show-environment -t $%u;", session_id);
-	remote_run(r, &ctx->q, "show-environment -ht $%u;", session_id);
-	remote_run(r, &ctx->q, "list-panes -st $%u -F \"%s\";", session_id,
-	    "#{window_id}\t"
-	    "#{window_index}\t"
-	    "#{window_width}\t"
-	    "#{window_height}\t"
-	    "#{pane_id}\t"
-	    "#{pane_index}\t"
-	    "#{pane_active}\t"
-	    "#{cursor_x}\t"
-	    "#{cursor_y}\t"
-	    "#{history_limit}");
-	remote_run(r, &ctx->q, "list-windows -t $%u -F \"%s\";", session_id,
-	    "#{window_id}\t"
-	    "#{window_name}\t"
-	    "#{window_layout}\t"
-	    "#{window_flags}\t"
-	    "#{?window_active,1,0}");
+	if ((cp = remote_find_pane(r, pane_id)) == NULL) {
+		remote_log(r, "%s: no such pane: %u", __func__, pane_id);
+		return;
+	}
+	cp->age = age;
+	remote_pane_write(r, cp, data);
+}
 
-	/* iterm: */
-	/* kStateDictPaneId, kStateDictSavedGrid,
-	   kStateDictAltSavedCX, kStateDictAltSavedCY, kStateDictCursorX,
-	   kStateDictCursorY, kStateDictScrollRegionUpper,
-	   kStateDictScrollRegionLower,
-	   kStateDictTabstops, kStateDictCursorMode, kStateDictInsertMode,
-           kStateDictKCursorMode,
-	   kStateDictKKeypadMode, kStateDictWrapMode,
-	   kStateDictMouseStandardMode,
-	   kStateDictMouseButtonMode, kStateDictMouseAnyMode,
-	   kStateDictMouseUTF8Mode, kStateDictMouseSGRMode ];
-	*/
+/* A pane fell too far behind and the server stopped sending its output. */
+static void
+remote_pause(struct remote *r, u_int pane_id)
+{
+	struct client_pane *cp;
 
-	/* show-options -g */
-	bufferevent_write(r->event, "\n", 1);
-	bufferevent_flush(r->event, EV_WRITE, BEV_FLUSH);
+	if ((cp = remote_find_pane(r, pane_id)) == NULL)
+		return;
+	cp->flags &= ~REMOTE_PANE_PAUSING;
+	cp->flags |= REMOTE_PANE_PAUSED;
+	remote_flow_schedule(r, 1);
 }
 
-/* Replaces %output when flow control is enabled. */
+/* A paused pane was continued. */
 static void
-remote_extended_output(struct remote *r, u_int, uint64_t, char *)
+remote_continue(struct remote *r, u_int pane_id)
 {
+	struct client_pane *cp;
+
+	if ((cp = remote_find_pane(r, pane_id)) == NULL)
+		return;
+	cp->flags &= ~REMOTE_PANE_PAUSED;
+	cp->age = 0;
 }
 
 /* A pane's mode was changed. */
@@ -815,6 +3169,19 @@ remote_pane_mode_changed(struct remote *r, u_int pane_id)
 static void
 remote_window_renamed(struct remote *r, u_int window_id, char *new_name)
 {
+	struct client_window	*cw;
+	struct window		*w;
+
+	cw = RB_FIND(client_windows, &r->windows,
+	    &(struct client_window){ .window = window_id });
+	if (cw == NULL || cw->pane == NULL)
+		return;
+	w = cw->pane->window;
+
+	options_set_number(w->options, "automatic-rename", 0);
+	window_set_name(w, new_name);
+	server_redraw_window_borders(w);
+	server_status_window(w);
 }
 
 /* A window was renamed in another session. */
@@ -827,6 +3194,25 @@ remote_unlinked_window_renamed(struct remote *r, u_int window_id, char *new_name
 static void
 remote_session_renamed(struct remote *r, u_int session_id, char *new_name)
 {
+	struct session	*s = r->session;
+	char		*name;
+
+	if (s == NULL || session_id != r->session_id)
+		return;
+	if ((name = session_check_name(new_name)) == NULL)
+		return;
+	if (strcmp(name, s->name) == 0 || session_find(name) != NULL) {
+		free(name);
+		return;
+	}
+
+	RB_REMOVE(sessions, &sessions, s);
+	free(s->name);
+	s->name = name;
+	RB_INSERT(sessions, &sessions, s);
+
+	server_status_session(s);
+	notify_session("session-renamed", s);
 }
 
 /* Another client's attached session was changed. */
@@ -848,7 +3234,7 @@ remote_window_pane_changed(struct remote *r, u_int window_id, u_int pane_id)
 	cw = RB_FIND(client_windows, &r->windows,
 	    &(struct client_window){ .window = window_id });
 
-	if (cp == NULL || cw == NULL) {
+	if (cp == NULL || cw == NULL || cp->pane == NULL || cw->pane == NULL) {
 		remote_log(
 		    r, "%s %u %u: no such pane", __func__, window_id, pane_id);
 		return;
@@ -864,17 +3250,41 @@ remote_window_pane_changed(struct remote *r, u_int window_id, u_int pane_id)
 		    __func__, window_id, pane_id);
 }
 
+/* A window's layout changed, maybe because panes were added or closed. */
+static void
+remote_layout_change(struct remote *r, u_int window_id, char *layout)
+{
+	struct client_window	*cw;
+
+	cw = RB_FIND(client_windows, &r->windows,
+	    &(struct client_window){ .window = window_id });
+	if (cw != NULL && cw->pane == NULL)
+		return;
+	if (cw == NULL || remote_apply_layout(r, cw->pane->window, layout) != 0)
+		remote_sync_window(r, window_id);
+}
+
+/* A format subscribed to with refresh-client -B changed. */
+static void
+remote_subscription_changed(__unused struct remote *r, char *name,
+    char *value)
+{
+	log_debug("%s: %s %s", __func__, name, value);
+}
+
 /* A window was closed in the attached session. */
 static void
 remote_window_close(struct remote *r, u_int window_id)
 {
 	struct client_window *cw;
 	struct window	     *w;
+	struct window_pane   *wp;
+	int		      last;
 
 	cw = RB_FIND(client_windows, &r->windows,
 	    &(struct client_window){.window = window_id});
 
-	if (cw == NULL) {
+	if (cw == NULL || cw->pane == NULL) {
 		remote_log(r, "%s: window @%u not found", __func__, window_id);
 		return;
 	}
@@ -882,24 +3292,34 @@ remote_window_close(struct remote *r, u_int window_id)
 	w = cw->pane->window;
 	cw->pane = NULL; /* tombstone */
 
-	RB_FOREACH(cw, client_windows, &r->panes) {
-		if (cw->pane->window == w) {
-			server_kill_pane(cw->pane);
-			cw->pane = NULL; /* tombstone */
-		}
-	}
+	/* Killing the last pane also kills the window. */
+	do {
+		wp = TAILQ_FIRST(&w->panes);
+		last = (TAILQ_NEXT(wp, entry) == NULL);
+		remote_close_pane(r, wp);
+	} while (!last);
 }
 
-/* A window was closed in another session. */
+/*
+ * A window was closed in another session. The server also sends this for
+ * windows in the attached session if they are unlinked before being closed.
+ */
 static void
-remote_unlinked_window_close(__unused struct remote *r, __unused u_int window_id)
+remote_unlinked_window_close(struct remote *r, u_int window_id)
 {
+	struct client_window *cw;
+
+	cw = RB_FIND(client_windows, &r->windows,
+	    &(struct client_window){.window = window_id});
+	if (cw != NULL && cw->pane != NULL)
+		remote_window_close(r, window_id);
 }
 
 /* A window was added to the attached session. */
 static void
 remote_window_add(struct remote *r, u_int window_id)
 {
+	remote_sync_window(r, window_id);
 }
 
 /* A window was added to another session. */
@@ -928,6 +3348,7 @@ remote_session_window_changed(struct remote *r, u_int session_id, u_int window_i
 	wl = TAILQ_FIRST(&cw->pane->window->winlinks);
 	session_sync_current(r->session, wl);
 	server_redraw_session(r->session);
+	remote_flow_schedule(r, 0);
 }
 
 /* A session was created or destroyed. */
@@ -939,36 +3360,43 @@ remote_sessions_changed(__unused struct remote *r)
 void
 remote_notify_window_pane_changed(struct remote *r, struct window *w)
 {
-	struct remote_query  *q;
 	struct client_window *cw = NULL;
 
 	RB_FOREACH(cw, client_windows, &r->panes) {
 		if (cw->pane == w->active)
 			break;
 	}
+	if (cw == NULL)
+		return;
 
 	remote_log(r, "select-pane -t %%%u", cw->window);
 
-	q = xcalloc(1, sizeof *q);
-	remote_run(r, q, "select-pane -t %%%u\n", cw->window);
+	/* Only the last pane selected matters if several are waiting. */
+	remote_run_latest(r, "select-pane", "select-pane -t %%%u\n",
+	    cw->window);
 	bufferevent_flush(r->event, EV_WRITE, BEV_FLUSH);
 }
 
 void
 remote_notify_session_window_changed(struct remote *r)
 {
-	struct remote_query  *q;
 	struct client_window *cw = NULL;
 
 	RB_FOREACH(cw, client_windows, &r->windows) {
-		if (cw->pane->window == r->session->curw->window)
+		if (cw->pane != NULL &&
+		    cw->pane->window == r->session->curw->window)
 			break;
 	}
+	if (cw == NULL)
+		return;
 
-	q = xcalloc(1, sizeof *q);
-	remote_run(r, q, "select-window -t @%u\n", cw->window);
+	remote_run_latest(r, "select-window", "select-window -t @%u\n",
+	    cw->window);
 	remote_log(r, "select-window -t @%u", cw->window);
 	bufferevent_flush(r->event, EV_WRITE, BEV_FLUSH);
+
+	/* Panes held back in the old window may now be visible. */
+	remote_flow_schedule(r, 0);
 }
 
 void
@@ -979,15 +3407,36 @@ remote_notify_window_layout_changed(struct remote *r, struct window *w)
 static void
 remote_exit(struct remote *r)
 {
-	session_destroy(r->session, 1, __func__);
+	if (r->session != NULL)
+		session_destroy(r->session, 1, __func__);
 	r->session = NULL;
 }
 
 void
 remote_destroy(struct remote *r)
 {
+	struct remote_line	*rl;
+
+	while ((rl = TAILQ_FIRST(&r->sent)) != NULL) {
+		if (rl->q != NULL)
+			remote_cancel(r, rl->q);
+		else {
+			TAILQ_REMOVE(&r->sent, rl, entry);
+			free(rl);
+		}
+	}
+	while ((rl = TAILQ_FIRST(&r->waiting)) != NULL)
+		remote_cancel(r, rl->q);
+
+	evtimer_del(&r->input_timer);
+	evtimer_del(&r->flow_timer);
+	evtimer_del(&r->query_timer);
+	evtimer_del(&r->predict_timer);
 	evbuffer_free(r->line_buffer);
 	evbuffer_free(r->reply_buffer);
 	bufferevent_free(r->event);
-	session_destroy(r->session, 1, __func__);
+
+	/* Without %exit the stream was lost, so keep the session. */
+	if (r->session != NULL)
+		remote_orphan(r);
 }
@@ -741,7 +741,7 @@ screen_redraw_draw_borders_cell(struct screen_redraw_ctx *ctx, u_int i, u_int j)
 	struct grid_cell	 gc;
 	const struct grid_cell	*tmp;
 	struct overlay_ranges	 r;
-	u_int			 cell_type, x = ctx->ox + i, y = ctx->oy + j;
+	u_int			 cell_type, x = ctx->ox + i, y = ctx->oy + j, yt;
 	int			 arrows = 0, border, isolates;
 
 	if (c->overlay_check != NULL) {
@@ -783,13 +783,6 @@ screen_redraw_draw_borders_cell(struct screen_redraw_ctx *ctx, u_int i, u_int j)
 	else
 		isolates = 0;
 
-	if (ctx->statustop)
-		tty_cursor(tty, i, ctx->statuslines + j);
-	else
-		tty_cursor(tty, i, j);
-	if (isolates)
-		tty_puts(tty, END_ISOLATE);
-
 	switch (options_get_number(oo, "pane-border-indicators")) {
 	case PANE_BORDER_ARROWS:
 	case PANE_BORDER_BOTH:
@@ -817,6 +810,16 @@ screen_redraw_draw_borders_cell(struct screen_redraw_ctx *ctx, u_int i, u_int j)
 		}
 	}
 
+	if (ctx->statustop)
+		yt = ctx->statuslines + j;
+	else
+		yt = j;
+	if (tty_cell_shown(tty, i, yt, &gc, &grid_default_cell, NULL))
+		return;
+
+	tty_cursor(tty, i, yt);
+	if (isolates)
+		tty_puts(tty, END_ISOLATE);
 	tty_cell(tty, &gc, &grid_default_cell, NULL, NULL);
 	if (isolates)
 		tty_puts(tty, START_ISOLATE);
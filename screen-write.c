@@ -34,12 +34,16 @@ static int	screen_write_overwrite(struct screen_write_ctx *,
 		    struct grid_cell *, u_int);
 static int	screen_write_combine(struct screen_write_ctx *,
 		    const struct grid_cell *);
+static int	screen_write_collect_utf8(struct screen_write_ctx *,
+		    const struct grid_cell *);
+static void	screen_write_collect_upgrade(struct screen_write_ctx *);
 
 struct screen_write_citem {
 	u_int				x;
 	int				wrapped;
 
 	enum { TEXT, CLEAR }		type;
+	int				utf8;
 	u_int				used;
 	u_int				bg;
 
@@ -49,6 +53,7 @@ struct screen_write_citem {
 };
 struct screen_write_cline {
 	char				*data;
+	utf8_char			*udata; /* 0 for padding */
 	TAILQ_HEAD(, screen_write_citem) items;
 };
 TAILQ_HEAD(, screen_write_citem)  screen_write_citem_freelist =
@@ -154,6 +159,15 @@ screen_write_set_client_cb(struct tty_ctx *ttyctx, struct client *c)
 		wp->flags |= (PANE_REDRAW|PANE_REDRAWSCROLLBAR);
 		return (-1);
 	}
+	if (server_client_start_frame(c)) {
+		/*
+		 * Too soon after the last update - redraw this pane with the
+		 * next frame instead.
+		 */
+		log_debug("%s: leaving %%%u for next frame", __func__, wp->id);
+		wp->flags |= (PANE_REDRAW|PANE_REDRAWSCROLLBAR);
+		return (-1);
+	}
 
 	ttyctx->bigger = tty_window_offset(&c->tty, &ttyctx->wox, &ttyctx->woy,
 	    &ttyctx->wsx, &ttyctx->wsy);
@@ -240,8 +254,10 @@ screen_write_free_list(struct screen *s)
 {
 	u_int	y;
 
-	for (y = 0; y < screen_size_y(s); y++)
+	for (y = 0; y < screen_size_y(s); y++) {
 		free(s->write_list[y].data);
+		free(s->write_list[y].udata);
+	}
 	free(s->write_list);
 }
 
@@ -1711,6 +1727,7 @@ screen_write_collect_trim(struct screen_write_ctx *ctx, u_int y, u_int x,
 		    csx, cex, sx, ex);
 		ci2 = screen_write_get_citem();
 		ci2->type = ci->type;
+		ci2->utf8 = ci->utf8;
 		ci2->bg = ci->bg;
 		memcpy(&ci2->gc, &ci->gc, sizeof ci2->gc);
 		TAILQ_INSERT_AFTER(&cl->items, ci, ci2, entry);
@@ -1749,6 +1766,7 @@ screen_write_collect_scroll(struct screen_write_ctx *ctx, u_int bg)
 	struct screen_write_cline	*cl;
 	u_int				 y;
 	char				*saved;
+	utf8_char			*usaved;
 	struct screen_write_citem	*ci;
 
 	log_debug("%s: at %u,%u (region %u-%u)", __func__, s->cx, s->cy,
@@ -1756,12 +1774,15 @@ screen_write_collect_scroll(struct screen_write_ctx *ctx, u_int bg)
 
 	screen_write_collect_clear(ctx, s->rupper, 1);
 	saved = ctx->s->write_list[s->rupper].data;
+	usaved = ctx->s->write_list[s->rupper].udata;
 	for (y = s->rupper; y < s->rlower; y++) {
 		cl = &ctx->s->write_list[y + 1];
 		TAILQ_CONCAT(&ctx->s->write_list[y].items, &cl->items, entry);
 		ctx->s->write_list[y].data = cl->data;
+		ctx->s->write_list[y].udata = cl->udata;
 	}
 	ctx->s->write_list[s->rlower].data = saved;
+	ctx->s->write_list[s->rlower].udata = usaved;
 
 	ci = screen_write_get_citem();
 	ci->x = 0;
@@ -1821,9 +1842,14 @@ screen_write_collect_flush(struct screen_write_ctx *ctx, int scroll_only,
 				screen_write_initctx(ctx, &ttyctx, 0);
 				ttyctx.cell = &ci->gc;
 				ttyctx.wrapped = ci->wrapped;
-				ttyctx.ptr = cl->data + ci->x;
 				ttyctx.num = ci->used;
-				tty_write(tty_cmd_cells, &ttyctx);
+				if (ci->utf8) {
+					ttyctx.ptr = cl->udata + ci->x;
+					tty_write(tty_cmd_utf8cells, &ttyctx);
+				} else {
+					ttyctx.ptr = cl->data + ci->x;
+					tty_write(tty_cmd_cells, &ttyctx);
+				}
 			}
 			items++;
 
@@ -1861,8 +1887,13 @@ screen_write_collect_end(struct screen_write_ctx *ctx)
 		TAILQ_INSERT_BEFORE(before, ci, entry);
 	ctx->item = screen_write_get_citem();
 
-	log_debug("%s: %u %.*s (at %u,%u)", __func__, ci->used,
-	    (int)ci->used, cl->data + ci->x, s->cx, s->cy);
+	if (ci->utf8)
+		log_debug("%s: %u UTF-8 (at %u,%u)", __func__, ci->used, s->cx,
+		    s->cy);
+	else {
+		log_debug("%s: %u %.*s (at %u,%u)", __func__, ci->used,
+		    (int)ci->used, cl->data + ci->x, s->cx, s->cy);
+	}
 
 	if (s->cx != 0) {
 		for (xx = s->cx; xx > 0; xx--) {
@@ -1872,6 +1903,8 @@ screen_write_collect_end(struct screen_write_ctx *ctx)
 			grid_view_set_cell(s->grid, xx, s->cy,
 			    &grid_default_cell);
 		}
+		if (xx == 0)
+			grid_view_get_cell(s->grid, 0, s->cy, &gc);
 		if (gc.data.width > 1) {
 			grid_view_set_cell(s->grid, xx, s->cy,
 			    &grid_default_cell);
@@ -1883,8 +1916,13 @@ screen_write_collect_end(struct screen_write_ctx *ctx)
 		ctx->wp->flags |= PANE_REDRAW;
 #endif
 
-	grid_view_set_cells(s->grid, s->cx, s->cy, &ci->gc, cl->data + ci->x,
-	    ci->used);
+	if (ci->utf8) {
+		grid_view_set_utf8_cells(s->grid, s->cx, s->cy, &ci->gc,
+		    cl->udata + ci->x, ci->used);
+	} else {
+		grid_view_set_cells(s->grid, s->cx, s->cy, &ci->gc,
+		    cl->data + ci->x, ci->used);
+	}
 	screen_write_set_cursor(ctx, s->cx + ci->used, -1);
 
 	for (xx = s->cx; xx < screen_size_x(s); xx++) {
@@ -1895,6 +1933,52 @@ screen_write_collect_end(struct screen_write_ctx *ctx)
 	}
 }
 
+/* Check if a UTF-8 character can be collected. */
+static int
+screen_write_collect_utf8(struct screen_write_ctx *ctx,
+    const struct grid_cell *gc)
+{
+	struct screen		*s = ctx->s;
+	const struct utf8_data	*ud = &gc->data;
+	struct grid_cell	 last;
+	u_int			 n;
+
+	if (ud->width == 0 || ud->width > 2 || ud->width > screen_size_x(s))
+		return (0);
+	if (utf8_is_zwj(ud) || utf8_is_vs(ud) || utf8_is_modifier(ud))
+		return (0);
+
+	/*
+	 * Characters already in the item cannot have a joiner, but one written
+	 * before it started might need to be combined with this one.
+	 */
+	if (ctx->item->used != 0 || s->cx == 0)
+		return (1);
+	n = 1;
+	grid_view_get_cell(s->grid, s->cx - n, s->cy, &last);
+	if (s->cx != 1 && (last.flags & GRID_FLAG_PADDING)) {
+		n = 2;
+		grid_view_get_cell(s->grid, s->cx - n, s->cy, &last);
+	}
+	return (!utf8_has_zwj(&last.data));
+}
+
+/* Change the current item to store UTF-8 characters. */
+static void
+screen_write_collect_upgrade(struct screen_write_ctx *ctx)
+{
+	struct screen			*s = ctx->s;
+	struct screen_write_citem	*ci = ctx->item;
+	struct screen_write_cline	*cl = &s->write_list[s->cy];
+	u_int				 xx;
+
+	if (cl->udata == NULL)
+		cl->udata = xcalloc(screen_size_x(s), sizeof *cl->udata);
+	for (xx = s->cx; xx < s->cx + ci->used; xx++)
+		cl->udata[xx] = utf8_build_one(cl->data[xx]);
+	ci->utf8 = 1;
+}
+
 /* Write cell data, collecting if necessary. */
 void
 screen_write_collect_add(struct screen_write_ctx *ctx,
@@ -1902,8 +1986,9 @@ screen_write_collect_add(struct screen_write_ctx *ctx,
 {
 	struct screen			*s = ctx->s;
 	struct screen_write_citem	*ci;
-	u_int				 sx = screen_size_x(s);
-	int				 collect;
+	struct screen_write_cline	*cl;
+	u_int				 sx = screen_size_x(s), width;
+	int				 collect, utf8;
 
 	/*
 	 * Don't need to check that the attributes and whatnot are still the
@@ -1912,9 +1997,12 @@ screen_write_collect_add(struct screen_write_ctx *ctx,
 	 */
 
 	collect = 1;
-	if (gc->data.width != 1 || gc->data.size != 1 || *gc->data.data >= 0x7f)
+	utf8 = (gc->data.size != 1 || *gc->data.data >= 0x7f);
+	if (gc->flags & GRID_FLAG_TAB)
 		collect = 0;
-	else if (gc->flags & GRID_FLAG_TAB)
+	else if (utf8 && !screen_write_collect_utf8(ctx, gc))
+		collect = 0;
+	else if (!utf8 && gc->data.width != 1)
 		collect = 0;
 	else if (gc->attr & GRID_ATTR_CHARSET)
 		collect = 0;
@@ -1930,12 +2018,13 @@ screen_write_collect_add(struct screen_write_ctx *ctx,
 		screen_write_cell(ctx, gc);
 		return;
 	}
+	width = gc->data.width;
 
-	if (s->cx > sx - 1 || ctx->item->used > sx - 1 - s->cx)
+	if (s->cx > sx - width || ctx->item->used > sx - width - s->cx)
 		screen_write_collect_end(ctx);
 	ci = ctx->item; /* may have changed */
 
-	if (s->cx > sx - 1) {
+	if (s->cx > sx - width) {
 		log_debug("%s: wrapped at %u,%u", __func__, s->cx, s->cy);
 		ci->wrapped = 1;
 		screen_write_linefeed(ctx, 1, 8);
@@ -1944,9 +2033,81 @@ screen_write_collect_add(struct screen_write_ctx *ctx,
 
 	if (ci->used == 0)
 		memcpy(&ci->gc, gc, sizeof ci->gc);
-	if (ctx->s->write_list[s->cy].data == NULL)
-		ctx->s->write_list[s->cy].data = xmalloc(screen_size_x(ctx->s));
-	ctx->s->write_list[s->cy].data[s->cx + ci->used++] = gc->data.data[0];
+	cl = &s->write_list[s->cy];
+	if (cl->data == NULL)
+		cl->data = xmalloc(sx);
+	if (utf8 && !ci->utf8)
+		screen_write_collect_upgrade(ctx);
+	if (!ci->utf8) {
+		cl->data[s->cx + ci->used++] = gc->data.data[0];
+		return;
+	}
+	utf8_from_data(&gc->data, &cl->udata[s->cx + ci->used++]);
+	if (width == 2)
+		cl->udata[s->cx + ci->used++] = 0;
+}
+
+/*
+ * Collect a run of printable ASCII characters with the same attributes. Each
+ * line's worth is copied into the write list at once.
+ */
+void
+screen_write_collect_span(struct screen_write_ctx *ctx,
+    const struct grid_cell *gc, const u_char *data, size_t n)
+{
+	struct screen			*s = ctx->s;
+	struct screen_write_citem	*ci;
+	struct screen_write_cline	*cl;
+	struct grid_cell		 tmp;
+	utf8_char			*ud;
+	u_int				 sx = screen_size_x(s), room, i;
+
+	if ((gc->flags & GRID_FLAG_TAB) ||
+	    (gc->attr & GRID_ATTR_CHARSET) ||
+	    (~s->mode & MODE_WRAP) ||
+	    (s->mode & MODE_INSERT) ||
+	    s->sel != NULL) {
+		memcpy(&tmp, gc, sizeof tmp);
+		for (; n != 0; n--) {
+			utf8_set(&tmp.data, *data++);
+			screen_write_collect_add(ctx, &tmp);
+		}
+		return;
+	}
+
+	while (n != 0) {
+		if (s->cx > sx - 1 || ctx->item->used > sx - 1 - s->cx)
+			screen_write_collect_end(ctx);
+		ci = ctx->item; /* may have changed */
+
+		if (s->cx > sx - 1) {
+			log_debug("%s: wrapped at %u,%u", __func__, s->cx, s->cy);
+			ci->wrapped = 1;
+			screen_write_linefeed(ctx, 1, 8);
+			screen_write_set_cursor(ctx, 0, -1);
+		}
+
+		if (ci->used == 0) {
+			memcpy(&ci->gc, gc, sizeof ci->gc);
+			utf8_set(&ci->gc.data, *data);
+		}
+		cl = &s->write_list[s->cy];
+		if (cl->data == NULL)
+			cl->data = xmalloc(sx);
+
+		room = sx - s->cx - ci->used;
+		if (room > n)
+			room = n;
+		if (ci->utf8) {
+			ud = cl->udata + s->cx + ci->used;
+			for (i = 0; i < room; i++)
+				ud[i] = utf8_build_one(data[i]);
+		} else
+			memcpy(cl->data + s->cx + ci->used, data, room);
+		ci->used += room;
+		data += room;
+		n -= room;
+	}
 }
 
 /* Write cell data. */
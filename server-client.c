@@ -49,6 +49,7 @@ static void	server_client_check_window_resize(struct window *);
 static key_code	server_client_check_mouse(struct client *, struct key_event *);
 static void	server_client_repeat_timer(int, short, void *);
 static void	server_client_click_timer(int, short, void *);
+static void	server_client_frame_timer(int, short, void *);
 static void	server_client_check_exit(struct client *);
 static void	server_client_check_redraw(struct client *);
 static void	server_client_check_modes(struct client *);
@@ -310,6 +311,7 @@ server_client_create(int fd)
 
 	evtimer_set(&c->repeat_timer, server_client_repeat_timer, c);
 	evtimer_set(&c->click_timer, server_client_click_timer, c);
+	evtimer_set(&c->frame_timer, server_client_frame_timer, c);
 
 	TAILQ_INSERT_TAIL(&clients, c, entry);
 	log_debug("new client %p", c);
@@ -465,6 +467,7 @@ server_client_lost(struct client *c)
 
 	evtimer_del(&c->repeat_timer);
 	evtimer_del(&c->click_timer);
+	evtimer_del(&c->frame_timer);
 
 	key_bindings_unref_table(c->keytable);
 
@@ -3089,6 +3092,38 @@ server_client_redraw_timer(__unused int fd, __unused short events,
 	log_debug("redraw timer fired");
 }
 
+/* Frame timer callback. */
+static void
+server_client_frame_timer(__unused int fd, __unused short events, void *data)
+{
+	struct client	*c = data;
+
+	log_debug("%s: frame timer fired", c->name);
+}
+
+/*
+ * Start a new frame if frame-rate is set. Returns 1 if the last frame has not
+ * yet finished, so changes should be left for the next frame.
+ */
+int
+server_client_start_frame(struct client *c)
+{
+	struct timeval	tv = { 0 };
+	u_int		rate;
+
+	if (c->flags & CLIENT_CONTROL)
+		return (0);
+	rate = options_get_number(global_options, "frame-rate");
+	if (rate == 0)
+		return (0);
+
+	if (evtimer_pending(&c->frame_timer, NULL))
+		return (1);
+	tv.tv_usec = 1000000 / rate;
+	evtimer_add(&c->frame_timer, &tv);
+	return (0);
+}
+
 /*
  * Check if modes need to be updated. Only modes in the current window are
  * updated and it is done when the status line is redrawn.
@@ -3125,7 +3160,7 @@ server_client_check_redraw(struct client *c)
 	u_int			 bit = 0;
 	struct timeval		 tv = { .tv_usec = 1000 };
 	static struct event	 ev;
-	size_t			 left;
+	size_t			 left, written;
 
 	if (c->flags & (CLIENT_CONTROL|CLIENT_SUSPENDED))
 		return;
@@ -3161,13 +3196,23 @@ server_client_check_redraw(struct client *c)
 			}
 		}
 	}
-	if (needed && (left = EVBUFFER_LENGTH(tty->out)) != 0) {
-		log_debug("%s: redraw deferred (%zu left)", c->name, left);
-		if (!evtimer_initialized(&ev))
-			evtimer_set(&ev, server_client_redraw_timer, NULL);
-		if (!evtimer_pending(&ev, NULL)) {
-			log_debug("redraw timer started");
-			evtimer_add(&ev, &tv);
+	if (needed &&
+	    ((left = EVBUFFER_LENGTH(tty->out)) != 0 ||
+	    evtimer_pending(&c->frame_timer, NULL))) {
+		if (left == 0) {
+			/* The frame timer will get us back here. */
+			log_debug("%s: redraw deferred (frame)", c->name);
+		} else {
+			log_debug("%s: redraw deferred (%zu left)", c->name,
+			    left);
+			if (!evtimer_initialized(&ev)) {
+				evtimer_set(&ev, server_client_redraw_timer,
+				    NULL);
+			}
+			if (!evtimer_pending(&ev, NULL)) {
+				log_debug("redraw timer started");
+				evtimer_add(&ev, &tv);
+			}
 		}
 
 		if (~c->flags & CLIENT_REDRAWWINDOW) {
@@ -3202,6 +3247,9 @@ server_client_check_redraw(struct client *c)
 	} else if (needed)
 		log_debug("%s: redraw needed", c->name);
 
+	if (needed)
+		server_client_start_frame(c);
+	written = c->written;
 	tty_flags = tty->flags & (TTY_BLOCK|TTY_FREEZE|TTY_NOCURSOR);
 	tty->flags = (tty->flags & ~(TTY_BLOCK|TTY_FREEZE))|TTY_NOCURSOR;
 
@@ -3261,7 +3309,9 @@ server_client_check_redraw(struct client *c)
 		 * generated.
 		 */
 		c->redraw = EVBUFFER_LENGTH(tty->out);
-		log_debug("%s: redraw added %zu bytes", c->name, c->redraw);
+		c->redraw_written = c->written - written;
+		log_debug("%s: redraw added %zu bytes (%zu written)", c->name,
+		    c->redraw, c->redraw_written);
 	}
 }
 
@@ -315,6 +315,8 @@ server_destroy_pane(struct window_pane *wp, int notify)
 	u_int			 sx = screen_size_x(&wp->base);
 	u_int			 sy = screen_size_y(&wp->base);
 
+	if (wp->ictx != NULL)
+		input_stop_remote(wp->ictx);
 	if (wp->fd != -1) {
 #ifdef HAVE_UTEMPTER
 		utempter_remove_record(wp->fd);
@@ -276,6 +276,7 @@ server_loop(void)
 	} while (items != 0);
 
 	server_client_loop();
+	window_limit_history();
 
 	if (!options_get_number(global_options, "exit-empty") && !server_exit)
 		return (0);
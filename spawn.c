@@ -253,12 +253,15 @@ spawn_pane(struct spawn_context *sc, char **cause)
 			free(cwd);
 			return (NULL);
 		}
+		if (sc->wp0->ictx != NULL)
+			input_stop_remote(sc->wp0->ictx);
 		if (sc->wp0->fd != -1) {
 			bufferevent_free(sc->wp0->event);
 			close(sc->wp0->fd);
 		}
 		window_pane_reset_mode_all(sc->wp0);
 		screen_reinit(&sc->wp0->base);
+		window_pane_reflow(sc->wp0);
 		input_free(sc->wp0->ictx);
 		sc->wp0->ictx = NULL;
 		new_wp = sc->wp0;
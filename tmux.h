@@ -51,6 +51,7 @@ struct control_state;
 struct environ;
 struct format_job_tree;
 struct format_tree;
+struct grid_spill;
 struct hyperlinks_uri;
 struct hyperlinks;
 struct input_ctx;
@@ -73,6 +74,7 @@ struct sixel_image;
 struct tty_ctx;
 struct tty_code;
 struct tty_key;
+struct tty_shadow_line;
 struct tmuxpeer;
 struct tmuxproc;
 struct winlink;
@@ -743,6 +745,8 @@ struct colour_palette {
 #define GRID_LINE_DEAD 0x4
 #define GRID_LINE_START_PROMPT 0x8
 #define GRID_LINE_START_OUTPUT 0x10
+#define GRID_LINE_PACKED 0x20
+#define GRID_LINE_SPILLED 0x40
 
 /* Grid string flags. */
 #define GRID_STRING_WITH_SEQUENCES 0x1
@@ -783,15 +787,14 @@ struct grid_cell {
 	u_int			link;
 };
 
-/* Grid extended cell entry. */
+/*
+ * Grid extended cell entry. The attributes, colours and hyperlink are kept in
+ * a shared table and style is an index into it.
+ */
 struct grid_extd_entry {
 	utf8_char		data;
-	u_short			attr;
 	u_char			flags;
-	int			fg;
-	int			bg;
-	int			us;
-	u_int			link;
+	u_int			style;
 } __packed;
 
 /* Grid cell entry. */
@@ -810,9 +813,16 @@ struct grid_cell_entry {
 
 /* Grid line. */
 struct grid_line {
-	struct grid_cell_entry	*celldata;
+	union {
+		struct grid_cell_entry	*celldata;
+		u_char			*packdata; /* if GRID_LINE_PACKED */
+		off_t			 spilloff; /* if GRID_LINE_SPILLED */
+	};
 	u_int			 cellused;
-	u_int			 cellsize;
+	union {
+		u_int			 cellsize;
+		u_int			 packsize;
+	};
 
 	struct grid_extd_entry	*extddata;
 	u_int			 extdsize;
@@ -825,6 +835,7 @@ struct grid_line {
 struct grid {
 	int			 flags;
 #define GRID_HISTORY 0x1 /* scroll lines into history */
+#define GRID_REFLOW_LATER 0x2 /* leave old history to reflow later */
 
 	u_int			 sx;
 	u_int			 sy;
@@ -832,8 +843,25 @@ struct grid {
 	u_int			 hscrolled;
 	u_int			 hsize;
 	u_int			 hlimit;
+	u_int			 hcompress;
+	u_int			 hunpacked;
+	u_int			 htrimmed; /* lines ever trimmed from the top */
+
+	size_t			 bytes; /* cell data held by all lines */
+
+	u_int			 hspill;
+	struct grid_spill	*spill;
 
+	u_int			 hreflow; /* lines at top not yet reflowed */
+
+	/*
+	 * Lines are kept in a ring of linesize entries so history can be
+	 * added and removed without moving the others. Line zero is at
+	 * linestart.
+	 */
 	struct grid_line	*linedata;
+	u_int			 linestart;
+	u_int			 linesize;
 };
 
 /* Virtual cursor in a grid. */
@@ -1154,7 +1182,7 @@ struct window_pane {
 #define PANE_DROP 0x2
 #define PANE_FOCUSED 0x4
 #define PANE_VISITED 0x8
-/* 0x10 unused */
+#define PANE_REMOTE 0x10
 /* 0x20 unused */
 #define PANE_INPUTOFF 0x40
 #define PANE_CHANGED 0x80
@@ -1179,6 +1207,7 @@ struct window_pane {
 	char		 tty[TTY_NAME_MAX];
 	int		 status;
 	struct timeval	 dead_time;
+	time_t		 view_time;
 
 	int		 fd;
 	struct bufferevent *event;
@@ -1188,6 +1217,7 @@ struct window_pane {
 
 	struct window_pane_resizes resize_queue;
 	struct event	 resize_timer;
+	struct event	 reflow_timer;
 
 	struct input_ctx *ictx;
 
@@ -1503,6 +1533,7 @@ struct tty_term {
 #define TERM_RGBCOLOURS 0x10
 #define TERM_VT100LIKE 0x20
 #define TERM_SIXEL 0x40
+#define TERM_SGR 0x80
 	int		 flags;
 
 	LIST_ENTRY(tty_term) entry;
@@ -1557,6 +1588,11 @@ struct tty {
 	struct grid_cell cell;
 	struct grid_cell last_cell;
 
+	/* What the terminal is showing, where known. */
+	struct tty_shadow_line *shadow;
+	u_int		 shadow_sx;
+	u_int		 shadow_sy;
+
 #define TTY_NOCURSOR 0x1
 #define TTY_FREEZE 0x2
 #define TTY_TIMER 0x4
@@ -1570,6 +1606,7 @@ struct tty {
 #define TTY_SYNCING 0x400
 #define TTY_HAVEDA2 0x800 /* Secondary DA. */
 #define TTY_WINSIZEQUERY 0x1000
+#define TTY_SHADOWING 0x2000
 #define TTY_ALL_REQUEST_FLAGS \
 	(TTY_HAVEDA|TTY_HAVEDA2|TTY_HAVEXDA)
 	int		 flags;
@@ -1935,8 +1972,10 @@ struct client {
 	size_t			 written;
 	size_t			 discarded;
 	size_t			 redraw;
+	size_t			 redraw_written;
 
 	struct event		 repeat_timer;
+	struct event		 frame_timer;
 
 	struct event		 click_timer;
 	u_int			 click_button;
@@ -2297,6 +2336,7 @@ char		*paste_make_sample(struct paste_buffer *);
 #define FORMAT_PANE 0x80000000U
 #define FORMAT_WINDOW 0x40000000U
 struct format_tree;
+struct grid_spill;
 struct format_modifier;
 typedef void *(*format_cb)(struct format_tree *);
 void		 format_tidy_jobs(void);
@@ -2493,6 +2533,9 @@ void	tty_putn(struct tty *, const void *, size_t, u_int);
 void	tty_cell(struct tty *, const struct grid_cell *,
 	    const struct grid_cell *, struct colour_palette *,
 	    struct hyperlinks *);
+int	tty_cell_shown(struct tty *, u_int, u_int, const struct grid_cell *,
+	    const struct grid_cell *, struct colour_palette *);
+void	tty_shadow_invalidate(struct tty *, u_int, u_int, u_int, u_int);
 int	tty_init(struct tty *, struct client *);
 void	tty_resize(struct tty *);
 void	tty_set_size(struct tty *, u_int, u_int, u_int, u_int);
@@ -2523,6 +2566,7 @@ void	tty_write(void (*)(struct tty *, const struct tty_ctx *),
 void	tty_cmd_alignmenttest(struct tty *, const struct tty_ctx *);
 void	tty_cmd_cell(struct tty *, const struct tty_ctx *);
 void	tty_cmd_cells(struct tty *, const struct tty_ctx *);
+void	tty_cmd_utf8cells(struct tty *, const struct tty_ctx *);
 void	tty_cmd_clearendofline(struct tty *, const struct tty_ctx *);
 void	tty_cmd_clearendofscreen(struct tty *, const struct tty_ctx *);
 void	tty_cmd_clearline(struct tty *, const struct tty_ctx *);
@@ -2872,6 +2916,7 @@ void	 server_client_suspend(struct client *);
 void	 server_client_detach(struct client *, enum msgtype);
 void	 server_client_exec(struct client *, const char *);
 void	 server_client_loop(void);
+int	 server_client_start_frame(struct client *);
 const char *server_client_get_cwd(struct client *, struct session *);
 void	 server_client_set_flags(struct client *, const char *);
 const char *server_client_get_flags(struct client *);
@@ -2948,6 +2993,7 @@ void	 recalculate_sizes_now(int);
 struct input_ctx *input_init(struct window_pane *, struct bufferevent *,
 	     struct colour_palette *);
 void	 input_free(struct input_ctx *);
+void	 input_stop_remote(struct input_ctx *);
 void	 input_reset(struct input_ctx *, int);
 struct evbuffer *input_pending(struct input_ctx *);
 void	 input_parse_pane(struct window_pane *);
@@ -2998,17 +3044,26 @@ int	 grid_cells_look_equal(const struct grid_cell *,
 struct grid *grid_create(u_int, u_int, u_int);
 void	 grid_destroy(struct grid *);
 int	 grid_compare(struct grid *, struct grid *);
+u_int	 grid_checksum(struct grid *, u_int, u_int);
 void	 grid_collect_history(struct grid *);
 void	 grid_remove_history(struct grid *, u_int );
 void	 grid_scroll_history(struct grid *, u_int);
 void	 grid_scroll_history_region(struct grid *, u_int, u_int, u_int);
 void	 grid_clear_history(struct grid *);
+void	 grid_prepend_history(struct grid *, struct grid *, u_int);
+void	 grid_compress_history(struct grid *, u_int);
+void	 grid_spill_history(struct grid *, u_int);
+size_t	 grid_release_history(struct grid *, size_t);
+size_t	 grid_bytes(struct grid *);
 const struct grid_line *grid_peek_line(struct grid *, u_int);
+const struct grid_line *grid_peek_packed_line(struct grid *, u_int);
 void	 grid_get_cell(struct grid *, u_int, u_int, struct grid_cell *);
 void	 grid_set_cell(struct grid *, u_int, u_int, const struct grid_cell *);
 void	 grid_set_padding(struct grid *, u_int, u_int);
 void	 grid_set_cells(struct grid *, u_int, u_int, const struct grid_cell *,
 	     const char *, size_t);
+void	 grid_set_utf8_cells(struct grid *, u_int, u_int,
+	     const struct grid_cell *, const utf8_char *, size_t);
 struct grid_line *grid_get_line(struct grid *, u_int);
 void	 grid_adjust_lines(struct grid *, u_int);
 void	 grid_clear(struct grid *, u_int, u_int, u_int, u_int, u_int);
@@ -3020,6 +3075,7 @@ char	*grid_string_cells(struct grid *, u_int, u_int, u_int,
 void	 grid_duplicate_lines(struct grid *, u_int, struct grid *, u_int,
 	     u_int);
 void	 grid_reflow(struct grid *, u_int);
+int	 grid_reflow_history(struct grid *, int);
 void	 grid_wrap_position(struct grid *, u_int, u_int, u_int *, u_int *);
 void	 grid_unwrap_position(struct grid *, u_int *, u_int *, u_int, u_int);
 u_int	 grid_line_length(struct grid *, u_int);
@@ -3053,6 +3109,8 @@ void	 grid_view_set_cell(struct grid *, u_int, u_int,
 void	 grid_view_set_padding(struct grid *, u_int, u_int);
 void	 grid_view_set_cells(struct grid *, u_int, u_int,
 	     const struct grid_cell *, const char *, size_t);
+void	 grid_view_set_utf8_cells(struct grid *, u_int, u_int,
+	     const struct grid_cell *, const utf8_char *, size_t);
 void	 grid_view_clear_history(struct grid *, u_int);
 void	 grid_view_clear(struct grid *, u_int, u_int, u_int, u_int, u_int);
 void	 grid_view_scroll_region_up(struct grid *, u_int, u_int, u_int);
@@ -3131,6 +3189,8 @@ void	 screen_write_fullredraw(struct screen_write_ctx *);
 void	 screen_write_collect_end(struct screen_write_ctx *);
 void	 screen_write_collect_add(struct screen_write_ctx *,
 	     const struct grid_cell *);
+void	 screen_write_collect_span(struct screen_write_ctx *,
+	     const struct grid_cell *, const u_char *, size_t);
 void	 screen_write_cell(struct screen_write_ctx *, const struct grid_cell *);
 void	 screen_write_setselection(struct screen_write_ctx *, const char *,
 	     u_char *, u_int);
@@ -3236,6 +3296,7 @@ void		 window_destroy_panes(struct window *);
 struct window_pane *window_pane_find_by_id_str(const char *);
 struct window_pane *window_pane_find_by_id(u_int);
 int		 window_pane_destroy_ready(struct window_pane *);
+void		 window_pane_reflow(struct window_pane *);
 void		 window_pane_resize(struct window_pane *, u_int, u_int);
 int		 window_pane_set_mode(struct window_pane *,
 		     struct window_pane *, const struct window_mode *,
@@ -3248,6 +3309,9 @@ int		 window_pane_key(struct window_pane *, struct client *,
 void		 window_pane_paste(struct window_pane *, key_code, char *,
 		     size_t);
 int		 window_pane_visible(struct window_pane *);
+size_t		 window_pane_history_bytes(struct window_pane *);
+size_t		 window_history_bytes(void);
+void		 window_limit_history(void);
 int		 window_pane_exited(struct window_pane *);
 u_int		 window_pane_search(struct window_pane *, const char *, int,
 		     int);
@@ -3400,6 +3464,7 @@ char		*window_copy_get_line(struct window_pane *, u_int);
 int		 window_copy_get_current_offset(struct window_pane *, u_int *,
 		     u_int *);
 char		*window_copy_get_hyperlink(struct window_pane *, u_int, u_int);
+void		 window_copy_history_added(struct window_pane *);
 
 /* window-option.c */
 extern const struct window_mode window_customize_mode;
@@ -3449,6 +3514,12 @@ struct remote *remote_create(struct bufferevent *bev, struct window_pane *wp);
 void remote_notify_window_pane_changed(struct remote *, struct window *);
 void remote_notify_window_layout_changed(struct remote *, struct window *);
 void remote_notify_session_window_changed(struct remote *);
+void remote_fetch_history(struct remote *, struct window_pane *);
+u_int remote_queued(struct remote *);
+u_int remote_latency(struct remote *);
+u_int remote_latency_percentile(struct remote *, u_int);
+u_int remote_echo_latency(struct remote *);
+u_int remote_input_latency(struct remote *);
 void remote_destroy(struct remote *r);
 
 /* session.c */
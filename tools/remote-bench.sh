@@ -0,0 +1,194 @@
+#!/bin/sh
+
+# Measure the remote client over a local pty. An inner server is attached to
+# with -CC from a pane in an outer server, both on private sockets, and the
+# mirrored session is given a fixed set of workloads. Nothing is sent over the
+# network, so the numbers are the cost of remote.c and the two servers alone.
+#
+# The workloads are generated here rather than recorded so that their size can
+# be chosen and runs on different machines see the same data. Only POSIX
+# utilities are used, plus a fractional sleep(1) as on the BSDs and Linux and
+# perl(1) with Time::HiRes as a clock finer than a millisecond.
+#
+# usage: remote-bench.sh [-m megabytes] [-p panes] [-n switches]
+#     [-k paste-kilobytes] [tmux]
+
+PATH=/bin:/usr/bin:/usr/local/bin
+TERM=screen
+export TERM
+
+MB=16
+PANES=16
+SWITCHES=200
+PASTE=256
+while getopts k:m:n:p: opt; do
+	case $opt in
+	k) PASTE=$OPTARG ;;
+	m) MB=$OPTARG ;;
+	n) SWITCHES=$OPTARG ;;
+	p) PANES=$OPTARG ;;
+	*) echo "usage: $0 [-m mb] [-p panes] [-n switches] [-k kb] [tmux]" >&2
+	   exit 1 ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+if ! perl -MTime::HiRes -e 1 2>/dev/null; then
+	echo "$0: perl with Time::HiRes is needed to time the steps" >&2
+	exit 1
+fi
+
+TEST_TMUX=${1:-$(readlink -f ../tmux)}
+OUTER="$TEST_TMUX -Lbench"
+INNER="$TEST_TMUX -Lbench-inner"
+TMP=$(mktemp -d) || exit 1
+export OUTER INNER TMP
+trap '$OUTER kill-server 2>/dev/null; $INNER kill-server 2>/dev/null; rm -rf $TMP' 0
+trap 'exit 1' 1 2 15
+$OUTER kill-server 2>/dev/null
+$INNER kill-server 2>/dev/null
+
+# Functions for the steps, which are run as separate scripts to be timed.
+cat >$TMP/lib <<'EOF'
+# Wait for the mirror session to have every window and nothing left to send.
+settle() {
+	n=$($INNER display -p -tinner '#{session_windows}')
+	while ! $OUTER has -tinner 2>/dev/null ||
+	    [ "$($OUTER display -p -tinner '#{session_windows}')" != $n ] ||
+	    [ "$($OUTER display -p -tinner '#{session_remote_queue}')" != 0 ]; do
+		sleep 0.01
+	done
+}
+EOF
+
+# Print the time in seconds, to the microsecond.
+now() {
+	perl -MTime::HiRes=time -e 'printf "%.6f\n", time'
+}
+
+# Run a step and print a result line: name, elapsed seconds and bytes (or 0).
+step() {
+	t0=$(now)
+	sh $TMP/step.$1 >/dev/null 2>&1
+	t1=$(now)
+	awk -v n=$1 -v t0=$t0 -v t1=$t1 -v b=$2 'BEGIN {
+		t = t1 - t0
+		if (b > 0) {
+			printf "%-10s %10.4f s %10.1f KiB/s\n", n, t,
+			    b / 1024 / t
+		} else
+			printf "%-10s %10.4f s\n", n, t
+	}'
+}
+
+# Generate coloured log-like lines until there are $1 bytes.
+generate() {
+	awk -v n=$1 'BEGIN {
+		while (t < n) {
+			l = sprintf("%08d \033[3%dmlevel%d\033[m %s", t, t % 8,
+			    t % 5, substr("the quick brown fox jumps over " \
+			    "the lazy dog 0123456789 ", 1 + t % 20));
+			print l
+			t += length(l) + 1
+		}
+	}'
+}
+
+generate $((MB * 1024 * 1024)) >$TMP/bulk
+generate $((PASTE * 1024)) >$TMP/paste
+BULK=$(wc -c <$TMP/bulk)
+PASTED=$(wc -c <$TMP/paste)
+export PASTED
+
+# Bootstrap: many panes, each with some history.
+$INNER -f/dev/null new -d -sinner -x200 -y50 "seq 1 2000; cat" || exit 1
+i=1
+while [ $i -lt $PANES ]; do
+	$INNER splitw -d -tinner:0 "seq 1 2000; cat" 2>/dev/null ||
+		$INNER neww -d -tinner "seq 1 2000; cat" || exit 1
+	$INNER selectl -tinner tiled
+	i=$((i + 1))
+done
+$INNER neww -d -tinner:100 -nbulk cat || exit 1
+sleep 1
+cat >$TMP/step.bootstrap <<'EOF'
+. $TMP/lib
+$OUTER -f/dev/null new -souter -d -x200 -y50 \
+	"$INNER -f/dev/null -CC attach -tinner" || exit 1
+settle
+EOF
+step bootstrap 0
+
+# Bulk output in one pane.
+$OUTER pipe-pane -tinner:bulk "grep -q BENCHDONE && $OUTER wait-for -S bulk"
+cat >$TMP/step.bulk <<'EOF'
+$INNER respawnp -k -tinner:bulk "cat $TMP/bulk; echo BENCH''DONE; cat"
+$OUTER wait-for bulk
+EOF
+step bulk $BULK
+
+# The same data split into contiguous parts across every pane at once.
+awk -v n=$PANES -v dir=$TMP -v lines=$(wc -l <$TMP/bulk) '{
+	f = sprintf("%s/part.%03d", dir, int((NR - 1) * n / lines))
+	if (f != last && last != "")
+		close(last)
+	print >f
+	last = f
+}' $TMP/bulk
+$INNER lsp -s -tinner -F '#{window_name} #{window_index}.#{pane_index}' |
+	awk '$1 != "bulk" { print $2 }' >$TMP/targets
+for p in $(cat $TMP/targets); do
+	$OUTER pipe-pane -tinner:$p \
+	    "grep -q BENCHDONE && $OUTER wait-for -S many$p"
+done
+cat >$TMP/step.panes <<'EOF'
+set -- $TMP/part.*
+for p in $(cat $TMP/targets); do
+	[ -f "$1" ] || break
+	$INNER respawnp -k -tinner:$p "cat $1; echo BENCH''DONE; cat"
+	shift
+done
+for p in $(cat $TMP/targets); do
+	$OUTER wait-for many$p
+done
+EOF
+step panes $BULK
+
+# Rapid window switching from the outer side.
+i=0
+: >$TMP/switch.conf
+while [ $i -lt $SWITCHES ]; do
+	echo "selectw -tinner:bulk; selectw -tinner:0" >>$TMP/switch.conf
+	i=$((i + 1))
+done
+echo "selectw -tinner:bulk" >>$TMP/switch.conf
+cat >$TMP/step.switch <<'EOF'
+. $TMP/lib
+$OUTER source $TMP/switch.conf
+while [ "$($INNER display -p -tinner '#{window_name}')" != bulk ]; do
+	sleep 0.01
+done
+settle
+EOF
+step switch 0
+
+# A large paste into a raw pane.
+$INNER respawnp -k -tinner:bulk "stty raw -echo; cat >$TMP/pasted"
+sleep 1
+cat >$TMP/step.paste <<'EOF'
+$OUTER loadb $TMP/paste
+$OUTER pasteb -dtinner:bulk
+while [ "$(wc -c <$TMP/pasted)" -lt $PASTED ]; do
+	sleep 0.01
+done
+EOF
+step paste $PASTED
+
+$OUTER display -p -tinner 'latency    avg #{session_remote_latency} ms, p50 #{session_remote_latency_p50} ms, p90 #{session_remote_latency_p90} ms, p99 #{session_remote_latency_p99} ms'
+PID=$($OUTER display -p '#{pid}')
+if [ -r /proc/$PID/status ]; then
+	awk '/^VmHWM/ { printf "peak rss   %8d KiB\n", $2 }' /proc/$PID/status
+else
+	ps -o rss= -p $PID | awk '{ printf "rss        %8d KiB\n", $1 }'
+fi
+exit 0
@@ -489,6 +489,26 @@ tty_term_apply_overrides(struct tty_term *term)
 		term->flags &= ~TERM_DECFRA;
 	log_debug("DECFRA flag is %d", !!(term->flags & TERM_DECFRA));
 
+	/*
+	 * Set or clear the SGR flag if sgr0 is a plain SGR reset, so attributes
+	 * and colours may be merged into one sequence. sgr0 may also leave the
+	 * alternate character set but that is tracked separately.
+	 */
+	s = tty_term_string(term, TTYC_SGR0);
+	if (strncmp(s, "\033(B", 3) == 0)
+		s += 3;
+	if (strncmp(s, "\033[m", 3) == 0)
+		s += 3;
+	else if (strncmp(s, "\033[0m", 4) == 0)
+		s += 4;
+	else
+		s = NULL;
+	if (s != NULL && (*s == '\0' || strcmp(s, "\017") == 0))
+		term->flags |= TERM_SGR;
+	else
+		term->flags &= ~TERM_SGR;
+	log_debug("SGR flag is %d", !!(term->flags & TERM_SGR));
+
 	/*
 	 * Terminals without am (auto right margin) wrap at at $COLUMNS - 1
 	 * rather than $COLUMNS (the cursor can never be beyond $COLUMNS - 1).
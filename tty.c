@@ -33,10 +33,86 @@
 
 #include "tmux.h"
 
+/* Cell as it was written to the terminal. */
+struct tty_shadow_cell {
+	utf8_char	 data;
+	int		 fg;
+	int		 bg;
+	int		 us;
+	u_short		 attr;
+	u_char		 size;
+	u_char		 width;
+	u_char		 flags;
+#define TTY_SHADOW_PADDING 0x1
+#define TTY_SHADOW_NOMATCH 0x2
+};
+
+/* Ways of moving the cursor. */
+enum tty_move_type {
+	TTY_MOVE_NONE,
+	TTY_MOVE_CODE,
+	TTY_MOVE_REPEAT,
+	TTY_MOVE_CHAR,
+	TTY_MOVE_OVERWRITE
+};
+struct tty_move {
+	enum tty_move_type	 type;
+	enum tty_code_code	 code;
+	u_int			 n;
+	u_int			 cost;
+};
+
+/*
+ * Line of the terminal. Cells from start to end are not known because
+ * something was written over them without being recorded.
+ */
+struct tty_shadow_line {
+	u_int			 start;
+	u_int			 end;
+	struct tty_shadow_cell	*cells;
+};
+
+/*
+ * Parameters of an SGR sequence being built. If any part cannot be written
+ * as SGR parameters, failed is set and the sequence is not used. cleared is
+ * set if anything is turned off rather than reset.
+ */
+struct tty_sgr {
+	char			 buf[256];
+	size_t			 len;
+	int			 failed;
+	int			 cleared;
+};
+
+/*
+ * Attributes in the order they are set, with the SGR parameter which turns
+ * each on in a standard terminal and the one which turns it off again.
+ */
+static const struct {
+	int		 attr;
+	const char	*on;
+	const char	*off;
+} tty_sgr_attrs[] = {
+	{ GRID_ATTR_BRIGHT, "1", "22" },
+	{ GRID_ATTR_DIM, "2", "22" },
+	{ GRID_ATTR_ITALICS, "3", "23" },
+	{ GRID_ATTR_UNDERSCORE, "4", "24" },
+	{ GRID_ATTR_UNDERSCORE_2, "4", "24" },
+	{ GRID_ATTR_UNDERSCORE_3, "4", "24" },
+	{ GRID_ATTR_UNDERSCORE_4, "4", "24" },
+	{ GRID_ATTR_UNDERSCORE_5, "4", "24" },
+	{ GRID_ATTR_BLINK, "5", "25" },
+	{ GRID_ATTR_REVERSE, "7", "27" },
+	{ GRID_ATTR_HIDDEN, "8", "28" },
+	{ GRID_ATTR_STRIKETHROUGH, "9", "29" },
+	{ GRID_ATTR_OVERLINE, "53", "55" },
+};
+
 static int	tty_log_fd = -1;
 
-static void	tty_set_italics(struct tty *);
-static int	tty_try_colour(struct tty *, int, const char *);
+static const char *tty_attr_string(struct tty *, int);
+static const char *tty_colour_string(struct tty *, int, int);
+static const char *tty_us_string(struct tty *, int);
 static void	tty_force_cursor_colour(struct tty *, int);
 static void	tty_cursor_pane(struct tty *, const struct tty_ctx *, u_int,
 		    u_int);
@@ -49,9 +125,21 @@ static void	tty_check_bg(struct tty *, struct colour_palette *,
     		    struct grid_cell *);
 static void	tty_check_us(struct tty *, struct colour_palette *,
     		    struct grid_cell *);
+static void	tty_check_attributes(struct tty *, struct colour_palette *,
+		    struct grid_cell *);
 static void	tty_colours_fg(struct tty *, const struct grid_cell *);
 static void	tty_colours_bg(struct tty *, const struct grid_cell *);
 static void	tty_colours_us(struct tty *, const struct grid_cell *);
+static void	tty_sgr_param(struct tty_sgr *, const char *, size_t);
+static void	tty_sgr_add(struct tty_sgr *, const char *);
+static int	tty_sgr_standard(struct tty *, int, const char *);
+static void	tty_sgr_set(struct tty *, struct tty_sgr *, int,
+		    const struct grid_cell *, const struct grid_cell *);
+static void	tty_sgr_reset(struct tty *, struct tty_sgr *,
+		    const struct grid_cell *);
+static void	tty_sgr_diff(struct tty *, struct tty_sgr *,
+		    const struct grid_cell *);
+static int	tty_sgr_attributes(struct tty *, const struct grid_cell *);
 
 static void	tty_region_pane(struct tty *, const struct tty_ctx *, u_int,
 		    u_int);
@@ -66,12 +154,50 @@ static void	tty_emulate_repeat(struct tty *, enum tty_code_code,
 		    enum tty_code_code, u_int);
 static void	tty_repeat_space(struct tty *, u_int);
 static void	tty_draw_pane(struct tty *, const struct tty_ctx *, u_int);
+static int	tty_cells_redraw(struct tty *, const struct tty_ctx *);
 static void	tty_default_attributes(struct tty *, const struct grid_cell *,
 		    struct colour_palette *, u_int, struct hyperlinks *);
 static int	tty_check_overlay(struct tty *, u_int, u_int);
 static void	tty_check_overlay_range(struct tty *, u_int, u_int, u_int,
 		    struct overlay_ranges *);
 
+static void	tty_shadow_resize(struct tty *);
+static void	tty_shadow_free(struct tty *);
+static void	tty_shadow_set_known(struct tty_shadow_line *, u_int, u_int);
+static void	tty_shadow_make(struct tty *, const struct grid_cell *,
+		    const struct grid_cell *, struct colour_palette *,
+		    struct tty_shadow_cell *);
+static int	tty_shadow_same(struct tty *, u_int, u_int,
+		    const struct tty_shadow_cell *, u_int);
+static void	tty_shadow_set(struct tty *, u_int, u_int,
+		    const struct tty_shadow_cell *);
+static void	tty_shadow_fill(struct tty *, u_int, u_int, u_int,
+		    const struct tty_shadow_cell *);
+static int	tty_shadow_any(struct tty *, u_int, u_int, u_int);
+static int	tty_shadow_check(struct tty *, const struct tty_shadow_cell *);
+static void	tty_shadow_scroll(struct tty *, u_int, u_int, int);
+static void	tty_shadow_code(struct tty *, enum tty_code_code, u_int);
+static void	tty_shadow_text(struct tty *, u_int);
+static void	tty_shadow_newline(struct tty *);
+static void	tty_move_try(struct tty_move *, enum tty_move_type,
+		    enum tty_code_code, u_int, u_int);
+static void	tty_move_try_code(struct tty *, struct tty_move *,
+		    enum tty_code_code, u_int);
+static void	tty_move_try_repeat(struct tty *, struct tty_move *,
+		    enum tty_code_code, u_int);
+static int	tty_move_overwrite(struct tty *, u_int, u_int, u_int);
+static void	tty_move_vertical(struct tty *, u_int, u_int,
+		    struct tty_move *);
+static void	tty_move_right(struct tty *, u_int, u_int, u_int,
+		    struct tty_move *);
+static void	tty_move_horizontal(struct tty *, u_int, u_int, u_int,
+		    struct tty_move *, int *);
+static void	tty_move_apply(struct tty *, const struct tty_move *, u_int,
+		    u_int);
+static void	tty_shadow_written(struct tty *, u_int, u_int,
+		    const struct grid_cell *, const struct grid_cell *,
+		    struct colour_palette *);
+
 #ifdef ENABLE_SIXEL
 static void	tty_write_one(void (*)(struct tty *, const struct tty_ctx *),
 		    struct client *, struct tty_ctx *);
@@ -166,6 +292,10 @@ tty_set_size(struct tty *tty, u_int sx, u_int sy, u_int xpixel, u_int ypixel)
 	tty->sy = sy;
 	tty->xpixel = xpixel;
 	tty->ypixel = ypixel;
+
+	if (tty->shadow != NULL &&
+	    (sx != tty->shadow_sx || sy != tty->shadow_sy))
+		tty_shadow_resize(tty);
 }
 
 static void
@@ -366,6 +496,7 @@ tty_start_tty(struct tty *tty)
 
 	tty->flags |= TTY_STARTED;
 	tty_invalidate(tty);
+	tty_shadow_resize(tty);
 
 	if (tty->ccolour != -1)
 		tty_force_cursor_colour(tty, -1);
@@ -422,6 +553,7 @@ tty_stop_tty(struct tty *tty)
 	if (!(tty->flags & TTY_STARTED))
 		return;
 	tty->flags &= ~TTY_STARTED;
+	tty_shadow_free(tty);
 
 	evtimer_del(&tty->start_timer);
 
@@ -555,6 +687,7 @@ tty_raw(struct tty *tty, const char *s)
 void
 tty_putcode(struct tty *tty, enum tty_code_code code)
 {
+	tty_shadow_code(tty, code, 1);
 	tty_puts(tty, tty_term_string(tty->term, code));
 }
 
@@ -563,6 +696,7 @@ tty_putcode_i(struct tty *tty, enum tty_code_code code, int a)
 {
 	if (a < 0)
 		return;
+	tty_shadow_code(tty, code, a);
 	tty_puts(tty, tty_term_string_i(tty->term, code, a));
 }
 
@@ -604,6 +738,7 @@ tty_add(struct tty *tty, const char *buf, size_t len)
 
 	if (tty->flags & TTY_BLOCK) {
 		tty->discarded += len;
+		tty_shadow_invalidate(tty, 0, 0, UINT_MAX, UINT_MAX);
 		return;
 	}
 
@@ -635,6 +770,11 @@ tty_putc(struct tty *tty, u_char ch)
 	    tty->cx + 1 >= tty->sx)
 		return;
 
+	if (ch >= 0x20 && ch != 0x7f)
+		tty_shadow_text(tty, 1);
+	else if (ch == '\n')
+		tty_shadow_newline(tty);
+
 	if (tty->cell.attr & GRID_ATTR_CHARSET) {
 		acs = tty_acs_get(tty, ch);
 		if (acs != NULL)
@@ -670,6 +810,7 @@ tty_putn(struct tty *tty, const void *buf, size_t len, u_int width)
 	    tty->cx + len >= tty->sx)
 		len = tty->sx - tty->cx - 1;
 
+	tty_shadow_text(tty, width);
 	tty_add(tty, buf, len);
 	if (tty->cx + width > tty->sx) {
 		tty->cx = (tty->cx + width) - tty->sx;
@@ -681,21 +822,6 @@ tty_putn(struct tty *tty, const void *buf, size_t len, u_int width)
 		tty->cx += width;
 }
 
-static void
-tty_set_italics(struct tty *tty)
-{
-	const char	*s;
-
-	if (tty_term_has(tty->term, TTYC_SITM)) {
-		s = options_get_string(global_options, "default-terminal");
-		if (strcmp(s, "screen") != 0 && strncmp(s, "screen-", 7) != 0) {
-			tty_putcode(tty, TTYC_SITM);
-			return;
-		}
-	}
-	tty_putcode(tty, TTYC_SMSO);
-}
-
 void
 tty_set_title(struct tty *tty, const char *title)
 {
@@ -1277,6 +1403,7 @@ tty_clear_area(struct tty *tty, const struct grid_cell *defaults, u_int py,
 	/* Nothing to clear. */
 	if (nx == 0 || ny == 0)
 		return;
+	tty_shadow_invalidate(tty, px, py, nx, ny);
 
 	/* If genuine BCE is available, can try escape sequences. */
 	if (c->overlay_check == NULL && !tty_fake_bce(tty, defaults, bg)) {
@@ -1438,6 +1565,444 @@ tty_check_overlay_range(struct tty *tty, u_int px, u_int py, u_int nx,
 	c->overlay_check(c, c->overlay_data, px, py, nx, r);
 }
 
+/* Allocate the shadow for the current size, with every cell unknown. */
+static void
+tty_shadow_resize(struct tty *tty)
+{
+	u_int	y;
+
+	tty_shadow_free(tty);
+	if (tty->sx == 0 || tty->sy == 0)
+		return;
+
+	tty->shadow = xcalloc(tty->sy, sizeof *tty->shadow);
+	for (y = 0; y < tty->sy; y++) {
+		tty->shadow[y].cells = xcalloc(tty->sx,
+		    sizeof *tty->shadow[y].cells);
+		tty->shadow[y].end = tty->sx;
+	}
+	tty->shadow_sx = tty->sx;
+	tty->shadow_sy = tty->sy;
+}
+
+/* Free the shadow. */
+static void
+tty_shadow_free(struct tty *tty)
+{
+	u_int	y;
+
+	if (tty->shadow == NULL)
+		return;
+	for (y = 0; y < tty->shadow_sy; y++)
+		free(tty->shadow[y].cells);
+	free(tty->shadow);
+	tty->shadow = NULL;
+	tty->shadow_sx = tty->shadow_sy = 0;
+}
+
+/* Forget what is in part of the terminal. */
+void
+tty_shadow_invalidate(struct tty *tty, u_int px, u_int py, u_int nx, u_int ny)
+{
+	struct tty_shadow_line	*sl;
+	u_int			 y;
+
+	if (tty->shadow == NULL ||
+	    px >= tty->shadow_sx ||
+	    py >= tty->shadow_sy ||
+	    nx == 0)
+		return;
+	if (nx > tty->shadow_sx - px)
+		nx = tty->shadow_sx - px;
+	if (ny > tty->shadow_sy - py)
+		ny = tty->shadow_sy - py;
+
+	for (y = py; y < py + ny; y++) {
+		sl = &tty->shadow[y];
+		if (sl->start >= sl->end) {
+			sl->start = px;
+			sl->end = px + nx;
+			continue;
+		}
+		if (px < sl->start)
+			sl->start = px;
+		if (px + nx > sl->end)
+			sl->end = px + nx;
+	}
+}
+
+/* Mark part of a shadow line as known, if it is at the end of the range. */
+static void
+tty_shadow_set_known(struct tty_shadow_line *sl, u_int px, u_int nx)
+{
+	if (sl->start >= sl->end)
+		return;
+	if (px <= sl->start && px + nx > sl->start)
+		sl->start = px + nx;
+	else if (px < sl->end && px + nx >= sl->end)
+		sl->end = px;
+}
+
+/*
+ * Work out the cell that will be on the terminal when a grid cell is drawn,
+ * the same way tty_attributes() does.
+ */
+static void
+tty_shadow_make(struct tty *tty, const struct grid_cell *gc,
+    const struct grid_cell *defaults, struct colour_palette *palette,
+    struct tty_shadow_cell *sc)
+{
+	struct grid_cell	gc2;
+	u_int			i;
+
+	memset(sc, 0, sizeof *sc);
+	if (gc->flags & GRID_FLAG_PADDING) {
+		sc->flags = TTY_SHADOW_PADDING;
+		return;
+	}
+	if (gc->link != 0 || (gc->flags & (GRID_FLAG_SELECTED|GRID_FLAG_TAB)))
+		sc->flags = TTY_SHADOW_NOMATCH;
+
+	memcpy(&gc2, gc, sizeof gc2);
+	if (gc->flags & GRID_FLAG_CLEARED) {
+		gc2.fg = 8;
+		gc2.attr = 0;
+		gc2.us = 0;
+	}
+	if (~gc->flags & GRID_FLAG_NOPALETTE) {
+		if (gc2.fg == 8)
+			gc2.fg = defaults->fg;
+		if (gc2.bg == 8)
+			gc2.bg = defaults->bg;
+	}
+	tty_check_attributes(tty, palette, &gc2);
+	sc->fg = gc2.fg;
+	sc->bg = gc2.bg;
+	sc->us = gc2.us;
+	sc->attr = gc2.attr;
+
+	if (gc->flags & GRID_FLAG_CLEARED) {
+		sc->data = ' ';
+		sc->size = sc->width = 1;
+		return;
+	}
+	sc->size = gc->data.size;
+	sc->width = gc->data.width;
+	if (sc->flags & TTY_SHADOW_NOMATCH)
+		return;
+	if (gc->data.size > 3) {
+		if (gc->data.width > 2 ||
+		    utf8_from_data(&gc->data, &sc->data) != UTF8_DONE)
+			sc->flags |= TTY_SHADOW_NOMATCH;
+		return;
+	}
+	for (i = 0; i < gc->data.size; i++)
+		sc->data |= (utf8_char)gc->data.data[i] << (i * 8);
+}
+
+/* Is this cell already on the terminal? */
+static int
+tty_shadow_same(struct tty *tty, u_int px, u_int py,
+    const struct tty_shadow_cell *sc, u_int width)
+{
+	struct tty_shadow_line	*sl;
+	struct tty_shadow_cell	*old;
+	u_int			 x;
+
+	if (tty->shadow == NULL ||
+	    (sc->flags & TTY_SHADOW_NOMATCH) ||
+	    width == 0 ||
+	    py >= tty->shadow_sy ||
+	    px >= tty->shadow_sx ||
+	    width > tty->shadow_sx - px)
+		return (0);
+	sl = &tty->shadow[py];
+	if (sl->start < sl->end && px + width > sl->start && px < sl->end)
+		return (0);
+
+	old = &sl->cells[px];
+	if (old->flags != 0 ||
+	    old->data != sc->data ||
+	    old->size != sc->size ||
+	    old->width != sc->width ||
+	    old->fg != sc->fg ||
+	    old->bg != sc->bg ||
+	    old->us != sc->us ||
+	    old->attr != sc->attr)
+		return (0);
+	for (x = 1; x < width; x++) {
+		if (~sl->cells[px + x].flags & TTY_SHADOW_PADDING)
+			return (0);
+	}
+	return (1);
+}
+
+/* Record a cell written to the terminal. */
+static void
+tty_shadow_set(struct tty *tty, u_int px, u_int py,
+    const struct tty_shadow_cell *sc)
+{
+	struct tty_shadow_line	*sl;
+	u_int			 x, width = sc->width;
+
+	if (tty->shadow == NULL || py >= tty->shadow_sy)
+		return;
+	if (tty->flags & TTY_BLOCK) {
+		tty_shadow_invalidate(tty, 0, 0, UINT_MAX, UINT_MAX);
+		return;
+	}
+	if (width == 0 ||
+	    px >= tty->shadow_sx ||
+	    width > tty->shadow_sx - px) {
+		tty_shadow_invalidate(tty, px, py, UINT_MAX, 1);
+		return;
+	}
+	sl = &tty->shadow[py];
+
+	memcpy(&sl->cells[px], sc, sizeof sl->cells[px]);
+	for (x = 1; x < width; x++) {
+		memset(&sl->cells[px + x], 0, sizeof sl->cells[px + x]);
+		sl->cells[px + x].flags = TTY_SHADOW_PADDING;
+	}
+	tty_shadow_set_known(sl, px, width);
+}
+
+/* Record a cleared area, leaving out any parts hidden by an overlay. */
+static void
+tty_shadow_fill(struct tty *tty, u_int px, u_int py, u_int nx,
+    const struct tty_shadow_cell *sc)
+{
+	struct overlay_ranges	r;
+	u_int			i, x;
+
+	if (tty->shadow == NULL)
+		return;
+	tty_check_overlay_range(tty, px, py, nx, &r);
+	for (i = 0; i < OVERLAY_MAX_RANGES; i++) {
+		for (x = 0; x < r.nx[i]; x++)
+			tty_shadow_set(tty, r.px[i] + x, py, sc);
+	}
+}
+
+/* Is any of this part of a line known? */
+static int
+tty_shadow_any(struct tty *tty, u_int px, u_int py, u_int nx)
+{
+	struct tty_shadow_line	*sl;
+
+	if (tty->shadow == NULL ||
+	    py >= tty->shadow_sy ||
+	    px >= tty->shadow_sx ||
+	    nx == 0)
+		return (0);
+	sl = &tty->shadow[py];
+	return (sl->start >= sl->end || px < sl->start || px + nx > sl->end);
+}
+
+/* Were the attributes last set by tty_attributes() those of this cell? */
+static int
+tty_shadow_check(struct tty *tty, const struct tty_shadow_cell *sc)
+{
+	return (tty->cell.fg == sc->fg &&
+	    tty->cell.bg == sc->bg &&
+	    tty->cell.us == sc->us &&
+	    tty->cell.attr == sc->attr &&
+	    tty->cell.link == 0);
+}
+
+/* Move lines in the shadow when the terminal scrolls a region. */
+static void
+tty_shadow_scroll(struct tty *tty, u_int upper, u_int lower, int n)
+{
+	struct tty_shadow_line	*lines;
+	u_int			 ny, m;
+
+	if (upper > lower ||
+	    lower >= tty->shadow_sy ||
+	    (tty_use_margin(tty) &&
+	    (tty->rleft != 0 || tty->rright != tty->shadow_sx - 1))) {
+		tty_shadow_invalidate(tty, 0, 0, UINT_MAX, UINT_MAX);
+		return;
+	}
+	ny = lower - upper + 1;
+	m = (n < 0) ? -n : n;
+	if (m >= ny) {
+		tty_shadow_invalidate(tty, 0, upper, UINT_MAX, ny);
+		return;
+	}
+
+	lines = xreallocarray(NULL, m, sizeof *lines);
+	if (n > 0) {
+		memcpy(lines, &tty->shadow[upper], m * sizeof *lines);
+		memmove(&tty->shadow[upper], &tty->shadow[upper + m],
+		    (ny - m) * sizeof *lines);
+		memcpy(&tty->shadow[lower + 1 - m], lines, m * sizeof *lines);
+		tty_shadow_invalidate(tty, 0, lower + 1 - m, UINT_MAX, m);
+	} else {
+		memcpy(lines, &tty->shadow[lower + 1 - m], m * sizeof *lines);
+		memmove(&tty->shadow[upper + m], &tty->shadow[upper],
+		    (ny - m) * sizeof *lines);
+		memcpy(&tty->shadow[upper], lines, m * sizeof *lines);
+		tty_shadow_invalidate(tty, 0, upper, UINT_MAX, m);
+	}
+	free(lines);
+}
+
+/* Update the shadow for a capability about to be written. */
+static void
+tty_shadow_code(struct tty *tty, enum tty_code_code code, u_int n)
+{
+	u_int	cx = tty->cx, cy = tty->cy;
+
+	if (tty->shadow == NULL || (tty->flags & TTY_SHADOWING))
+		return;
+
+	switch (code) {
+	case TTYC_CLEAR:
+	case TTYC_SMCUP:
+	case TTYC_RMCUP:
+		tty_shadow_invalidate(tty, 0, 0, UINT_MAX, UINT_MAX);
+		return;
+	case TTYC_ED:
+	case TTYC_EL:
+	case TTYC_EL1:
+	case TTYC_ECH:
+	case TTYC_ICH:
+	case TTYC_ICH1:
+	case TTYC_DCH:
+	case TTYC_DCH1:
+	case TTYC_IL:
+	case TTYC_IL1:
+	case TTYC_DL:
+	case TTYC_DL1:
+	case TTYC_INDN:
+	case TTYC_RI:
+	case TTYC_RIN:
+		break;
+	default:
+		return;
+	}
+	if (cx == UINT_MAX || cy == UINT_MAX) {
+		tty_shadow_invalidate(tty, 0, 0, UINT_MAX, UINT_MAX);
+		return;
+	}
+	if (cx >= tty->shadow_sx)
+		cx = tty->shadow_sx - 1;
+
+	switch (code) {
+	case TTYC_ED:
+		tty_shadow_invalidate(tty, 0, cy, UINT_MAX, UINT_MAX);
+		break;
+	case TTYC_EL:
+	case TTYC_ICH:
+	case TTYC_ICH1:
+	case TTYC_DCH:
+	case TTYC_DCH1:
+		tty_shadow_invalidate(tty, cx, cy, UINT_MAX, 1);
+		break;
+	case TTYC_EL1:
+		tty_shadow_invalidate(tty, 0, cy, cx + 1, 1);
+		break;
+	case TTYC_ECH:
+		tty_shadow_invalidate(tty, cx, cy, n, 1);
+		break;
+	case TTYC_IL:
+	case TTYC_IL1:
+		if (cy < tty->rupper || cy > tty->rlower)
+			tty_shadow_invalidate(tty, 0, 0, UINT_MAX, UINT_MAX);
+		else
+			tty_shadow_scroll(tty, cy, tty->rlower, -(int)n);
+		break;
+	case TTYC_DL:
+	case TTYC_DL1:
+		if (cy < tty->rupper || cy > tty->rlower)
+			tty_shadow_invalidate(tty, 0, 0, UINT_MAX, UINT_MAX);
+		else
+			tty_shadow_scroll(tty, cy, tty->rlower, n);
+		break;
+	case TTYC_INDN:
+		tty_shadow_scroll(tty, tty->rupper, tty->rlower, n);
+		break;
+	case TTYC_RI:
+		if (cy == tty->rupper)
+			tty_shadow_scroll(tty, tty->rupper, tty->rlower, -1);
+		break;
+	case TTYC_RIN:
+		tty_shadow_scroll(tty, tty->rupper, tty->rlower, -(int)n);
+		break;
+	default:
+		break;
+	}
+}
+
+/* Update the shadow for text about to be written at the cursor. */
+static void
+tty_shadow_text(struct tty *tty, u_int width)
+{
+	u_int	cx = tty->cx, cy = tty->cy;
+
+	if (tty->shadow == NULL || (tty->flags & TTY_SHADOWING))
+		return;
+
+	if (cx == UINT_MAX || cy == UINT_MAX)
+		tty_shadow_invalidate(tty, 0, 0, UINT_MAX, UINT_MAX);
+	else if (cx < tty->shadow_sx && width <= tty->shadow_sx - cx)
+		tty_shadow_invalidate(tty, cx, cy, width, 1);
+	else if (cy == tty->rlower || cy + 1 >= tty->shadow_sy)
+		tty_shadow_invalidate(tty, 0, 0, UINT_MAX, UINT_MAX);
+	else
+		tty_shadow_invalidate(tty, 0, cy, UINT_MAX, 2);
+}
+
+/* Update the shadow for a newline about to be written. */
+static void
+tty_shadow_newline(struct tty *tty)
+{
+	u_int	cy = tty->cy;
+
+	if (tty->shadow == NULL || (tty->flags & TTY_SHADOWING))
+		return;
+
+	if (cy == UINT_MAX)
+		tty_shadow_invalidate(tty, 0, 0, UINT_MAX, UINT_MAX);
+	else if (cy == tty->rlower)
+		tty_shadow_scroll(tty, tty->rupper, tty->rlower, 1);
+	else if (cy + 1 >= tty->shadow_sy)
+		tty_shadow_invalidate(tty, 0, 0, UINT_MAX, UINT_MAX);
+}
+
+/* Record a cell written with tty_cell(). */
+static void
+tty_shadow_written(struct tty *tty, u_int px, u_int py,
+    const struct grid_cell *gc, const struct grid_cell *defaults,
+    struct colour_palette *palette)
+{
+	struct tty_shadow_cell	sc;
+
+	if (tty->shadow == NULL ||
+	    px >= tty->shadow_sx ||
+	    py >= tty->shadow_sy ||
+	    ((tty->term->flags & TERM_NOAM) && py == tty->sy - 1))
+		return;
+	tty_shadow_make(tty, gc, defaults, palette, &sc);
+	if (tty_shadow_check(tty, &sc))
+		tty_shadow_set(tty, px, py, &sc);
+}
+
+/* Is this cell already on the terminal at px,py? */
+int
+tty_cell_shown(struct tty *tty, u_int px, u_int py, const struct grid_cell *gc,
+    const struct grid_cell *defaults, struct colour_palette *palette)
+{
+	struct tty_shadow_cell	sc;
+
+	if (tty->shadow == NULL || (gc->flags & GRID_FLAG_PADDING))
+		return (0);
+	gc = tty_check_codeset(tty, gc);
+	tty_shadow_make(tty, gc, defaults, palette, &sc);
+	return (tty_shadow_same(tty, px, py, &sc, sc.width));
+}
+
 void
 tty_draw_line(struct tty *tty, struct screen *s, u_int px, u_int py, u_int nx,
     u_int atx, u_int aty, const struct grid_cell *defaults,
@@ -1449,9 +2014,11 @@ tty_draw_line(struct tty *tty, struct screen *s, u_int px, u_int py, u_int nx,
 	struct grid_line	*gl;
 	struct client		*c = tty->client;
 	struct overlay_ranges	 r;
+	struct tty_shadow_cell	 sc, run, clear;
 	u_int			 i, j, ux, sx, width, hidden, eux, nxx;
 	u_int			 cellsize;
 	int			 flags, cleared = 0, wrapped = 0;
+	int			 shadowing, shadow, same = 0, run_same = 0;
 	char			 buf[512];
 	size_t			 len;
 
@@ -1466,8 +2033,13 @@ tty_draw_line(struct tty *tty, struct screen *s, u_int px, u_int py, u_int nx,
 	 * atx,aty is the line on the terminal to draw it.
 	 */
 
+	/*
+	 * The shadow is updated here rather than as each sequence is written,
+	 * so that cells already on the terminal can be skipped.
+	 */
 	flags = (tty->flags & TTY_NOCURSOR);
-	tty->flags |= TTY_NOCURSOR;
+	shadowing = (tty->flags & TTY_SHADOWING);
+	tty->flags |= (TTY_NOCURSOR|TTY_SHADOWING);
 	tty_update_mode(tty, tty->mode, s);
 
 	tty_region_off(tty);
@@ -1489,6 +2061,11 @@ tty_draw_line(struct tty *tty, struct screen *s, u_int px, u_int py, u_int nx,
 		sx = nx;
 	ux = 0;
 
+	memcpy(&gc, &grid_default_cell, sizeof gc);
+	gc.flags |= GRID_FLAG_CLEARED;
+	tty_shadow_make(tty, &gc, defaults, palette, &clear);
+	shadow = tty_shadow_any(tty, atx, aty, nx);
+
 	if (py == 0)
 		gl = NULL;
 	else
@@ -1498,7 +2075,8 @@ tty_draw_line(struct tty *tty, struct screen *s, u_int px, u_int py, u_int nx,
 	    atx != 0 ||
 	    tty->cx < tty->sx ||
 	    nx < tty->sx) {
-		if (nx < tty->sx &&
+		if (!shadow &&
+		    nx < tty->sx &&
 		    atx == 0 &&
 		    px + sx != nx &&
 		    tty_term_has(tty->term, TTYC_EL1) &&
@@ -1509,6 +2087,11 @@ tty_draw_line(struct tty *tty, struct screen *s, u_int px, u_int py, u_int nx,
 			tty_cursor(tty, nx - 1, aty);
 			tty_putcode(tty, TTYC_EL1);
 			cleared = 1;
+			if (tty_shadow_check(tty, &clear)) {
+				tty_shadow_fill(tty, 0, aty, nx, &clear);
+				shadow = 1;
+			} else
+				tty_shadow_invalidate(tty, 0, aty, nx, 1);
 		}
 	} else {
 		log_debug("%s: wrapped line %u", __func__, aty);
@@ -1522,8 +2105,18 @@ tty_draw_line(struct tty *tty, struct screen *s, u_int px, u_int py, u_int nx,
 	for (i = 0; i < sx; i++) {
 		grid_view_get_cell(gd, px + i, py, &gc);
 		gcp = tty_check_codeset(tty, &gc);
+		if (~gcp->flags & GRID_FLAG_PADDING) {
+			tty_shadow_make(tty, gcp, defaults, palette, &sc);
+			same = (shadow &&
+			    !wrapped &&
+			    tty_shadow_same(tty, atx + ux + width, aty, &sc,
+			    sc.width));
+		}
 		if (len != 0 &&
 		    (!tty_check_overlay(tty, atx + ux + width, aty) ||
+		    (gcp->data.width > 1 &&
+		    !tty_check_overlay(tty, atx + ux + width +
+		    gcp->data.width - 1, aty)) ||
 		    (gcp->attr & GRID_ATTR_CHARSET) ||
 		    gcp->flags != last.flags ||
 		    gcp->attr != last.attr ||
@@ -1532,17 +2125,33 @@ tty_draw_line(struct tty *tty, struct screen *s, u_int px, u_int py, u_int nx,
 		    gcp->us != last.us ||
 		    gcp->link != last.link ||
 		    ux + width + gcp->data.width > nx ||
+		    same != run_same ||
 		    (sizeof buf) - len < gcp->data.size)) {
-			tty_attributes(tty, &last, defaults, palette,
-			    s->hyperlinks);
-			if (last.flags & GRID_FLAG_CLEARED) {
+			if (run_same)
+				log_debug("%s: %zu unchanged", __func__, len);
+			else if (last.flags & GRID_FLAG_CLEARED) {
+				tty_attributes(tty, &last, defaults, palette,
+				    s->hyperlinks);
 				log_debug("%s: %zu cleared", __func__, len);
 				tty_clear_line(tty, defaults, aty, atx + ux,
 				    width, last.bg);
+				if (tty_shadow_check(tty, &run)) {
+					tty_shadow_fill(tty, atx + ux, aty,
+					    width, &run);
+				} else {
+					tty_shadow_invalidate(tty, atx + ux,
+					    aty, width, 1);
+				}
 			} else {
+				tty_attributes(tty, &last, defaults, palette,
+				    s->hyperlinks);
 				if (!wrapped || atx != 0 || ux != 0)
 					tty_cursor(tty, atx + ux, aty);
 				tty_putn(tty, buf, len, width);
+				if (!tty_shadow_check(tty, &run)) {
+					tty_shadow_invalidate(tty, atx + ux,
+					    aty, width, 1);
+				}
 			}
 			ux += width;
 
@@ -1580,46 +2189,87 @@ tty_draw_line(struct tty *tty, struct screen *s, u_int px, u_int py, u_int nx,
 						if (r.nx[j] > nxx)
 							r.nx[j] = nxx;
 						tty_repeat_space(tty, r.nx[j]);
+						tty_shadow_invalidate(tty,
+						    r.px[j], aty, r.nx[j], 1);
 						ux = eux + r.nx[j];
 					}
 				}
 			}
 		} else if (gcp->attr & GRID_ATTR_CHARSET) {
-			tty_attributes(tty, &last, defaults, palette,
-			    s->hyperlinks);
-			tty_cursor(tty, atx + ux, aty);
-			for (j = 0; j < gcp->data.size; j++)
-				tty_putc(tty, gcp->data.data[j]);
+			if (!same) {
+				tty_attributes(tty, &last, defaults, palette,
+				    s->hyperlinks);
+				tty_cursor(tty, atx + ux, aty);
+				for (j = 0; j < gcp->data.size; j++)
+					tty_putc(tty, gcp->data.data[j]);
+				if (tty_shadow_check(tty, &sc))
+					tty_shadow_set(tty, atx + ux, aty, &sc);
+				else {
+					tty_shadow_invalidate(tty, atx + ux,
+					    aty, gcp->data.width, 1);
+				}
+			}
 			ux += gcp->data.width;
 		} else if (~gcp->flags & GRID_FLAG_PADDING) {
+			if (len == 0) {
+				memcpy(&run, &sc, sizeof run);
+				run_same = same;
+			}
+			if (!same && (~gcp->flags & GRID_FLAG_CLEARED))
+				tty_shadow_set(tty, atx + ux + width, aty, &sc);
 			memcpy(buf + len, gcp->data.data, gcp->data.size);
 			len += gcp->data.size;
 			width += gcp->data.width;
 		}
 	}
 	if (len != 0 && ((~last.flags & GRID_FLAG_CLEARED) || last.bg != 8)) {
-		tty_attributes(tty, &last, defaults, palette, s->hyperlinks);
-		if (last.flags & GRID_FLAG_CLEARED) {
+		if (run_same)
+			log_debug("%s: %zu unchanged (end)", __func__, len);
+		else if (last.flags & GRID_FLAG_CLEARED) {
+			tty_attributes(tty, &last, defaults, palette,
+			    s->hyperlinks);
 			log_debug("%s: %zu cleared (end)", __func__, len);
 			tty_clear_line(tty, defaults, aty, atx + ux, width,
 			    last.bg);
+			if (tty_shadow_check(tty, &run))
+				tty_shadow_fill(tty, atx + ux, aty, width, &run);
+			else
+				tty_shadow_invalidate(tty, atx + ux, aty, width, 1);
 		} else {
+			tty_attributes(tty, &last, defaults, palette,
+			    s->hyperlinks);
 			if (!wrapped || atx != 0 || ux != 0)
 				tty_cursor(tty, atx + ux, aty);
 			tty_putn(tty, buf, len, width);
+			if (!tty_shadow_check(tty, &run))
+				tty_shadow_invalidate(tty, atx + ux, aty, width, 1);
 		}
 		ux += width;
 	}
 
+	/* Leave the end of the line alone if it is already clear. */
+	if (!cleared && shadow) {
+		while (ux < nx && tty_shadow_same(tty, atx + ux, aty, &clear, 1))
+			ux++;
+	}
 	if (!cleared && ux < nx) {
 		log_debug("%s: %u to end of line (%zu cleared)", __func__,
 		    nx - ux, len);
 		tty_default_attributes(tty, defaults, palette, 8,
 		    s->hyperlinks);
 		tty_clear_line(tty, defaults, aty, atx + ux, nx - ux, 8);
+		if (tty_shadow_check(tty, &clear))
+			tty_shadow_fill(tty, atx + ux, aty, nx - ux, &clear);
+		else
+			tty_shadow_invalidate(tty, atx + ux, aty, nx - ux, 1);
 	}
 
-	tty->flags = (tty->flags & ~TTY_NOCURSOR) | flags;
+	/* The last cell is not written on terminals without margins. */
+	if ((tty->term->flags & TERM_NOAM) && aty == tty->sy - 1)
+		tty_shadow_invalidate(tty, tty->sx - 1, aty, 1, 1);
+
+	tty->flags &= ~(TTY_NOCURSOR|TTY_SHADOWING);
+	tty->flags |= (flags|shadowing);
 	tty_update_mode(tty, tty->mode, s);
 }
 
@@ -2184,6 +2834,28 @@ tty_cmd_cell(struct tty *tty, const struct tty_ctx *ctx)
 		tty_invalidate(tty);
 }
 
+/* Redraw instead if cells are partly outside a window bigger than the tty. */
+static int
+tty_cells_redraw(struct tty *tty, const struct tty_ctx *ctx)
+{
+	if (!ctx->bigger ||
+	    (ctx->xoff + ctx->ocx >= ctx->wox &&
+	    ctx->xoff + ctx->ocx + ctx->num <= ctx->wox + ctx->wsx))
+		return (0);
+
+	if (!ctx->wrapped ||
+	    !tty_full_width(tty, ctx) ||
+	    (tty->term->flags & TERM_NOAM) ||
+	    ctx->xoff + ctx->ocx != 0 ||
+	    ctx->yoff + ctx->ocy != tty->cy + 1 ||
+	    tty->cx < tty->sx ||
+	    tty->cy == tty->rlower)
+		tty_draw_pane(tty, ctx, ctx->ocy);
+	else
+		ctx->redraw_cb(ctx);
+	return (1);
+}
+
 void
 tty_cmd_cells(struct tty *tty, const struct tty_ctx *ctx)
 {
@@ -2193,22 +2865,8 @@ tty_cmd_cells(struct tty *tty, const struct tty_ctx *ctx)
 
 	if (!tty_is_visible(tty, ctx, ctx->ocx, ctx->ocy, ctx->num, 1))
 		return;
-
-	if (ctx->bigger &&
-	    (ctx->xoff + ctx->ocx < ctx->wox ||
-	    ctx->xoff + ctx->ocx + ctx->num > ctx->wox + ctx->wsx)) {
-		if (!ctx->wrapped ||
-		    !tty_full_width(tty, ctx) ||
-		    (tty->term->flags & TERM_NOAM) ||
-		    ctx->xoff + ctx->ocx != 0 ||
-		    ctx->yoff + ctx->ocy != tty->cy + 1 ||
-		    tty->cx < tty->sx ||
-		    tty->cy == tty->rlower)
-			tty_draw_pane(tty, ctx, ctx->ocy);
-		else
-			ctx->redraw_cb(ctx);
+	if (tty_cells_redraw(tty, ctx))
 		return;
-	}
 
 	tty_margin_off(tty);
 	tty_cursor_pane_unless_wrap(tty, ctx, ctx->ocx, ctx->ocy);
@@ -2230,25 +2888,68 @@ tty_cmd_cells(struct tty *tty, const struct tty_ctx *ctx)
 }
 
 void
-tty_cmd_setselection(struct tty *tty, const struct tty_ctx *ctx)
-{
-	tty_set_selection(tty, ctx->ptr2, ctx->ptr, ctx->num);
-}
-
-void
-tty_set_selection(struct tty *tty, const char *flags, const char *buf,
-    size_t len)
+tty_cmd_utf8cells(struct tty *tty, const struct tty_ctx *ctx)
 {
-	char	*encoded;
-	size_t	 size;
+	struct overlay_ranges	 r;
+	struct grid_cell	 gc;
+	const utf8_char		*uc = ctx->ptr;
+	u_int			 i, px, py;
 
-	if (~tty->flags & TTY_STARTED)
+	if (!tty_is_visible(tty, ctx, ctx->ocx, ctx->ocy, ctx->num, 1))
 		return;
-	if (!tty_term_has(tty->term, TTYC_MS))
+	if (tty_cells_redraw(tty, ctx))
 		return;
 
-	size = 4 * ((len + 2) / 3) + 1; /* storage for base64 */
-	encoded = xmalloc(size);
+	/* Wide characters cannot be split, so redraw if under an overlay. */
+	px = ctx->xoff + ctx->ocx - ctx->wox;
+	py = ctx->yoff + ctx->ocy - ctx->woy;
+	tty_check_overlay_range(tty, px, py, ctx->num, &r);
+	if (r.nx[0] != ctx->num) {
+		tty_draw_pane(tty, ctx, ctx->ocy);
+		return;
+	}
+
+	tty_margin_off(tty);
+	tty_cursor_pane_unless_wrap(tty, ctx, ctx->ocx, ctx->ocy);
+
+	/*
+	 * Padding without its character or a character cut off at the end has
+	 * been partly overwritten, so is drawn as a space.
+	 */
+	memcpy(&gc, ctx->cell, sizeof gc);
+	for (i = 0; i < ctx->num; i += gc.data.width) {
+		if (uc[i] == 0)
+			utf8_set(&gc.data, ' ');
+		else {
+			utf8_to_data(uc[i], &gc.data);
+			if (gc.data.width > ctx->num - i)
+				utf8_set(&gc.data, ' ');
+		}
+		tty_cell(tty, &gc, &ctx->defaults, ctx->palette,
+		    ctx->s->hyperlinks);
+	}
+}
+
+void
+tty_cmd_setselection(struct tty *tty, const struct tty_ctx *ctx)
+{
+	tty_set_selection(tty, ctx->ptr2, ctx->ptr, ctx->num);
+}
+
+void
+tty_set_selection(struct tty *tty, const char *flags, const char *buf,
+    size_t len)
+{
+	char	*encoded;
+	size_t	 size;
+
+	if (~tty->flags & TTY_STARTED)
+		return;
+	if (!tty_term_has(tty->term, TTYC_MS))
+		return;
+
+	size = 4 * ((len + 2) / 3) + 1; /* storage for base64 */
+	encoded = xmalloc(size);
 
 	b64_ntop(buf, len, encoded, size);
 	tty->flags |= TTY_NOBLOCK;
@@ -2263,6 +2964,7 @@ tty_cmd_rawstring(struct tty *tty, const struct tty_ctx *ctx)
 	tty->flags |= TTY_NOBLOCK;
 	tty_add(tty, ctx->ptr, ctx->num);
 	tty_invalidate(tty);
+	tty_shadow_invalidate(tty, 0, 0, UINT_MAX, UINT_MAX);
 }
 
 #ifdef ENABLE_SIXEL
@@ -2309,6 +3011,7 @@ tty_cmd_sixelimage(struct tty *tty, const struct tty_ctx *ctx)
 		tty->flags |= TTY_NOBLOCK;
 		tty_add(tty, data, size);
 		tty_invalidate(tty);
+		tty_shadow_invalidate(tty, 0, 0, UINT_MAX, UINT_MAX);
 		free(data);
 	}
 
@@ -2342,6 +3045,7 @@ tty_cell(struct tty *tty, const struct grid_cell *gc,
     struct hyperlinks *hl)
 {
 	const struct grid_cell	*gcp;
+	u_int			 cx = tty->cx, cy = tty->cy;
 
 	/* Skip last character if terminal is stupid. */
 	if ((tty->term->flags & TERM_NOAM) &&
@@ -2363,11 +3067,12 @@ tty_cell(struct tty *tty, const struct grid_cell *gc,
 		if (*gcp->data.data < 0x20 || *gcp->data.data == 0x7f)
 			return;
 		tty_putc(tty, *gcp->data.data);
-		return;
+	} else {
+		/* Write the data. */
+		tty_putn(tty, gcp->data.data, gcp->data.size,
+		    gcp->data.width);
 	}
-
-	/* Write the data. */
-	tty_putn(tty, gcp->data.data, gcp->data.size, gcp->data.width);
+	tty_shadow_written(tty, cx, cy, gcp, defaults, palette);
 }
 
 void
@@ -2519,13 +3224,222 @@ tty_cursor_pane(struct tty *tty, const struct tty_ctx *ctx, u_int cx, u_int cy)
 	tty_cursor(tty, ctx->xoff + cx - ctx->wox, ctx->yoff + cy - ctx->woy);
 }
 
+/* Use a way of moving the cursor if it is cheaper than the best so far. */
+static void
+tty_move_try(struct tty_move *m, enum tty_move_type type,
+    enum tty_code_code code, u_int n, u_int cost)
+{
+	if (cost >= m->cost)
+		return;
+	m->type = type;
+	m->code = code;
+	m->n = n;
+	m->cost = cost;
+}
+
+/* Try a capability with an argument. */
+static void
+tty_move_try_code(struct tty *tty, struct tty_move *m, enum tty_code_code code,
+    u_int n)
+{
+	if (tty_term_has(tty->term, code)) {
+		tty_move_try(m, TTY_MOVE_CODE, code, n,
+		    strlen(tty_term_string_i(tty->term, code, n)));
+	}
+}
+
+/* Try a capability without an argument repeated. */
+static void
+tty_move_try_repeat(struct tty *tty, struct tty_move *m,
+    enum tty_code_code code, u_int n)
+{
+	if (tty_term_has(tty->term, code)) {
+		tty_move_try(m, TTY_MOVE_REPEAT, code, n,
+		    n * strlen(tty_term_string(tty->term, code)));
+	}
+}
+
+/*
+ * Can the cursor be moved right by writing again the cells already there?
+ * Only plain ASCII cells with the current attributes can be used.
+ */
+static int
+tty_move_overwrite(struct tty *tty, u_int px, u_int py, u_int nx)
+{
+	struct tty_shadow_line	*sl;
+	struct tty_shadow_cell	*sc;
+	struct grid_cell	*gc = &tty->cell;
+	u_int			 x;
+
+	if (tty->shadow == NULL ||
+	    py >= tty->shadow_sy ||
+	    px >= tty->shadow_sx ||
+	    nx > tty->shadow_sx - px)
+		return (0);
+	if (gc->link != 0 || (gc->attr & GRID_ATTR_CHARSET))
+		return (0);
+
+	sl = &tty->shadow[py];
+	if (sl->start < sl->end && px < sl->end && px + nx > sl->start)
+		return (0);
+	for (x = px; x < px + nx; x++) {
+		sc = &sl->cells[x];
+		if (sc->flags != 0 ||
+		    sc->size != 1 ||
+		    sc->width != 1 ||
+		    sc->data < 0x20 ||
+		    sc->data > 0x7e ||
+		    sc->fg != gc->fg ||
+		    sc->bg != gc->bg ||
+		    sc->us != gc->us ||
+		    sc->attr != gc->attr)
+			return (0);
+	}
+	return (1);
+}
+
+/* Find the cheapest way to move the cursor from line py to cy. */
+static void
+tty_move_vertical(struct tty *tty, u_int py, u_int cy, struct tty_move *m)
+{
+	memset(m, 0, sizeof *m);
+	if (cy == py) {
+		m->type = TTY_MOVE_NONE;
+		return;
+	}
+	m->cost = UINT_MAX;
+
+	tty_move_try_code(tty, m, TTYC_VPA, cy);
+
+	/*
+	 * Relative movement stops at the scroll region, so it can only be used
+	 * if the movement does not cross it. Moving down with a newline is
+	 * fine as long as it is not at the bottom of the region.
+	 */
+	if (tty->rupper == UINT_MAX || tty->rlower == UINT_MAX)
+		return;
+	if (cy < py && (py < tty->rupper || cy >= tty->rupper)) {
+		tty_move_try_repeat(tty, m, TTYC_CUU1, py - cy);
+		tty_move_try_code(tty, m, TTYC_CUU, py - cy);
+	}
+	if (cy > py && (py > tty->rlower || cy <= tty->rlower)) {
+		tty_move_try(m, TTY_MOVE_CHAR, TTYC_CUD1, cy - py, cy - py);
+		tty_move_try_repeat(tty, m, TTYC_CUD1, cy - py);
+		tty_move_try_code(tty, m, TTYC_CUD, cy - py);
+	}
+}
+
+/*
+ * Find the cheapest way to move the cursor right from px to cx on line cy. If
+ * overwriting is cheaper than other movement, it is used.
+ */
+static void
+tty_move_right(struct tty *tty, u_int px, u_int cx, u_int cy,
+    struct tty_move *m)
+{
+	tty_move_try_repeat(tty, m, TTYC_CUF1, cx - px);
+	tty_move_try_code(tty, m, TTYC_CUF, cx - px);
+	if (cx - px < m->cost && tty_move_overwrite(tty, px, cy, cx - px))
+		tty_move_try(m, TTY_MOVE_OVERWRITE, TTYC_CUF, cx - px, cx - px);
+}
+
+/*
+ * Find the cheapest way to move the cursor from column px to cx on line cy.
+ * Sets cr if the movement starts with a carriage return.
+ */
+static void
+tty_move_horizontal(struct tty *tty, u_int px, u_int cx, u_int cy,
+    struct tty_move *m, int *cr)
+{
+	struct tty_move	rm;
+	int		full;
+
+	*cr = 0;
+	memset(m, 0, sizeof *m);
+	if (cx == px) {
+		m->type = TTY_MOVE_NONE;
+		return;
+	}
+	m->cost = UINT_MAX;
+
+	tty_move_try_code(tty, m, TTYC_HPA, cx);
+
+	/* Relative movement stops at the margins. */
+	full = (!tty_use_margin(tty) ||
+	    (tty->rleft == 0 && tty->rright == tty->sx - 1));
+	if (full && cx < px) {
+		tty_move_try_repeat(tty, m, TTYC_CUB1, px - cx);
+		tty_move_try_code(tty, m, TTYC_CUB, px - cx);
+	}
+	if (full && cx > px)
+		tty_move_right(tty, px, cx, cy, m);
+
+	/* A carriage return goes to the left margin. */
+	if (tty_use_margin(tty) && tty->rleft != 0)
+		return;
+	memset(&rm, 0, sizeof rm);
+	if (cx == 0)
+		rm.type = TTY_MOVE_NONE;
+	else if (full) {
+		rm.cost = UINT_MAX;
+		tty_move_right(tty, 0, cx, cy, &rm);
+	} else
+		return;
+	if (rm.cost != UINT_MAX && 1 + rm.cost < m->cost) {
+		memcpy(m, &rm, sizeof *m);
+		*cr = 1;
+	}
+}
+
+/* Move the cursor from px,py. */
+static void
+tty_move_apply(struct tty *tty, const struct tty_move *m, u_int px, u_int py)
+{
+	struct tty_shadow_line	*sl;
+	char			 buf[32];
+	u_int			 i, j, n;
+
+	switch (m->type) {
+	case TTY_MOVE_NONE:
+		break;
+	case TTY_MOVE_CODE:
+		tty_putcode_i(tty, m->code, m->n);
+		break;
+	case TTY_MOVE_REPEAT:
+		for (i = 0; i < m->n; i++)
+			tty_putcode(tty, m->code);
+		break;
+	case TTY_MOVE_CHAR:
+		for (i = 0; i < m->n; i++)
+			tty_putc(tty, '\n');
+		break;
+	case TTY_MOVE_OVERWRITE:
+		/*
+		 * The cells are the same as those on the terminal, so write
+		 * them directly rather than with tty_putn and leave the shadow
+		 * alone.
+		 */
+		sl = &tty->shadow[py];
+		for (i = 0; i < m->n; i += n) {
+			n = m->n - i;
+			if (n > sizeof buf)
+				n = sizeof buf;
+			for (j = 0; j < n; j++)
+				buf[j] = sl->cells[px + i + j].data;
+			tty_add(tty, buf, n);
+		}
+		break;
+	}
+}
+
 /* Move cursor to absolute position. */
 void
 tty_cursor(struct tty *tty, u_int cx, u_int cy)
 {
 	struct tty_term	*term = tty->term;
-	u_int		 thisx, thisy;
-	int		 change;
+	struct tty_move	 vm, hm;
+	u_int		 thisx, thisy, cost;
+	int		 cr;
 
 	if (tty->flags & TTY_BLOCK)
 		return;
@@ -2548,115 +3462,42 @@ tty_cursor(struct tty *tty, u_int cx, u_int cy)
 	if (cx == thisx && cy == thisy)
 		return;
 
-	/* Currently at the very end of the line - use absolute movement. */
-	if (thisx > tty->sx - 1)
+	/*
+	 * Currently at the very end of the line or position not known - use
+	 * absolute movement.
+	 */
+	if (thisx > tty->sx - 1 || thisy == UINT_MAX)
 		goto absolute;
 
-	/* Move to home position (0, 0). */
-	if (cx == 0 && cy == 0 && tty_term_has(term, TTYC_HOME)) {
-		tty_putcode(tty, TTYC_HOME);
-		goto out;
-	}
+	/*
+	 * Work out the cheapest way to move in each direction. Vertical
+	 * movement is done first so that any horizontal movement by rewriting
+	 * cells is on the right line.
+	 */
+	tty_move_vertical(tty, thisy, cy, &vm);
+	tty_move_horizontal(tty, thisx, cx, cy, &hm, &cr);
+	if (vm.cost != UINT_MAX && hm.cost != UINT_MAX)
+		cost = vm.cost + hm.cost + cr;
+	else
+		cost = UINT_MAX;
 
-	/* Zero on the next line. */
-	if (cx == 0 && cy == thisy + 1 && thisy != tty->rlower &&
-	    (!tty_use_margin(tty) || tty->rleft == 0)) {
-		tty_putc(tty, '\r');
-		tty_putc(tty, '\n');
+	/* Move to home position (0, 0) if it is cheaper. */
+	if (cx == 0 && cy == 0 && tty_term_has(term, TTYC_HOME) &&
+	    strlen(tty_term_string(term, TTYC_HOME)) <= cost) {
+		tty_putcode(tty, TTYC_HOME);
 		goto out;
 	}
 
-	/* Moving column or row. */
-	if (cy == thisy) {
-		/*
-		 * Moving column only, row staying the same.
-		 */
-
-		/* To left edge. */
-		if (cx == 0 && (!tty_use_margin(tty) || tty->rleft == 0)) {
-			tty_putc(tty, '\r');
-			goto out;
-		}
-
-		/* One to the left. */
-		if (cx == thisx - 1 && tty_term_has(term, TTYC_CUB1)) {
-			tty_putcode(tty, TTYC_CUB1);
-			goto out;
-		}
-
-		/* One to the right. */
-		if (cx == thisx + 1 && tty_term_has(term, TTYC_CUF1)) {
-			tty_putcode(tty, TTYC_CUF1);
-			goto out;
-		}
-
-		/* Calculate difference. */
-		change = thisx - cx;	/* +ve left, -ve right */
-
-		/*
-		 * Use HPA if change is larger than absolute, otherwise move
-		 * the cursor with CUB/CUF.
-		 */
-		if ((u_int) abs(change) > cx && tty_term_has(term, TTYC_HPA)) {
-			tty_putcode_i(tty, TTYC_HPA, cx);
-			goto out;
-		} else if (change > 0 &&
-		    tty_term_has(term, TTYC_CUB) &&
-		    !tty_use_margin(tty)) {
-			if (change == 2 && tty_term_has(term, TTYC_CUB1)) {
-				tty_putcode(tty, TTYC_CUB1);
-				tty_putcode(tty, TTYC_CUB1);
-				goto out;
-			}
-			tty_putcode_i(tty, TTYC_CUB, change);
-			goto out;
-		} else if (change < 0 &&
-		    tty_term_has(term, TTYC_CUF) &&
-		    !tty_use_margin(tty)) {
-			tty_putcode_i(tty, TTYC_CUF, -change);
-			goto out;
-		}
-	} else if (cx == thisx) {
-		/*
-		 * Moving row only, column staying the same.
-		 */
-
-		/* One above. */
-		if (thisy != tty->rupper &&
-		    cy == thisy - 1 && tty_term_has(term, TTYC_CUU1)) {
-			tty_putcode(tty, TTYC_CUU1);
-			goto out;
-		}
-
-		/* One below. */
-		if (thisy != tty->rlower &&
-		    cy == thisy + 1 && tty_term_has(term, TTYC_CUD1)) {
-			tty_putcode(tty, TTYC_CUD1);
-			goto out;
-		}
-
-		/* Calculate difference. */
-		change = thisy - cy;	/* +ve up, -ve down */
+	/* Use absolute movement if it is cheaper. */
+	if (cost == UINT_MAX ||
+	    strlen(tty_term_string_ii(term, TTYC_CUP, cy, cx)) < cost)
+		goto absolute;
 
-		/*
-		 * Try to use VPA if change is larger than absolute or if this
-		 * change would cross the scroll region, otherwise use CUU/CUD.
-		 */
-		if ((u_int) abs(change) > cy ||
-		    (change < 0 && cy - change > tty->rlower) ||
-		    (change > 0 && cy - change < tty->rupper)) {
-			    if (tty_term_has(term, TTYC_VPA)) {
-				    tty_putcode_i(tty, TTYC_VPA, cy);
-				    goto out;
-			    }
-		} else if (change > 0 && tty_term_has(term, TTYC_CUU)) {
-			tty_putcode_i(tty, TTYC_CUU, change);
-			goto out;
-		} else if (change < 0 && tty_term_has(term, TTYC_CUD)) {
-			tty_putcode_i(tty, TTYC_CUD, -change);
-			goto out;
-		}
-	}
+	if (cr)
+		tty_putc(tty, '\r');
+	tty_move_apply(tty, &vm, thisx, cy);
+	tty_move_apply(tty, &hm, cr ? 0 : thisx, cy);
+	goto out;
 
 absolute:
 	/* Absolute movement. */
@@ -2692,7 +3533,8 @@ tty_attributes(struct tty *tty, const struct grid_cell *gc,
     struct hyperlinks *hl)
 {
 	struct grid_cell	*tc = &tty->cell, gc2;
-	int			 changed;
+	int			 changed, attr;
+	u_int			 i;
 
 	/* Copy cell and update default colours. */
 	memcpy(&gc2, gc, sizeof gc2);
@@ -2711,25 +3553,12 @@ tty_attributes(struct tty *tty, const struct grid_cell *gc,
 		gc2.link == tty->last_cell.link)
 		return;
 
-	/*
-	 * If no setab, try to use the reverse attribute as a best-effort for a
-	 * non-default background. This is a bit of a hack but it doesn't do
-	 * any serious harm and makes a couple of applications happier.
-	 */
-	if (!tty_term_has(tty->term, TTYC_SETAB)) {
-		if (gc2.attr & GRID_ATTR_REVERSE) {
-			if (gc2.fg != 7 && !COLOUR_DEFAULT(gc2.fg))
-				gc2.attr &= ~GRID_ATTR_REVERSE;
-		} else {
-			if (gc2.bg != 0 && !COLOUR_DEFAULT(gc2.bg))
-				gc2.attr |= GRID_ATTR_REVERSE;
-		}
-	}
+	/* Fix up the attributes and colours for the terminal. */
+	tty_check_attributes(tty, palette, &gc2);
 
-	/* Fix up the colours if necessary. */
-	tty_check_fg(tty, palette, &gc2);
-	tty_check_bg(tty, palette, &gc2);
-	tty_check_us(tty, palette, &gc2);
+	/* Use one SGR sequence if the terminal allows it. */
+	if (tty_sgr_attributes(tty, &gc2) == 0)
+		goto out;
 
 	/*
 	 * If any bits are being cleared or the underline colour is now default,
@@ -2748,48 +3577,51 @@ tty_attributes(struct tty *tty, const struct grid_cell *gc,
 	changed = gc2.attr & ~tc->attr;
 	tc->attr = gc2.attr;
 
-	/* Set the attributes. */
-	if (changed & GRID_ATTR_BRIGHT)
-		tty_putcode(tty, TTYC_BOLD);
-	if (changed & GRID_ATTR_DIM)
-		tty_putcode(tty, TTYC_DIM);
-	if (changed & GRID_ATTR_ITALICS)
-		tty_set_italics(tty);
-	if (changed & GRID_ATTR_ALL_UNDERSCORE) {
-		if (changed & GRID_ATTR_UNDERSCORE)
-			tty_putcode(tty, TTYC_SMUL);
-		else if (changed & GRID_ATTR_UNDERSCORE_2)
-			tty_putcode_i(tty, TTYC_SMULX, 2);
-		else if (changed & GRID_ATTR_UNDERSCORE_3)
-			tty_putcode_i(tty, TTYC_SMULX, 3);
-		else if (changed & GRID_ATTR_UNDERSCORE_4)
-			tty_putcode_i(tty, TTYC_SMULX, 4);
-		else if (changed & GRID_ATTR_UNDERSCORE_5)
-			tty_putcode_i(tty, TTYC_SMULX, 5);
-	}
-	if (changed & GRID_ATTR_BLINK)
-		tty_putcode(tty, TTYC_BLINK);
-	if (changed & GRID_ATTR_REVERSE) {
-		if (tty_term_has(tty->term, TTYC_REV))
-			tty_putcode(tty, TTYC_REV);
-		else if (tty_term_has(tty->term, TTYC_SMSO))
-			tty_putcode(tty, TTYC_SMSO);
-	}
-	if (changed & GRID_ATTR_HIDDEN)
-		tty_putcode(tty, TTYC_INVIS);
-	if (changed & GRID_ATTR_STRIKETHROUGH)
-		tty_putcode(tty, TTYC_SMXX);
-	if (changed & GRID_ATTR_OVERLINE)
-		tty_putcode(tty, TTYC_SMOL);
+	/* Set the attributes. Only one underscore style is used. */
+	for (i = 0; i < nitems(tty_sgr_attrs); i++) {
+		attr = tty_sgr_attrs[i].attr;
+		if (~changed & attr)
+			continue;
+		tty_puts(tty, tty_attr_string(tty, attr));
+		if (attr & GRID_ATTR_ALL_UNDERSCORE)
+			changed &= ~GRID_ATTR_ALL_UNDERSCORE;
+	}
 	if ((changed & GRID_ATTR_CHARSET) && tty_acs_needed(tty))
 		tty_putcode(tty, TTYC_SMACS);
 
+out:
 	/* Set hyperlink if any. */
 	tty_hyperlink(tty, gc, hl);
 
 	memcpy(&tty->last_cell, &gc2, sizeof tty->last_cell);
 }
 
+/* Change attributes and colours to those the terminal can show. */
+static void
+tty_check_attributes(struct tty *tty, struct colour_palette *palette,
+    struct grid_cell *gc)
+{
+	/*
+	 * If no setab, try to use the reverse attribute as a best-effort for a
+	 * non-default background. This is a bit of a hack but it doesn't do
+	 * any serious harm and makes a couple of applications happier.
+	 */
+	if (!tty_term_has(tty->term, TTYC_SETAB)) {
+		if (gc->attr & GRID_ATTR_REVERSE) {
+			if (gc->fg != 7 && !COLOUR_DEFAULT(gc->fg))
+				gc->attr &= ~GRID_ATTR_REVERSE;
+		} else {
+			if (gc->bg != 0 && !COLOUR_DEFAULT(gc->bg))
+				gc->attr |= GRID_ATTR_REVERSE;
+		}
+	}
+
+	/* Fix up the colours if necessary. */
+	tty_check_fg(tty, palette, gc);
+	tty_check_bg(tty, palette, gc);
+	tty_check_us(tty, palette, gc);
+}
+
 static void
 tty_colours(struct tty *tty, const struct grid_cell *gc)
 {
@@ -2985,9 +3817,6 @@ tty_check_us(__unused struct tty *tty, struct colour_palette *palette,
 static void
 tty_colours_fg(struct tty *tty, const struct grid_cell *gc)
 {
-	struct grid_cell	*tc = &tty->cell;
-	char			 s[32];
-
 	/*
 	 * If the current colour is an aixterm bright colour and the new is not,
 	 * reset because some terminals do not clear bright correctly.
@@ -2997,134 +3826,372 @@ tty_colours_fg(struct tty *tty, const struct grid_cell *gc)
 	    (gc->fg < 90 || gc->fg > 97))
 		tty_reset(tty);
 
-	/* Is this a 24-bit or 256-colour colour? */
-	if (gc->fg & COLOUR_FLAG_RGB || gc->fg & COLOUR_FLAG_256) {
-		if (tty_try_colour(tty, gc->fg, "38") == 0)
-			goto save;
-		/* Should not get here, already converted in tty_check_fg. */
-		return;
-	}
+	tty_puts(tty, tty_colour_string(tty, gc->fg, 0));
+	tty->cell.fg = gc->fg;
+}
 
-	/* Is this an aixterm bright colour? */
-	if (gc->fg >= 90 && gc->fg <= 97) {
-		if (tty->term->flags & TERM_256COLOURS) {
-			xsnprintf(s, sizeof s, "\033[%dm", gc->fg);
-			tty_puts(tty, s);
-		} else
-			tty_putcode_i(tty, TTYC_SETAF, gc->fg - 90 + 8);
-		goto save;
-	}
+static void
+tty_colours_bg(struct tty *tty, const struct grid_cell *gc)
+{
+	tty_puts(tty, tty_colour_string(tty, gc->bg, 1));
+	tty->cell.bg = gc->bg;
+}
 
-	/* Otherwise set the foreground colour. */
-	tty_putcode_i(tty, TTYC_SETAF, gc->fg);
+static void
+tty_colours_us(struct tty *tty, const struct grid_cell *gc)
+{
+	tty_puts(tty, tty_us_string(tty, gc->us));
+	tty->cell.us = gc->us;
+}
 
-save:
-	/* Save the new values in the terminal current cell. */
-	tc->fg = gc->fg;
+/* Get the string to turn on one attribute. */
+static const char *
+tty_attr_string(struct tty *tty, int attr)
+{
+	struct tty_term	*term = tty->term;
+	const char	*s;
+
+	switch (attr) {
+	case GRID_ATTR_BRIGHT:
+		return (tty_term_string(term, TTYC_BOLD));
+	case GRID_ATTR_DIM:
+		return (tty_term_string(term, TTYC_DIM));
+	case GRID_ATTR_ITALICS:
+		if (tty_term_has(term, TTYC_SITM)) {
+			s = options_get_string(global_options,
+			    "default-terminal");
+			if (strcmp(s, "screen") != 0 &&
+			    strncmp(s, "screen-", 7) != 0)
+				return (tty_term_string(term, TTYC_SITM));
+		}
+		return (tty_term_string(term, TTYC_SMSO));
+	case GRID_ATTR_UNDERSCORE:
+		return (tty_term_string(term, TTYC_SMUL));
+	case GRID_ATTR_UNDERSCORE_2:
+		return (tty_term_string_i(term, TTYC_SMULX, 2));
+	case GRID_ATTR_UNDERSCORE_3:
+		return (tty_term_string_i(term, TTYC_SMULX, 3));
+	case GRID_ATTR_UNDERSCORE_4:
+		return (tty_term_string_i(term, TTYC_SMULX, 4));
+	case GRID_ATTR_UNDERSCORE_5:
+		return (tty_term_string_i(term, TTYC_SMULX, 5));
+	case GRID_ATTR_BLINK:
+		return (tty_term_string(term, TTYC_BLINK));
+	case GRID_ATTR_REVERSE:
+		if (tty_term_has(term, TTYC_REV))
+			return (tty_term_string(term, TTYC_REV));
+		return (tty_term_string(term, TTYC_SMSO));
+	case GRID_ATTR_HIDDEN:
+		return (tty_term_string(term, TTYC_INVIS));
+	case GRID_ATTR_STRIKETHROUGH:
+		return (tty_term_string(term, TTYC_SMXX));
+	case GRID_ATTR_OVERLINE:
+		return (tty_term_string(term, TTYC_SMOL));
+	}
+	return ("");
 }
 
-static void
-tty_colours_bg(struct tty *tty, const struct grid_cell *gc)
+/* Get the string to set the foreground or background colour. */
+static const char *
+tty_colour_string(struct tty *tty, int colour, int bg)
 {
-	struct grid_cell	*tc = &tty->cell;
-	char			 s[32];
+	struct tty_term	*term = tty->term;
+	static char	 buf[32];
+	const char	*s;
+	u_char		 r, g, b;
 
-	/* Is this a 24-bit or 256-colour colour? */
-	if (gc->bg & COLOUR_FLAG_RGB || gc->bg & COLOUR_FLAG_256) {
-		if (tty_try_colour(tty, gc->bg, "48") == 0)
-			goto save;
-		/* Should not get here, already converted in tty_check_bg. */
-		return;
+	/* Is this a 256-colour colour? */
+	if (colour & COLOUR_FLAG_256) {
+		colour &= 0xff;
+		if (bg)
+			return (tty_term_string_i(term, TTYC_SETAB, colour));
+		return (tty_term_string_i(term, TTYC_SETAF, colour));
 	}
 
-	/* Is this an aixterm bright colour? */
-	if (gc->bg >= 90 && gc->bg <= 97) {
-		if (tty->term->flags & TERM_256COLOURS) {
-			xsnprintf(s, sizeof s, "\033[%dm", gc->bg + 10);
-			tty_puts(tty, s);
-		} else
-			tty_putcode_i(tty, TTYC_SETAB, gc->bg - 90 + 8);
-		goto save;
+	/* Is this a 24-bit colour? Converted in tty_check_fg if not allowed. */
+	if (colour & COLOUR_FLAG_RGB) {
+		colour_split_rgb(colour & 0xffffff, &r, &g, &b);
+		if (bg)
+			s = tty_term_string_iii(term, TTYC_SETRGBB, r, g, b);
+		else
+			s = tty_term_string_iii(term, TTYC_SETRGBF, r, g, b);
+		return (s);
 	}
 
-	/* Otherwise set the background colour. */
-	tty_putcode_i(tty, TTYC_SETAB, gc->bg);
+	/* Is this an aixterm bright colour? */
+	if (colour >= 90 && colour <= 97) {
+		if (term->flags & TERM_256COLOURS) {
+			xsnprintf(buf, sizeof buf, "\033[%dm",
+			    bg ? colour + 10 : colour);
+			return (buf);
+		}
+		colour -= 90 - 8;
+	}
 
-save:
-	/* Save the new values in the terminal current cell. */
-	tc->bg = gc->bg;
+	/* Otherwise set the colour. */
+	if (bg)
+		return (tty_term_string_i(term, TTYC_SETAB, colour));
+	return (tty_term_string_i(term, TTYC_SETAF, colour));
 }
 
-static void
-tty_colours_us(struct tty *tty, const struct grid_cell *gc)
+/* Get the string to set the underscore colour. */
+static const char *
+tty_us_string(struct tty *tty, int colour)
 {
-	struct grid_cell	*tc = &tty->cell;
-	u_int			 c;
-	u_char			 r, g, b;
+	struct tty_term	*term = tty->term;
+	u_int		 c;
+	u_char		 r, g, b;
 
 	/* Clear underline colour. */
-	if (COLOUR_DEFAULT(gc->us)) {
-		tty_putcode(tty, TTYC_OL);
-		goto save;
-	}
+	if (COLOUR_DEFAULT(colour))
+		return (tty_term_string(term, TTYC_OL));
 
 	/*
 	 * If this is not an RGB colour, use Setulc1 if it exists, otherwise
 	 * convert.
 	 */
-	if (~gc->us & COLOUR_FLAG_RGB) {
-		c = gc->us;
+	if (~colour & COLOUR_FLAG_RGB) {
+		c = colour;
 		if ((~c & COLOUR_FLAG_256) && (c >= 90 && c <= 97))
 			c -= 82;
-		tty_putcode_i(tty, TTYC_SETULC1, c & ~COLOUR_FLAG_256);
-		return;
+		return (tty_term_string_i(term, TTYC_SETULC1,
+		    c & ~COLOUR_FLAG_256));
 	}
 
 	/*
 	 * Setulc and setal follows the ncurses(3) one argument "direct colour"
 	 * capability format. Calculate the colour value.
 	 */
-	colour_split_rgb(gc->us, &r, &g, &b);
+	colour_split_rgb(colour, &r, &g, &b);
 	c = (65536 * r) + (256 * g) + b;
 
 	/*
 	 * Write the colour. Only use setal if the RGB flag is set because the
 	 * non-RGB version may be wrong.
 	 */
-	if (tty_term_has(tty->term, TTYC_SETULC))
-		tty_putcode_i(tty, TTYC_SETULC, c);
-	else if (tty_term_has(tty->term, TTYC_SETAL) &&
-	    tty_term_has(tty->term, TTYC_RGB))
-		tty_putcode_i(tty, TTYC_SETAL, c);
-
-save:
-	/* Save the new values in the terminal current cell. */
-	tc->us = gc->us;
+	if (tty_term_has(term, TTYC_SETULC))
+		return (tty_term_string_i(term, TTYC_SETULC, c));
+	if (tty_term_has(term, TTYC_SETAL) && tty_term_has(term, TTYC_RGB))
+		return (tty_term_string_i(term, TTYC_SETAL, c));
+	return ("");
+}
+
+/* Add SGR parameters. */
+static void
+tty_sgr_param(struct tty_sgr *sgr, const char *s, size_t n)
+{
+	if (sgr->len + n + 1 >= sizeof sgr->buf) {
+		sgr->failed = 1;
+		return;
+	}
+	if (sgr->len != 0)
+		sgr->buf[sgr->len++] = ';';
+	memcpy(sgr->buf + sgr->len, s, n);
+	sgr->len += n;
+	sgr->buf[sgr->len] = '\0';
+}
+
+/* Add the parameters of a string which is a single SGR sequence. */
+static void
+tty_sgr_add(struct tty_sgr *sgr, const char *s)
+{
+	size_t	n;
+
+	if (*s == '\0')
+		return;
+	if (strncmp(s, "\033[", 2) != 0) {
+		sgr->failed = 1;
+		return;
+	}
+	s += 2;
+
+	n = strspn(s, "0123456789;:");
+	if (n == 0 || strcmp(s + n, "m") != 0) {
+		sgr->failed = 1;
+		return;
+	}
+	tty_sgr_param(sgr, s, n);
 }
 
+/*
+ * Check if an attribute is turned on with the expected SGR parameter, so it
+ * can be turned off on its own. Returns 0 if the terminal cannot show the
+ * attribute at all, 1 if it uses the parameter and -1 if not.
+ */
 static int
-tty_try_colour(struct tty *tty, int colour, const char *type)
+tty_sgr_standard(struct tty *tty, int attr, const char *on)
 {
-	u_char	r, g, b;
+	const char	*s = tty_attr_string(tty, attr);
+	size_t		 n = strlen(on);
 
-	if (colour & COLOUR_FLAG_256) {
-		if (*type == '3' && tty_term_has(tty->term, TTYC_SETAF))
-			tty_putcode_i(tty, TTYC_SETAF, colour & 0xff);
-		else if (tty_term_has(tty->term, TTYC_SETAB))
-			tty_putcode_i(tty, TTYC_SETAB, colour & 0xff);
+	if (*s == '\0')
 		return (0);
+	if (strncmp(s, "\033[", 2) != 0 || strncmp(s + 2, on, n) != 0)
+		return (-1);
+	s += 2 + n;
+	if (strcmp(s, "m") != 0 && *s != ':')
+		return (-1);
+	return (1);
+}
+
+/* Add the parameters to turn on attributes and change colours from a cell. */
+static void
+tty_sgr_set(struct tty *tty, struct tty_sgr *sgr, int attr,
+    const struct grid_cell *gc, const struct grid_cell *from)
+{
+	u_int	i;
+
+	for (i = 0; i < nitems(tty_sgr_attrs); i++) {
+		if (~attr & tty_sgr_attrs[i].attr)
+			continue;
+		tty_sgr_add(sgr, tty_attr_string(tty, tty_sgr_attrs[i].attr));
+		if (tty_sgr_attrs[i].attr & GRID_ATTR_ALL_UNDERSCORE)
+			attr &= ~GRID_ATTR_ALL_UNDERSCORE;
 	}
 
-	if (colour & COLOUR_FLAG_RGB) {
-		colour_split_rgb(colour & 0xffffff, &r, &g, &b);
-		if (*type == '3' && tty_term_has(tty->term, TTYC_SETRGBF))
-			tty_putcode_iii(tty, TTYC_SETRGBF, r, g, b);
-		else if (tty_term_has(tty->term, TTYC_SETRGBB))
-			tty_putcode_iii(tty, TTYC_SETRGBB, r, g, b);
-		return (0);
+	if (gc->fg != from->fg && !COLOUR_DEFAULT(gc->fg))
+		tty_sgr_add(sgr, tty_colour_string(tty, gc->fg, 0));
+	if (gc->bg != from->bg && !COLOUR_DEFAULT(gc->bg))
+		tty_sgr_add(sgr, tty_colour_string(tty, gc->bg, 1));
+	if (gc->us != from->us && !COLOUR_DEFAULT(gc->us))
+		tty_sgr_add(sgr, tty_us_string(tty, gc->us));
+}
+
+/* Build the parameters to reset and then set everything in the cell. */
+static void
+tty_sgr_reset(struct tty *tty, struct tty_sgr *sgr, const struct grid_cell *gc)
+{
+	tty_sgr_param(sgr, "0", 1);
+	tty_sgr_set(tty, sgr, gc->attr, gc, &grid_default_cell);
+}
+
+/*
+ * Build the parameters to change only what is different between the terminal
+ * and the cell.
+ */
+static void
+tty_sgr_diff(struct tty *tty, struct tty_sgr *sgr, const struct grid_cell *gc)
+{
+	struct grid_cell	*tc = &tty->cell;
+	int			 attr, cleared, set;
+	const char		*last = NULL;
+	u_int			 i;
+
+	/* Changing to another underscore style does not need it turned off. */
+	cleared = tc->attr & ~gc->attr;
+	if (gc->attr & GRID_ATTR_ALL_UNDERSCORE)
+		cleared &= ~GRID_ATTR_ALL_UNDERSCORE;
+	set = gc->attr & ~tc->attr;
+
+	for (i = 0; i < nitems(tty_sgr_attrs); i++) {
+		attr = tty_sgr_attrs[i].attr;
+		if (~cleared & attr)
+			continue;
+		switch (tty_sgr_standard(tty, attr, tty_sgr_attrs[i].on)) {
+		case 0:
+			continue;
+		case -1:
+			sgr->failed = 1;
+			return;
+		}
+		if (last == NULL || strcmp(last, tty_sgr_attrs[i].off) != 0)
+			tty_sgr_param(sgr, tty_sgr_attrs[i].off,
+			    strlen(tty_sgr_attrs[i].off));
+		last = tty_sgr_attrs[i].off;
+		sgr->cleared = 1;
+
+		/* Bold and dim are turned off together. */
+		if (attr & (GRID_ATTR_BRIGHT|GRID_ATTR_DIM))
+			set |= gc->attr & (GRID_ATTR_BRIGHT|GRID_ATTR_DIM);
 	}
 
-	return (-1);
+	/*
+	 * Some terminals do not clear an aixterm bright foreground correctly,
+	 * and without AX the only way to get the default colours is to reset.
+	 */
+	if (tc->fg >= 90 && tc->fg <= 97 && (gc->fg < 90 || gc->fg > 97)) {
+		sgr->failed = 1;
+		return;
+	}
+	if (gc->fg != tc->fg && COLOUR_DEFAULT(gc->fg)) {
+		if (!tty_term_flag(tty->term, TTYC_AX)) {
+			sgr->failed = 1;
+			return;
+		}
+		tty_sgr_param(sgr, "39", 2);
+		sgr->cleared = 1;
+	}
+	if (gc->bg != tc->bg && COLOUR_DEFAULT(gc->bg)) {
+		if (!tty_term_flag(tty->term, TTYC_AX)) {
+			sgr->failed = 1;
+			return;
+		}
+		tty_sgr_param(sgr, "49", 2);
+		sgr->cleared = 1;
+	}
+	if (gc->us != tc->us && COLOUR_DEFAULT(gc->us)) {
+		if (!tty_term_has(tty->term, TTYC_OL)) {
+			sgr->failed = 1;
+			return;
+		}
+		tty_sgr_add(sgr, tty_us_string(tty, gc->us));
+		sgr->cleared = 1;
+	}
+
+	tty_sgr_set(tty, sgr, set, gc, tc);
+}
+
+/*
+ * Change the attributes and colours with a single SGR sequence, either only
+ * changing what is different or resetting first, whichever is shorter.
+ * Returns -1 if neither can be used.
+ */
+static int
+tty_sgr_attributes(struct tty *tty, const struct grid_cell *gc)
+{
+	struct grid_cell	*tc = &tty->cell;
+	struct tty_sgr		 diff, reset, *sgr;
+	char			 s[sizeof sgr->buf + 3];
+
+	if (~tty->term->flags & TERM_SGR)
+		return (-1);
+
+	/*
+	 * If nothing is turned off, changing only what is different can never
+	 * be longer than resetting, so do not bother working that out.
+	 */
+	diff.len = diff.failed = diff.cleared = 0;
+	tty_sgr_diff(tty, &diff, gc);
+	reset.len = reset.failed = reset.cleared = 0;
+	if (diff.failed || diff.cleared)
+		tty_sgr_reset(tty, &reset, gc);
+	else
+		reset.failed = 1;
+
+	if (!diff.failed && (reset.failed || diff.len <= reset.len))
+		sgr = &diff;
+	else if (!reset.failed)
+		sgr = &reset;
+	else
+		return (-1);
+	if (sgr->len != 0) {
+		xsnprintf(s, sizeof s, "\033[%sm", sgr->buf);
+		tty_puts(tty, s);
+	}
+
+	/* sgr0 may leave the alternate character set so do it separately. */
+	if ((tc->attr ^ gc->attr) & GRID_ATTR_CHARSET && tty_acs_needed(tty)) {
+		if (gc->attr & GRID_ATTR_CHARSET)
+			tty_putcode(tty, TTYC_SMACS);
+		else
+			tty_putcode(tty, TTYC_RMACS);
+	}
+
+	tc->attr = gc->attr;
+	tc->fg = gc->fg;
+	tc->bg = gc->bg;
+	tc->us = gc->us;
+	return (0);
 }
 
 static void
@@ -51,6 +51,7 @@ static void	window_copy_redraw_selection(struct window_mode_entry *, u_int);
 static void	window_copy_redraw_lines(struct window_mode_entry *, u_int,
 		    u_int);
 static void	window_copy_redraw_screen(struct window_mode_entry *);
+static void	window_copy_check_history(struct window_mode_entry *);
 static void	window_copy_write_line(struct window_mode_entry *,
 		    struct screen_write_ctx *, u_int);
 static void	window_copy_write_lines(struct window_mode_entry *,
@@ -313,6 +314,9 @@ struct window_copy_mode_data {
 	int		 searchy;
 	int		 searcho;
 	u_char		 searchgen;
+	int		 searchfetch;	/* search up wanted more history */
+	u_int		 searchfx;	/* where it started, y from bottom */
+	u_int		 searchfy;
 
 	int		 timeout;	/* search has timed out */
 #define WINDOW_COPY_SEARCH_TIMEOUT 10000
@@ -360,6 +364,7 @@ window_copy_clone_screen(struct screen *src, struct screen *hint, u_int *cx,
 	int			 reflow;
 
 	dst = xcalloc(1, sizeof *dst);
+	grid_reflow_history(src->grid, 1);
 
 	sy = screen_hsize(src) + screen_size_y(src);
 	if (trim) {
@@ -385,6 +390,8 @@ window_copy_clone_screen(struct screen *src, struct screen *hint, u_int *cx,
 	dst->grid->sy = sy - screen_hsize(src);
 	dst->grid->hsize = screen_hsize(src);
 	dst->grid->hscrolled = src->grid->hscrolled;
+	dst->grid->hcompress = src->grid->hcompress;
+	dst->grid->hspill = src->grid->hspill;
 	if (src->cy > dst->grid->sy - 1) {
 		dst->cx = 0;
 		dst->cy = dst->grid->sy - 1;
@@ -729,6 +736,7 @@ void
 window_copy_pageup(struct window_pane *wp, int half_page)
 {
 	window_copy_pageup1(TAILQ_FIRST(&wp->modes), half_page);
+	window_copy_check_history(TAILQ_FIRST(&wp->modes));
 }
 
 static void
@@ -3130,6 +3138,7 @@ window_copy_command(struct window_mode_entry *wme, struct client *c,
 
 	if (m != NULL && m->valid && !MOUSE_WHEEL(m->b))
 		window_copy_move_mouse(m);
+	data->searchfetch = 0;
 
 	cs.wme = wme;
 	cs.args = args;
@@ -3177,8 +3186,71 @@ window_copy_command(struct window_mode_entry *wme, struct client *c,
 
 	if (action == WINDOW_COPY_CMD_CANCEL && wme->mode != &window_remote_mode) /*FIXME*/
 		window_pane_reset_mode(wp);
-	else if (action == WINDOW_COPY_CMD_REDRAW)
-		window_copy_redraw_screen(wme);
+	else {
+		if (action == WINDOW_COPY_CMD_REDRAW)
+			window_copy_redraw_screen(wme);
+		window_copy_check_history(wme);
+	}
+}
+
+/*
+ * Remote panes only have part of their history to start with, ask for more
+ * when the view gets close to the top or when a search up did not find
+ * anything above where it started.
+ */
+static void
+window_copy_check_history(struct window_mode_entry *wme)
+{
+#ifdef ENABLE_REMOTE
+	struct window_pane		*wp = wme->wp;
+	struct window_copy_mode_data	*data = wme->data;
+	struct winlink			*wl;
+	u_int				 sy = screen_size_y(&data->screen);
+
+	if (data->viewmode || wme->swp != wp)
+		return;
+	if (data->oy + sy < screen_hsize(data->backing) && !data->searchfetch)
+		return;
+
+	wl = TAILQ_FIRST(&wp->window->winlinks);
+	if (wl != NULL && wl->session->remote != NULL)
+		remote_fetch_history(wl->session->remote, wp);
+#endif
+}
+
+/* Lines were added to the top of the pane history. */
+void
+window_copy_history_added(struct window_pane *wp)
+{
+	struct window_mode_entry	*wme = TAILQ_FIRST(&wp->modes);
+	struct window_copy_mode_data	*data;
+
+	if (wme == NULL || wme->mode != &window_copy_mode)
+		return;
+	data = wme->data;
+	if (data->viewmode || wme->swp != wp)
+		return;
+
+	/* The offset is from the bottom so the view does not move. */
+	screen_free(data->backing);
+	free(data->backing);
+	data->backing = window_copy_clone_screen(&wp->base, &data->screen, NULL,
+	    NULL, 0);
+
+	window_copy_size_changed(wme);
+
+	/* Search again from the same place now there is more above it. */
+	if (data->searchfetch && data->searchstr != NULL) {
+		data->searchfetch = 0;
+		window_copy_scroll_to(wme, data->searchfx,
+		    screen_hsize(data->backing) + screen_size_y(data->backing) -
+		    1 - data->searchfy, 1);
+		data->searchall = 1;
+		window_copy_search_up(wme, data->searchregex);
+		window_copy_check_history(wme);
+		return;
+	}
+	window_copy_redraw_screen(wme);
 }
 
 static void
@@ -3863,7 +3935,7 @@ window_copy_search(struct window_mode_entry *wme, int direction, int regex)
 	struct screen_write_ctx		 ctx;
 	struct grid			*gd = s->grid;
 	const char			*str = data->searchstr;
-	u_int				 at, endline, fx, fy, start, ssx;
+	u_int				 at, endline, fx, fy, start, ssx, end;
 	int				 cis, found, keys, visible_only;
 	int				 wrapflag;
 
@@ -3925,6 +3997,8 @@ window_copy_search(struct window_mode_entry *wme, int direction, int regex)
 		}
 		endline = gd->hsize + gd->sy - 1;
 	} else {
+		data->searchfx = fx;
+		data->searchfy = gd->hsize + gd->sy - 1 - fy;
 		window_copy_move_left(s, &fx, &fy, wrapflag);
 		endline = 0;
 	}
@@ -3992,6 +4066,18 @@ window_copy_search(struct window_mode_entry *wme, int direction, int regex)
 	}
 	window_copy_redraw_screen(wme);
 
+	/*
+	 * If searching up found nothing or wrapped to below where it started,
+	 * the match may be in history that has not been fetched yet.
+	 */
+	if (!direction) {
+		end = gd->hsize + gd->sy - 1 - data->searchfy;
+		fy = screen_hsize(data->backing) - data->oy + data->cy;
+		if (!found || fy > end ||
+		    (fy == end && data->cx >= data->searchfx))
+			data->searchfetch = 1;
+	}
+
 	screen_free(&ss);
 	return (found);
 }
@@ -61,6 +61,9 @@ static u_int	next_window_pane_id;
 static u_int	next_window_id;
 static u_int	next_active_point;
 
+/* Time between reflowing each part of the history after a resize. */
+#define WINDOW_PANE_REFLOW_DELAY 10000
+
 struct window_pane_input_data {
 	struct cmdq_item	*item;
 	u_int			 wp;
@@ -433,7 +436,7 @@ window_pane_send_resize(struct window_pane *wp, u_int sx, u_int sy)
 	struct window	*w = wp->window;
 	struct winsize	 ws;
 
-	if (wp->fd == -1)
+	if (wp->fd == -1 || (wp->flags & PANE_REMOTE))
 		return;
 
 	log_debug("%s: %%%u resize to %u,%u", __func__, wp->id, sx, sy);
@@ -959,6 +962,11 @@ window_pane_create(struct window *w, u_int sx, u_int sy, u_int hlimit)
 	colour_palette_from_option(&wp->palette, wp->options);
 
 	screen_init(&wp->base, sx, sy, hlimit);
+	wp->base.grid->flags |= GRID_REFLOW_LATER;
+	grid_compress_history(wp->base.grid,
+	    options_get_number(wp->options, "history-compress"));
+	grid_spill_history(wp->base.grid,
+	    options_get_number(wp->options, "history-spill"));
 	wp->screen = &wp->base;
 	window_pane_default_cursor(wp);
 
@@ -979,6 +987,8 @@ window_pane_destroy(struct window_pane *wp)
 	window_pane_reset_mode_all(wp);
 	free(wp->searchstr);
 
+	if (wp->ictx != NULL)
+		input_stop_remote(wp->ictx);
 	if (wp->fd != -1) {
 #ifdef HAVE_UTEMPTER
 		utempter_remove_record(wp->fd);
@@ -1000,6 +1010,8 @@ window_pane_destroy(struct window_pane *wp)
 
 	if (event_initialized(&wp->resize_timer))
 		event_del(&wp->resize_timer);
+	if (event_initialized(&wp->reflow_timer))
+		event_del(&wp->reflow_timer);
 	TAILQ_FOREACH_SAFE(r, &wp->resize_queue, entry, r1) {
 		TAILQ_REMOVE(&wp->resize_queue, r, entry);
 		free(r);
@@ -1036,15 +1048,18 @@ window_pane_read_callback(__unused struct bufferevent *bufev, void *data)
 
 	log_debug("%%%u has %zu bytes", wp->id, size);
 
-	input_parse_pane(wp);
-	bufferevent_disable(wp->event, EV_READ);
-
-	/* MOVE remote logic here? */
+	/*
+	 * Give control clients the data before it is parsed: a pane a client
+	 * has not seen yet starts at the parsed offset, so it would be lost.
+	 */
 	/* XXX: if (wp->ictx->flags & REMOTE) */
 	TAILQ_FOREACH(c, &clients, entry) {
 		if (c->session != NULL && (c->flags & CLIENT_CONTROL))
 			control_write_output(c, wp);
 	}
+
+	input_parse_pane(wp);
+	bufferevent_disable(wp->event, EV_READ);
 }
 
 static void
@@ -1090,10 +1105,40 @@ window_pane_set_event_nofd(struct window_pane *wp, struct bufferevent *bev)
 	    NULL, window_pane_error_callback, wp);
 	wp->ictx = input_init(wp, wp->event, &wp->palette);
 	wp->fd = 1; /* HACK: pretend to be alive */
+	wp->flags |= PANE_REMOTE;
 
 	bufferevent_enable(wp->event, EV_READ|EV_WRITE);
 }
 
+/* Reflow some more of the history left after the pane was resized. */
+static void
+window_pane_reflow_timer(__unused int fd, __unused short events, void *data)
+{
+	struct window_pane	*wp = data;
+	struct timeval		 tv = { .tv_usec = WINDOW_PANE_REFLOW_DELAY };
+
+	if (grid_reflow_history(wp->base.grid, 0))
+		evtimer_add(&wp->reflow_timer, &tv);
+	wp->flags |= PANE_REDRAWSCROLLBAR;
+}
+
+/*
+ * Start reflowing the history if a resize left some of it, either of the pane
+ * or of the normal screen when leaving the alternate screen.
+ */
+void
+window_pane_reflow(struct window_pane *wp)
+{
+	struct timeval	tv = { .tv_usec = WINDOW_PANE_REFLOW_DELAY };
+
+	if (wp->base.grid->hreflow == 0)
+		return;
+	if (!event_initialized(&wp->reflow_timer))
+		evtimer_set(&wp->reflow_timer, window_pane_reflow_timer, wp);
+	if (!evtimer_pending(&wp->reflow_timer, NULL))
+		evtimer_add(&wp->reflow_timer, &tv);
+}
+
 void
 window_pane_resize(struct window_pane *wp, u_int sx, u_int sy)
 {
@@ -1115,6 +1160,7 @@ window_pane_resize(struct window_pane *wp, u_int sx, u_int sy)
 
 	log_debug("%s: %%%u resize %ux%u", __func__, wp->id, sx, sy);
 	screen_resize(&wp->base, sx, sy, wp->base.saved_grid == NULL);
+	window_pane_reflow(wp);
 
 	wme = TAILQ_FIRST(&wp->modes);
 	if (wme != NULL && wme->mode->resize != NULL)
@@ -1293,6 +1339,101 @@ window_pane_visible(struct window_pane *wp)
 	return (wp == wp->window->active);
 }
 
+/*
+ * Bytes of memory used by a pane's history and visible lines, and by the
+ * screens of any modes, such as the copy of the history made by copy mode.
+ */
+size_t
+window_pane_history_bytes(struct window_pane *wp)
+{
+	struct window_mode_entry	*wme;
+	struct screen			*s;
+	size_t				 total;
+
+	total = grid_bytes(wp->base.grid);
+	TAILQ_FOREACH(wme, &wp->modes, entry) {
+		if (wme->screen != NULL && wme->screen->grid != wp->base.grid)
+			total += grid_bytes(wme->screen->grid);
+		if (wme->mode->get_screen == NULL)
+			continue;
+		s = wme->mode->get_screen(wme);
+		if (s != NULL && s != wme->screen && s->grid != wp->base.grid)
+			total += grid_bytes(s->grid);
+	}
+	return (total);
+}
+
+/* Bytes of memory used by the history of every pane. */
+size_t
+window_history_bytes(void)
+{
+	struct window_pane	*wp;
+	size_t			 total = 0;
+
+	RB_FOREACH(wp, window_pane_tree, &all_window_panes)
+		total += window_pane_history_bytes(wp);
+	return (total);
+}
+
+/*
+ * If the history of all panes is over history-memory-limit, release lines
+ * until it is a tenth under. Panes which are not being looked at by any client
+ * go first, least recently seen and then largest; panes which are being looked
+ * at go only if there is nothing else, largest first.
+ */
+void
+window_limit_history(void)
+{
+	struct client		*c;
+	struct window		*w;
+	struct window_pane	*wp, *victim;
+	size_t			 limit, total, target, released;
+
+	/* Kept even without a limit so the order is right once one is set. */
+	TAILQ_FOREACH(c, &clients, entry) {
+		if (c->session == NULL || (c->flags & CLIENT_UNATTACHEDFLAGS))
+			continue;
+		w = c->session->curw->window;
+		TAILQ_FOREACH(wp, &w->panes, entry) {
+			if (window_pane_visible(wp))
+				wp->view_time = current_time;
+		}
+	}
+
+	limit = options_get_number(global_options, "history-memory-limit");
+	if (limit == 0)
+		return;
+	limit *= 1024;
+
+	total = window_history_bytes();
+	if (total <= limit)
+		return;
+	target = total - (limit - limit / 10);
+
+	while (target != 0) {
+		victim = NULL;
+		RB_FOREACH(wp, window_pane_tree, &all_window_panes) {
+			if (wp->base.grid->hsize == 0)
+				continue;
+			if (victim == NULL ||
+			    wp->view_time < victim->view_time ||
+			    (wp->view_time == victim->view_time &&
+			    wp->base.grid->bytes > victim->base.grid->bytes))
+				victim = wp;
+		}
+		if (victim == NULL)
+			break;
+
+		released = grid_release_history(victim->base.grid, target);
+		log_debug("%s: %%%u released %zu bytes", __func__, victim->id,
+		    released);
+		victim->flags |= PANE_REDRAWSCROLLBAR;
+		if (released >= target)
+			break;
+		target -= released;
+	}
+}
+
 int
 window_pane_exited(struct window_pane *wp)
 {